@@ -0,0 +1,40 @@
+#include "frame_time_history.h"
+
+#include <cassert>
+
+FrameTimeHistory::FrameTimeHistory(size_t capacity,
+                                   const std::vector<std::string>& stage_names)
+    : stage_names_(stage_names),
+      frame_ms_(capacity, 0.0f),
+      stage_ms_(capacity * stage_names.size(), 0.0f),
+      next_(0),
+      size_(0) {
+  assert(capacity > 0);
+}
+
+void FrameTimeHistory::AddFrame(double frame_ms,
+                                std::initializer_list<double> stage_ms) {
+  assert(stage_ms.size() == stage_names_.size());
+  frame_ms_[next_] = static_cast<float>(frame_ms);
+  size_t stage = 0;
+  for (double milliseconds : stage_ms) {
+    stage_ms_[next_ * stage_names_.size() + stage++] =
+        static_cast<float>(milliseconds);
+  }
+  next_ = (next_ + 1) % capacity();
+  if (size_ < capacity()) {
+    ++size_;
+  }
+}
+
+std::vector<double> FrameTimeHistory::FrameTimes() const {
+  return std::vector<double>(frame_ms_.begin(), frame_ms_.begin() + size_);
+}
+
+std::vector<double> FrameTimeHistory::StageTimes(size_t stage) const {
+  std::vector<double> times(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    times[i] = stage_ms_[i * stage_names_.size() + stage];
+  }
+  return times;
+}
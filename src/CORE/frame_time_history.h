@@ -0,0 +1,44 @@
+#ifndef CORE_FRAME_TIME_HISTORY_H_
+#define CORE_FRAME_TIME_HISTORY_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// The durations of the last frames, and of their CPU stages, in milliseconds,
+// in ring buffers of a fixed capacity. Adding a frame only stores a few
+// values, so that it costs nothing measurable when the history is not shown;
+// the statistics are computed by the readers, on demand.
+class FrameTimeHistory {
+ public:
+  FrameTimeHistory(size_t capacity, const std::vector<std::string>& stage_names);
+
+  // Adds a frame, with the duration of each stage (in the order of
+  // stage_names()). The oldest frame is dropped if the history is full.
+  void AddFrame(double frame_ms, std::initializer_list<double> stage_ms);
+
+  const std::vector<std::string>& stage_names() const { return stage_names_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return frame_ms_.size(); }
+
+  // The frame times, in the ring buffer format of ImGui::PlotLines: the
+  // oldest frame is at offset(), and the next ones wrap around the end. Only
+  // the first size() values are valid while the history is not full.
+  const std::vector<float>& frame_ms() const { return frame_ms_; }
+  size_t offset() const { return size_ < capacity() ? 0 : next_; }
+
+  // The valid frame times, or durations of a stage, in any order.
+  std::vector<double> FrameTimes() const;
+  std::vector<double> StageTimes(size_t stage) const;
+
+ private:
+  std::vector<std::string> stage_names_;
+  std::vector<float> frame_ms_;
+  // stage_ms_[i * stage_count + stage], for the frame stored in frame_ms_[i].
+  std::vector<float> stage_ms_;
+  size_t next_;
+  size_t size_;
+};
+
+#endif  // CORE_FRAME_TIME_HISTORY_H_
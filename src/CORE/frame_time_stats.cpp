@@ -0,0 +1,45 @@
+#include "frame_time_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+namespace {
+
+// The nearest rank percentile of sorted values.
+double Percentile(const std::vector<double>& sorted, double percent) {
+  const size_t rank = static_cast<size_t>(
+      std::ceil(percent / 100.0 * static_cast<double>(sorted.size())));
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+}  // anonymous namespace
+
+FrameTimeSummary SummarizeFrameTimes(std::vector<double> milliseconds) {
+  FrameTimeSummary summary;
+  if (milliseconds.empty()) {
+    return summary;
+  }
+  std::sort(milliseconds.begin(), milliseconds.end());
+  summary.count = milliseconds.size();
+  summary.mean =
+      std::accumulate(milliseconds.begin(), milliseconds.end(), 0.0) /
+      summary.count;
+  summary.min = milliseconds.front();
+  summary.median = Percentile(milliseconds, 50.0);
+  summary.p95 = Percentile(milliseconds, 95.0);
+  summary.p99 = Percentile(milliseconds, 99.0);
+  summary.max = milliseconds.back();
+  return summary;
+}
+
+std::string FormatFrameTimeSummary(const FrameTimeSummary& summary) {
+  std::ostringstream text;
+  text.precision(3);
+  text << std::fixed << summary.count << " frames, mean " << summary.mean
+       << " ms, min " << summary.min << " ms, median " << summary.median
+       << " ms, p95 " << summary.p95 << " ms, p99 " << summary.p99
+       << " ms, max " << summary.max << " ms";
+  return text.str();
+}
@@ -0,0 +1,26 @@
+#ifndef CORE_FRAME_TIME_STATS_H_
+#define CORE_FRAME_TIME_STATS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Summary statistics of a list of frame times, in milliseconds. The
+// percentiles use the nearest rank method (e.g. the 99th percentile is the
+// smallest frame time which is greater than or equal to 99% of them).
+struct FrameTimeSummary {
+  size_t count = 0;
+  double mean = 0.0;
+  double min = 0.0;
+  double median = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+FrameTimeSummary SummarizeFrameTimes(std::vector<double> milliseconds);
+
+// The summary on one line, e.g. "120 frames, mean 16.2 ms, ...".
+std::string FormatFrameTimeSummary(const FrameTimeSummary& summary);
+
+#endif  // CORE_FRAME_TIME_STATS_H_
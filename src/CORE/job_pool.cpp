@@ -0,0 +1,68 @@
+#include "job_pool.h"
+
+#include <algorithm>
+
+#include "CORE/trace.h"
+
+JobPool::JobPool(unsigned int thread_count) : stopping_(false) {
+  if (thread_count == 0) {
+    const unsigned int hardware_threads = std::thread::hardware_concurrency();
+    thread_count = std::max(hardware_threads, 2u) - 1;
+  }
+  for (unsigned int i = 0; i < thread_count; ++i) {
+    threads_.push_back(std::thread(&JobPool::Run, this));
+  }
+}
+
+JobPool::~JobPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void JobPool::ParallelFor(int count, const std::function<void(int)>& job) {
+  std::vector<std::future<void>> results;
+  results.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    results.push_back(Submit<void>([&job, i]() { job(i); }));
+  }
+  // All the jobs reference 'job', so wait for all of them before rethrowing.
+  for (std::future<void>& result : results) {
+    result.wait();
+  }
+  for (std::future<void>& result : results) {
+    result.get();
+  }
+}
+
+void JobPool::Enqueue(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  condition_.notify_one();
+}
+
+void JobPool::Run() {
+#if ATMOSPHERE_TRACING
+  SetTraceThreadName("job pool");
+#endif
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef CORE_JOB_POOL_H_
+#define CORE_JOB_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads executing the submitted jobs in FIFO order.
+// Jobs must not touch the OpenGL context, which is only current on the main
+// thread: they typically produce data in memory that the caller then uploads.
+class JobPool {
+ public:
+  // Uses one thread per hardware thread, minus one for the main thread (and
+  // at least one) if 'thread_count' is 0.
+  explicit JobPool(unsigned int thread_count = 0);
+  JobPool(JobPool const&) = delete;
+  JobPool(JobPool&&) = delete;
+  // Waits for the queued jobs to complete.
+  ~JobPool();
+
+  // Queues 'job', and returns a future for its completion (which rethrows the
+  // exception thrown by the job, if any).
+  template <typename Result>
+  std::future<Result> Submit(std::function<Result()> job) {
+    std::shared_ptr<std::packaged_task<Result()>> task =
+        std::make_shared<std::packaged_task<Result()>>(std::move(job));
+    std::future<Result> result = task->get_future();
+    Enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  // Calls job(i) for i in [0, count) on the worker threads, and waits for all
+  // of them.
+  void ParallelFor(int count, const std::function<void(int)>& job);
+
+  unsigned int thread_count() const {
+    return static_cast<unsigned int>(threads_.size());
+  }
+
+ private:
+  void Enqueue(std::function<void()> job);
+  void Run();
+
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_;
+};
+
+#endif  // CORE_JOB_POOL_H_
@@ -0,0 +1,219 @@
+#include "system_telemetry.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+// Returns the value, in kB, of the "key: value kB" line of a /proc file, or 0.
+uint64_t ReadProcKilobytes(const std::string& path, const std::string& key) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.compare(0, key.size(), key) == 0 && line.size() > key.size() &&
+        line[key.size()] == ':') {
+      return std::strtoull(line.c_str() + key.size() + 1, nullptr, 10);
+    }
+  }
+  return 0;
+}
+
+// Reads the name and the user plus system CPU time of a thread, from its
+// /proc/self/task/ID/stat file.
+bool ReadThreadStat(const std::string& path, std::string* name,
+                    uint64_t* ticks) {
+  std::ifstream file(path);
+  std::string line;
+  if (!std::getline(file, line)) {
+    return false;
+  }
+  // The name is between parentheses, and may contain spaces and parentheses.
+  const size_t name_begin = line.find('(');
+  const size_t name_end = line.rfind(')');
+  if (name_begin == std::string::npos || name_end == std::string::npos ||
+      name_end < name_begin) {
+    return false;
+  }
+  *name = line.substr(name_begin + 1, name_end - name_begin - 1);
+  // The fields after the name start with the state (field 3); utime and
+  // stime are the fields 14 and 15.
+  std::istringstream fields(line.substr(name_end + 1));
+  std::string field;
+  uint64_t utime = 0;
+  uint64_t stime = 0;
+  for (int i = 3; i <= 15 && fields >> field; ++i) {
+    if (i == 14) {
+      utime = std::strtoull(field.c_str(), nullptr, 10);
+    } else if (i == 15) {
+      stime = std::strtoull(field.c_str(), nullptr, 10);
+    }
+  }
+  *ticks = utime + stime;
+  return static_cast<bool>(fields);
+}
+
+// Reads the busy and total CPU times of the system, in clock ticks, from the
+// first line of /proc/stat.
+bool ReadSystemTicks(uint64_t* busy_ticks, uint64_t* total_ticks) {
+  std::ifstream file("/proc/stat");
+  std::string cpu;
+  if (!(file >> cpu) || cpu != "cpu") {
+    return false;
+  }
+  // user nice system idle iowait irq softirq steal (guest time is included in
+  // user time).
+  uint64_t values[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (uint64_t& value : values) {
+    if (!(file >> value)) {
+      break;
+    }
+  }
+  *total_ticks = 0;
+  for (uint64_t value : values) {
+    *total_ticks += value;
+  }
+  *busy_ticks = *total_ticks - values[3] - values[4];
+  return true;
+}
+#endif
+
+}  // anonymous namespace
+
+SystemTelemetry::SystemTelemetry(std::chrono::milliseconds period)
+    : period_(period),
+      gpu_total_bytes_(0),
+      gpu_available_bytes_(0),
+      previous_system_busy_ticks_(0),
+      previous_system_total_ticks_(0),
+      stopping_(false) {
+#ifdef __linux__
+  thread_ = std::thread(&SystemTelemetry::Run, this);
+#endif
+}
+
+SystemTelemetry::~SystemTelemetry() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+std::string SystemTelemetry::CpuModelName() {
+  std::ifstream file("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      const size_t value = line.find(':');
+      if (value != std::string::npos) {
+        return line.substr(line.find_first_not_of(" \t", value + 1));
+      }
+    }
+  }
+  return std::string();
+}
+
+void SystemTelemetry::SetGpuMemory(uint64_t total_bytes,
+                                   uint64_t available_bytes) {
+  gpu_total_bytes_.store(total_bytes, std::memory_order_relaxed);
+  gpu_available_bytes_.store(available_bytes, std::memory_order_relaxed);
+}
+
+void SystemTelemetry::Run() {
+  auto previous_time = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    lock.unlock();
+    const auto time = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = time - previous_time;
+    previous_time = time;
+    Sample(elapsed.count(), &buffer_.write_buffer());
+    buffer_.Publish();
+    lock.lock();
+    condition_.wait_for(lock, period_, [this]() { return stopping_; });
+  }
+}
+
+void SystemTelemetry::Sample(double elapsed_seconds,
+                             SystemSnapshot* snapshot) {
+#ifdef __linux__
+  snapshot->process_rss_bytes =
+      ReadProcKilobytes("/proc/self/status", "VmRSS") * 1024;
+  snapshot->process_peak_rss_bytes =
+      ReadProcKilobytes("/proc/self/status", "VmHWM") * 1024;
+  snapshot->system_total_bytes =
+      ReadProcKilobytes("/proc/meminfo", "MemTotal") * 1024;
+  snapshot->system_available_bytes =
+      ReadProcKilobytes("/proc/meminfo", "MemAvailable") * 1024;
+
+  // The CPU usages are 0 in the first sample, which has no previous one.
+  const double ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+  const double percent_per_tick =
+      elapsed_seconds > 0.0 ? 100.0 / (ticks_per_second * elapsed_seconds)
+                            : 0.0;
+  std::map<int, ThreadTicks> thread_ticks;
+  if (DIR* directory = opendir("/proc/self/task")) {
+    while (dirent* entry = readdir(directory)) {
+      const int id = std::atoi(entry->d_name);
+      ThreadTicks ticks;
+      if (id > 0 &&
+          ReadThreadStat(std::string("/proc/self/task/") + entry->d_name +
+                             "/stat",
+                         &ticks.name, &ticks.ticks)) {
+        thread_ticks[id] = ticks;
+      }
+    }
+    closedir(directory);
+  }
+  snapshot->threads.clear();
+  snapshot->process_cpu_percent = 0.0;
+  for (const auto& entry : thread_ticks) {
+    auto previous = previous_thread_ticks_.find(entry.first);
+    const uint64_t previous_ticks =
+        previous != previous_thread_ticks_.end() ? previous->second.ticks
+                                                 : entry.second.ticks;
+    ThreadCpuUsage usage;
+    usage.id = entry.first;
+    usage.name = entry.second.name;
+    usage.cpu_percent = (entry.second.ticks - previous_ticks) *
+                        percent_per_tick;
+    snapshot->process_cpu_percent += usage.cpu_percent;
+    snapshot->threads.push_back(usage);
+  }
+  std::stable_sort(snapshot->threads.begin(), snapshot->threads.end(),
+                   [](const ThreadCpuUsage& a, const ThreadCpuUsage& b) {
+                     return a.cpu_percent > b.cpu_percent;
+                   });
+  previous_thread_ticks_.swap(thread_ticks);
+
+  uint64_t busy_ticks;
+  uint64_t total_ticks;
+  snapshot->system_cpu_percent = 0.0;
+  if (ReadSystemTicks(&busy_ticks, &total_ticks)) {
+    if (total_ticks > previous_system_total_ticks_ &&
+        previous_system_total_ticks_ > 0) {
+      snapshot->system_cpu_percent =
+          100.0 * (busy_ticks - previous_system_busy_ticks_) /
+          (total_ticks - previous_system_total_ticks_);
+    }
+    previous_system_busy_ticks_ = busy_ticks;
+    previous_system_total_ticks_ = total_ticks;
+  }
+  snapshot->valid = true;
+#endif
+  snapshot->gpu_total_bytes =
+      gpu_total_bytes_.load(std::memory_order_relaxed);
+  snapshot->gpu_available_bytes =
+      gpu_available_bytes_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#ifndef CORE_SYSTEM_TELEMETRY_H_
+#define CORE_SYSTEM_TELEMETRY_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CORE/triple_buffer.h"
+
+// The CPU time used by a thread of the process, during the last sampling
+// period.
+struct ThreadCpuUsage {
+  int id;
+  std::string name;
+  // In percent of one core.
+  double cpu_percent;
+};
+
+// The system and process metrics of the last sampling period. The sizes are 0
+// when unknown.
+struct SystemSnapshot {
+  // False until the first sample, and on systems without /proc.
+  bool valid = false;
+  uint64_t process_rss_bytes = 0;
+  uint64_t process_peak_rss_bytes = 0;
+  uint64_t system_total_bytes = 0;
+  uint64_t system_available_bytes = 0;
+  // In percent of one core for the process, and of all cores for the system.
+  double process_cpu_percent = 0.0;
+  double system_cpu_percent = 0.0;
+  // In decreasing CPU usage order.
+  std::vector<ThreadCpuUsage> threads;
+  // Reported by the main thread with SetGpuMemory (since the sampler thread
+  // has no OpenGL context).
+  uint64_t gpu_total_bytes = 0;
+  uint64_t gpu_available_bytes = 0;
+};
+
+// Samples the memory and CPU usage of the process and of the system, on Linux,
+// from /proc/self/status, /proc/self/task/*/stat, /proc/stat and
+// /proc/meminfo, on a background thread. The samples are published through a
+// triple buffer, so that the reader (e.g. the UI, once per frame) never
+// blocks, nor waits for a sample.
+class SystemTelemetry {
+ public:
+  explicit SystemTelemetry(
+      std::chrono::milliseconds period = std::chrono::milliseconds(500));
+  SystemTelemetry(SystemTelemetry const&) = delete;
+  ~SystemTelemetry();
+
+  // The "model name" of /proc/cpuinfo, or an empty string.
+  static std::string CpuModelName();
+
+  // Sets the GPU memory sizes of the next samples. Can be called from any
+  // thread.
+  void SetGpuMemory(uint64_t total_bytes, uint64_t available_bytes);
+
+  // Returns the last sample. Must always be called from the same thread.
+  const SystemSnapshot& snapshot() {
+    buffer_.Update();
+    return buffer_.read_buffer();
+  }
+
+ private:
+  // The CPU time of a thread, in clock ticks.
+  struct ThreadTicks {
+    std::string name;
+    uint64_t ticks;
+  };
+
+  void Run();
+  void Sample(double elapsed_seconds, SystemSnapshot* snapshot);
+
+  const std::chrono::milliseconds period_;
+  TripleBuffer<SystemSnapshot> buffer_;
+  std::atomic<uint64_t> gpu_total_bytes_;
+  std::atomic<uint64_t> gpu_available_bytes_;
+  // The counters of the previous sample (used by the sampler thread only).
+  std::map<int, ThreadTicks> previous_thread_ticks_;
+  uint64_t previous_system_busy_ticks_;
+  uint64_t previous_system_total_ticks_;
+  // To wake up the sampler thread when stopping.
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_;
+  std::thread thread_;
+};
+
+#endif  // CORE_SYSTEM_TELEMETRY_H_
@@ -0,0 +1,222 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace {
+
+struct TraceZone {
+  std::atomic<const char*> name;
+  std::atomic<int64_t> begin_ns;
+  std::atomic<int64_t> end_ns;
+};
+
+// The zones of a thread, written by this thread only. The zone i is stored at
+// index i % kTraceZonesPerThread. 'started' and 'finished' are the number of
+// zones whose writing has started and finished, respectively, so that a
+// reader can detect the zones overwritten while it copies them (as with a
+// seqlock).
+struct TraceBuffer {
+  TraceBuffer() : id(0), gpu(false), started(0), finished(0) {}
+
+  int id;
+  bool gpu;
+  // Guarded by the Registry mutex.
+  std::string thread_name;
+  std::atomic<uint64_t> started;
+  std::atomic<uint64_t> finished;
+  TraceZone zones[kTraceZonesPerThread];
+};
+
+struct Registry {
+  std::mutex mutex;
+  // Never deleted, since the threads can record zones until they exit.
+  std::vector<TraceBuffer*> buffers;
+  std::set<std::string> names;
+};
+
+// Never deleted, so that threads can still record zones during the static
+// destruction.
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+TraceBuffer* NewTraceBuffer(const std::string& thread_name, bool gpu) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  TraceBuffer* buffer = new TraceBuffer();
+  buffer->id = static_cast<int>(registry.buffers.size()) + 1;
+  buffer->gpu = gpu;
+  buffer->thread_name = thread_name.empty()
+                            ? "thread " + std::to_string(buffer->id)
+                            : thread_name;
+  registry.buffers.push_back(buffer);
+  return buffer;
+}
+
+thread_local TraceBuffer* thread_buffer = nullptr;
+
+TraceBuffer* ThreadTraceBuffer() {
+  if (thread_buffer == nullptr) {
+    thread_buffer = NewTraceBuffer("", false);
+  }
+  return thread_buffer;
+}
+
+TraceBuffer* GpuTraceBuffer() {
+  static TraceBuffer* buffer = NewTraceBuffer("GPU", true);
+  return buffer;
+}
+
+void Record(TraceBuffer* buffer, const char* name, int64_t begin_ns,
+            int64_t end_ns) {
+  const uint64_t index = buffer->started.load(std::memory_order_relaxed);
+  buffer->started.store(index + 1, std::memory_order_relaxed);
+  // Makes the new 'started' value visible to a reader which sees any of the
+  // new zone values below.
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceZone& zone = buffer->zones[index % kTraceZonesPerThread];
+  zone.name.store(name, std::memory_order_relaxed);
+  zone.begin_ns.store(begin_ns, std::memory_order_relaxed);
+  zone.end_ns.store(end_ns, std::memory_order_relaxed);
+  buffer->finished.store(index + 1, std::memory_order_release);
+}
+
+struct ZoneCopy {
+  const char* name;
+  int64_t begin_ns;
+  int64_t end_ns;
+};
+
+// Copies the zones of 'buffer' which are not being overwritten.
+std::vector<ZoneCopy> CopyZones(const TraceBuffer& buffer) {
+  const uint64_t capacity = kTraceZonesPerThread;
+  const uint64_t finished = buffer.finished.load(std::memory_order_acquire);
+  const uint64_t first = finished > capacity ? finished - capacity : 0;
+  std::vector<ZoneCopy> zones;
+  zones.reserve(finished - first);
+  for (uint64_t i = first; i < finished; ++i) {
+    const TraceZone& zone = buffer.zones[i % capacity];
+    ZoneCopy copy;
+    copy.name = zone.name.load(std::memory_order_relaxed);
+    copy.begin_ns = zone.begin_ns.load(std::memory_order_relaxed);
+    copy.end_ns = zone.end_ns.load(std::memory_order_relaxed);
+    zones.push_back(copy);
+  }
+  // The zone i was (maybe partially) overwritten if the zone i + capacity has
+  // started.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t started = buffer.started.load(std::memory_order_relaxed);
+  const uint64_t first_valid = started > capacity ? started - capacity : 0;
+  if (first_valid > first) {
+    zones.erase(zones.begin(),
+                zones.begin() + std::min<uint64_t>(first_valid - first,
+                                                   zones.size()));
+  }
+  return zones;
+}
+
+std::string JsonEscape(const std::string& text) {
+  std::string result;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      result += escaped;
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+}  // anonymous namespace
+
+int64_t TraceNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void RecordTraceZone(const char* name, int64_t begin_ns, int64_t end_ns) {
+  Record(ThreadTraceBuffer(), name, begin_ns, end_ns);
+}
+
+void RecordGpuTraceZone(const char* name, int64_t begin_ns, int64_t end_ns) {
+  Record(GpuTraceBuffer(), name, begin_ns, end_ns);
+}
+
+const char* InternTraceName(const std::string& name) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return registry.names.insert(name).first->c_str();
+}
+
+void SetTraceThreadName(const std::string& name) {
+  TraceBuffer* buffer = ThreadTraceBuffer();
+  std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+  buffer->thread_name = name;
+}
+
+bool WriteChromeTrace(const std::string& path) {
+  struct ThreadZones {
+    int id;
+    bool gpu;
+    std::string name;
+    std::vector<ZoneCopy> zones;
+  };
+  std::vector<ThreadZones> threads;
+  {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const TraceBuffer* buffer : registry.buffers) {
+      ThreadZones thread;
+      thread.id = buffer->id;
+      thread.gpu = buffer->gpu;
+      thread.name = buffer->thread_name;
+      thread.zones = CopyZones(*buffer);
+      threads.push_back(std::move(thread));
+    }
+  }
+  int64_t origin_ns = INT64_MAX;
+  for (const ThreadZones& thread : threads) {
+    for (const ZoneCopy& zone : thread.zones) {
+      origin_ns = std::min(origin_ns, zone.begin_ns);
+    }
+  }
+
+  std::ofstream file(path);
+  if (!file) {
+    return false;
+  }
+  // Timestamps and durations are in microseconds, with a nanosecond precision.
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  file << "{\"traceEvents\":[";
+  const char* separator = "\n";
+  for (const ThreadZones& thread : threads) {
+    file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+         << "\"tid\":" << thread.id << ",\"args\":{\"name\":\""
+         << JsonEscape(thread.name) << "\"}}";
+    separator = ",\n";
+    for (const ZoneCopy& zone : thread.zones) {
+      file << separator << "{\"name\":\"" << JsonEscape(zone.name)
+           << "\",\"cat\":\"" << (thread.gpu ? "gpu" : "cpu")
+           << "\",\"ph\":\"X\",\"ts\":" << (zone.begin_ns - origin_ns) * 1e-3
+           << ",\"dur\":" << (zone.end_ns - zone.begin_ns) * 1e-3
+           << ",\"pid\":1,\"tid\":" << thread.id << "}";
+    }
+  }
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,79 @@
+#ifndef CORE_TRACE_H_
+#define CORE_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+// Whether the TRACE_SCOPE zones are compiled in. By default they are in debug
+// builds only, but this can be overridden with -DATMOSPHERE_TRACING=0 or 1.
+#ifndef ATMOSPHERE_TRACING
+#ifdef NDEBUG
+#define ATMOSPHERE_TRACING 0
+#else
+#define ATMOSPHERE_TRACING 1
+#endif
+#endif
+
+// A lightweight tracer of named time intervals ("zones"). Each thread records
+// its zones in its own ring buffer, without locks, and keeps only its most
+// recent ones (kTraceZonesPerThread). WriteChromeTrace exports the zones of
+// all the threads as a Chrome trace (see chrome://tracing or
+// https://ui.perfetto.dev), together with the GPU zones reported by the
+// GpuProfiler, converted to the same clock.
+
+constexpr int kTraceZonesPerThread = 1 << 14;
+
+// The current time of the trace clock, in nanoseconds.
+int64_t TraceNanoseconds();
+
+// Records a zone of the calling thread. 'name' must remain valid until the
+// end of the program (e.g. a string literal, or the result of
+// InternTraceName).
+void RecordTraceZone(const char* name, int64_t begin_ns, int64_t end_ns);
+
+// Records a zone of the GPU "thread", with begin and end times converted to
+// the trace clock. Must always be called from the same thread (the one with
+// the OpenGL context).
+void RecordGpuTraceZone(const char* name, int64_t begin_ns, int64_t end_ns);
+
+// Returns a copy of 'name' which remains valid until the end of the program,
+// for names which are not string literals. This takes a lock, and should not
+// be used in fine grained zones.
+const char* InternTraceName(const std::string& name);
+
+// Sets the name of the calling thread in the trace.
+void SetTraceThreadName(const std::string& name);
+
+// Writes the recorded zones of all the threads to 'path', in the Chrome trace
+// event JSON format. The zones recorded concurrently with this call may be
+// missing. Returns false if the file can't be written.
+bool WriteChromeTrace(const std::string& path);
+
+// Records the lifetime of a C++ scope.
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name)
+      : name_(name), begin_ns_(TraceNanoseconds()) {}
+  TraceScope(TraceScope const&) = delete;
+  ~TraceScope() { RecordTraceZone(name_, begin_ns_, TraceNanoseconds()); }
+
+ private:
+  const char* name_;
+  int64_t begin_ns_;
+};
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+
+// Records the rest of the enclosing C++ scope as a zone named 'name', which
+// must be a string literal. Compiled out if ATMOSPHERE_TRACING is 0.
+#if ATMOSPHERE_TRACING
+#define TRACE_SCOPE(name) \
+  TraceScope TRACE_CONCATENATE(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) \
+  do {                    \
+  } while (false)
+#endif
+
+#endif  // CORE_TRACE_H_
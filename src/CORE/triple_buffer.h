@@ -0,0 +1,49 @@
+#ifndef CORE_TRIPLE_BUFFER_H_
+#define CORE_TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+// Passes the latest value of a T from one writer thread to one reader thread,
+// without locks nor waits on either side. The writer fills write_buffer() and
+// publishes it, and the reader gets the last published value, if any, with
+// Update(). The values published in between are dropped. The three buffers
+// are swapped, not copied, so the writer must fully overwrite its buffer
+// (which holds an older value) before each Publish.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : write_index_(0), shared_(1), read_index_(2) {}
+  TripleBuffer(TripleBuffer const&) = delete;
+
+  // Writer side.
+  T& write_buffer() { return buffers_[write_index_]; }
+  void Publish() {
+    write_index_ = shared_.exchange(write_index_ | kPublished,
+                                    std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // Reader side. Returns true if read_buffer() changed.
+  bool Update() {
+    if ((shared_.load(std::memory_order_relaxed) & kPublished) == 0) {
+      return false;
+    }
+    read_index_ =
+        shared_.exchange(read_index_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+  const T& read_buffer() const { return buffers_[read_index_]; }
+
+ private:
+  // The shared index has this bit set when it holds a value which the reader
+  // has not seen yet.
+  static constexpr int kPublished = 4;
+  static constexpr int kIndexMask = 3;
+
+  T buffers_[3];
+  int write_index_;
+  // The index of the buffer which is neither written nor read.
+  std::atomic<int> shared_;
+  int read_index_;
+};
+
+#endif  // CORE_TRIPLE_BUFFER_H_
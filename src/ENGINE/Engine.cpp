@@ -1,14 +1,23 @@
 #include "Engine.h"
 #include <glad/glad.h>
+#include "CORE/trace.h"
+#include "RENDER/gpu_memory_info.h"
+#include "RENDER/gpu_memory_tracker.h"
+#include "RENDER/image_file.h"
+#include "RENDER/shader_compile.h"
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <map>
 #include <stdexcept>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <future>
+#include <iostream>
+#include <chrono>
+#include <thread>
 
 bool firstMouse;
 bool canMovingMouse;
@@ -16,9 +25,12 @@ double lastX;
 double lastY;
 
 constexpr double kPi = 3.1415926;
-constexpr double kSunAngularRadius = 0.00935 / 2.0;
+constexpr double kSunAngularRadius = kEarthSunAngularRadius;
 constexpr double kSunSolidAngle = kPi * kSunAngularRadius * kSunAngularRadius;
-constexpr double kLengthUnitInMeters = 1000.0;
+constexpr double kLengthUnitInMeters = kEarthLengthUnitInMeters;
+constexpr double kBottomRadius = kEarthBottomRadius;
+constexpr double kSphereCenterZ = 1000.0;
+constexpr double kSphereRadius = 1000.0;
 
 
 const char kVertexShader[] = R"(
@@ -39,13 +51,95 @@ const char kVertexShader[] = R"(
 static std::map<int, Engine*> INSTANCES;
 
 
+void mark_input(GLFWwindow *window, bool redisplay)
+{
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	if (pointers->oldestInputTime < 0.0)
+		pointers->oldestInputTime = glfwGetTime();
+	if (redisplay)
+		pointers->redisplayRequested = true;
+}
+
+InputEvent make_input_event(InputEventType type, double x, double y,
+	int value0 = 0, int value1 = 0, int value2 = 0, int value3 = 0)
+{
+	InputEvent event;
+	event.type = type;
+	event.x = x;
+	event.y = y;
+	event.values[0] = value0;
+	event.values[1] = value1;
+	event.values[2] = value2;
+	event.values[3] = value3;
+	return event;
+}
+
+// Records 'event' when recording, and returns false if it must be ignored:
+// during a replay only the recorded events are handled, not the live ones.
+bool accept_input(GLFWwindow *window, const InputEvent& event)
+{
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	if (pointers->replayedMouse != nullptr && !pointers->dispatchingReplay)
+		return false;
+	if (pointers->inputRecorder != nullptr)
+		pointers->inputRecorder->record(event, glfwGetTime());
+	return true;
+}
+
+// The cursor position, replayed or polled from GLFW.
+void get_cursor_position(GLFWwindow *window, double *x, double *y)
+{
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	if (pointers->replayedMouse != nullptr)
+	{
+		*x = pointers->replayedMouse->x;
+		*y = pointers->replayedMouse->y;
+	}
+	else
+	{
+		glfwGetCursorPos(window, x, y);
+	}
+}
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	pointers->redisplayRequested = true;
+}
+
+void window_refresh_callback(GLFWwindow *window)
+{
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	pointers->redisplayRequested = true;
+}
+
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
+{
+	if (!accept_input(window, make_input_event(InputEventType::SCROLL, xoffset, yoffset)))
+		return;
+	ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
+	mark_input(window, true);
+}
+
+void char_callback(GLFWwindow *window, unsigned int c)
+{
+	if (!accept_input(window, make_input_event(InputEventType::CHAR, 0.0, 0.0, static_cast<int>(c))))
+		return;
+	ImGui_ImplGlfw_CharCallback(window, c);
+	mark_input(window, true);
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+	if (!accept_input(window, make_input_event(InputEventType::CURSOR, xpos, ypos)))
+		return;
+	// With a visible cursor the motion only matters to ImGui (hovering), which
+	// still needs a frame to show it. Otherwise it drags the sun, whose queued
+	// motion is picked up by the next simulation tick.
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	mark_input(window, !canMovingMouse);
+
 	if (canMovingMouse)
 	{
 		if (firstMouse)
@@ -61,38 +155,98 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 		lastX = xpos;
 		lastY = ypos;
 		glfwSetCursorPos(window, lastX, lastY);
-		Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
 		pointers->sunDirection->handleMouseDragEvent(lastX, lastY);
 	}
 }
 
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (!accept_input(window, make_input_event(InputEventType::BUTTON, 0.0, 0.0, button, action, mods)))
+		return;
+	Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
+	double x, y;
+	get_cursor_position(window, &x, &y);
+	pointers->sunDirection->handleMouseClickEvent(button, action, mods, x, y);
+	mark_input(window, true);
+}
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	if (!accept_input(window, make_input_event(InputEventType::KEY, 0.0, 0.0, key, scancode, action, mods)))
+		return;
 	if (action == GLFW_PRESS)
 	{
 		Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(window));
 		pointers->inputEngine->onKeyPress(key, pointers->inputEngine->functions);
 		firstMouse = pointers->inputEngine->functions->getFirstMouseValue();
 		canMovingMouse = pointers->inputEngine->functions->getCanMovingMouseValue();
+		mark_input(window, true);
 	}
 }
 
-Engine::Engine() :
+// Calls the callback of a replayed event, as GLFW would have.
+void dispatch_input_event(GLFWwindow* window, const InputEvent& event)
+{
+	switch (event.type)
+	{
+	case InputEventType::CURSOR:
+		mouse_callback(window, event.x, event.y);
+		break;
+	case InputEventType::BUTTON:
+		mouse_button_callback(window, event.values[0], event.values[1], event.values[2]);
+		break;
+	case InputEventType::KEY:
+		key_callback(window, event.values[0], event.values[1], event.values[2], event.values[3]);
+		break;
+	case InputEventType::SCROLL:
+		scroll_callback(window, event.x, event.y);
+		break;
+	case InputEventType::CHAR:
+		char_callback(window, static_cast<unsigned int>(event.values[0]));
+		break;
+	case InputEventType::SIZE:
+		break;
+	}
+}
+
+Engine::Engine(bool visible) :
 	useConstantSolarSpectrum(false),
 	useOzone(true),
 	useCombinedTextures(true),
 	useHalfPrecision(true),
 	useLuminance(NONE),
 	doWhiteBalance(false),
+	useShadowMapLightShafts(false),
+	lutCacheDirectory("luts"),
+	useQuantizedLuts(true),
+	lutQuality(LUT_QUALITY_DEFAULT),
+	useParameterAtlas(false),
+	atlasDensityRange{ 0.5, 2.5 },
+	atlasMieRange{ 1.328e-3, 9.328e-3 },
+	atlasTopHeight(0.0),
+	atlasRayleigh(0.0),
+	modelIsBlended(false),
+	lastParameterChangeTime(0.0),
 	programId(0),
+	lastGpuMemoryQueryTime(-1.0),
 	viewDistanceMeters(9000.0),
 	viewZenithAngleRadians(1.47),
 	viewAzimuthAngleRadians(-0.1),
-	exposure(10.0)
+	exposure(10.0),
+	viewChanged(true),
+	settleFrames(0),
+	previousFrameTime(0.0),
+	tickAccumulator(0.0),
+	vsync(true),
+	maxFrameRate(0.0),
+	inputLatency(0.0),
+	lastChangeTime(0.0),
+	lastRenderTime(0.0),
+	replaying(false),
+	simulatedTime(0.0)
 {
 
-	WindowClass windowClass;
+	WindowClass windowClass(visible);
 	this->window = windowClass.getGlfwWindow();
 	int width, height;
 	glfwGetWindowSize(this->window, &width, &height);
@@ -120,7 +274,7 @@ Engine::~Engine()
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 	glDeleteProgram(programId);
-	glDeleteBuffers(1, &fullScreenQuadVBO);
+	DeleteGpuBuffers(1, &fullScreenQuadVBO);
 	glDeleteVertexArrays(1, &fullScreenQuadVAO);
 	INSTANCES.erase(windowId);
 
@@ -128,6 +282,8 @@ Engine::~Engine()
 
 void Engine::getSystemInfo() noexcept
 {
+	this->GPU = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+#ifdef _WIN64
 	int CPUInfo[4] = { -1 };
 	unsigned   nExIds, i = 0;
 	char CPUBrandString[0x40];
@@ -146,24 +302,44 @@ void Engine::getSystemInfo() noexcept
 			memcpy(CPUBrandString + 32, CPUInfo, sizeof(CPUInfo));
 	}
 	this->CPU = CPUBrandString;
-	this->GPU = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
 	MEMORYSTATUSEX statex;
 	statex.dwLength = sizeof(statex);
 	GlobalMemoryStatusEx(&statex);
 	this->memory = std::to_string((statex.ullTotalPhys / 1024) / 1024);
+#else
+	// The memory usage is shown from the SystemTelemetry samples instead.
+	this->CPU = SystemTelemetry::CpuModelName();
+#endif
 }
 
 void Engine::refreshMemoryInfo() noexcept
 {
+#ifdef _WIN64
 	MEMORYSTATUSEX statex;
 	statex.dwLength = sizeof(statex);
 	GlobalMemoryStatusEx(&statex);
 	this->usingMemory = std::to_string((statex.ullTotalPageFile - statex.ullAvailPageFile) / 1024 / 1024);
+#endif
+}
+
+// The sampler thread has no OpenGL context, so the GPU memory is queried here,
+// from time to time.
+void Engine::refreshGpuMemoryInfo()
+{
+	const double now = glfwGetTime();
+	if (lastGpuMemoryQueryTime >= 0.0 && now - lastGpuMemoryQueryTime < GPU_MEMORY_QUERY_SECONDS)
+		return;
+	lastGpuMemoryQueryTime = now;
+	uint64_t totalBytes;
+	uint64_t availableBytes;
+	if (QueryGpuMemory(&totalBytes, &availableBytes))
+		systemTelemetry->SetGpuMemory(totalBytes, availableBytes);
 }
 
 
 void Engine::initializeObjects()
 {
+	TRACE_SCOPE("Engine::initializeObjects");
 	glfwMakeContextCurrent(window);
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -191,13 +367,13 @@ void Engine::initializeObjects()
 	glfwSetFramebufferSizeCallback(this->window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(this->window, mouse_callback);
 	glfwSetKeyCallback(this->window, key_callback);
+	glfwSetScrollCallback(this->window, scroll_callback);
+	glfwSetCharCallback(this->window, char_callback);
+	glfwSetWindowRefreshCallback(this->window, window_refresh_callback);
 	glfwSetInputMode(this->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 
-	glfwSetMouseButtonCallback(window, [](GLFWwindow* win, int button, int action, int mods) {
-		Pointers* pointers = reinterpret_cast<Pointers*>(glfwGetWindowUserPointer(win));
-		pointers->sunDirection->handleMouseClickEvent(button, action, mods);
-	});
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
 
 	glfwMakeContextCurrent(this->window);
 
@@ -214,6 +390,7 @@ void Engine::initializeObjects()
 	  +1.0, +1.0, 0.0, 1.0,
 	};
 	glBufferData(GL_ARRAY_BUFFER, sizeof vertices, vertices, GL_STATIC_DRAW);
+	TrackGpuBuffer(fullScreenQuadVBO, GPU_MEMORY_SCENE, sizeof vertices);
 	constexpr GLuint kAttribIndex = 0;
 	constexpr int kCoordsPerVertex = 4;
 	glVertexAttribPointer(kAttribIndex, kCoordsPerVertex, GL_FLOAT, false, 0, 0);
@@ -221,6 +398,19 @@ void Engine::initializeObjects()
 	glBindVertexArray(0);
 
 	textRenderer.reset(new TextRenderer);
+	hdrRenderer.reset(new HdrRenderer);
+	if (useShadowMapLightShafts)
+		lightShafts.reset(new LightShafts);
+	jobPool.reset(new JobPool);
+	texturePool.reset(new TexturePool);
+	frameProfiler.reset(new GpuProfiler);
+	precomputeProfiler.reset(new GpuProfiler);
+	imguiClass->setGpuTimings(&frameProfiler->timings(), &precomputeProfiler->timings());
+	systemTelemetry.reset(new SystemTelemetry);
+	imguiClass->setSystemTelemetry(systemTelemetry.get());
+	frameTimeHistory.reset(new FrameTimeHistory(FRAME_TIME_HISTORY_SIZE,
+		{ "scene", "ui", "model update", "present" }));
+	imguiClass->setFrameTimeHistory(frameTimeHistory.get());
 	density = 1;
 	topHeight = 6420000.0;
 	rayleigh = 1.24062e-6;
@@ -234,126 +424,335 @@ void Engine::updateModel()
 
 void Engine::run()
 {
-	initializeObjects();
-	modelInit(density, topHeight, rayleigh, mie);
+	{
+		TRACE_SCOPE("startup");
+		initializeObjects();
+		if (useParameterAtlas)
+			buildParameterAtlas();
+		modelInit(density, topHeight, rayleigh, mie);
+	}
+	glfwSwapInterval(vsync ? 1 : 0);
+
+	std::unique_ptr<InputRecorder> inputRecorder;
+	if (!inputRecordingPath.empty())
+	{
+		inputRecorder.reset(new InputRecorder(inputRecordingPath, glfwGetTime()));
+		if (!inputRecorder->isOpen())
+			std::cerr << "Cannot record the input to " << inputRecordingPath << std::endl;
+		int width, height;
+		glfwGetFramebufferSize(this->window, &width, &height);
+		inputRecorder->record(make_input_event(InputEventType::SIZE, 0.0, 0.0, width, height),
+			glfwGetTime());
+		pointers.inputRecorder = inputRecorder.get();
+	}
 
 	while (!glfwWindowShouldClose(this->window)) {
-		handleRedisplayEvent();
+		const double frameStart = currentTime();
+		advanceSimulation(frameStart);
+		if (needsRedisplay())
+		{
+			handleRedisplayEvent();
+			limitFrameRate(frameStart);
+		}
+		else
+		{
+			glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+			// Nothing moves while idle, so the wait is not simulated.
+			previousFrameTime = currentTime();
+		}
 	}	
+	pointers.inputRecorder = nullptr;
+}
+
+void Engine::recordInput(const std::string& path)
+{
+	inputRecordingPath = path;
+	// The replay must start with the same window layout.
+	this->imguiClass->useDefaultLayout();
+}
+
+/*
+<p>A replay feeds the recorded events to the same callbacks as GLFW, at the
+simulated time of their recording, and advances the simulated clock (used
+instead of <code>glfwGetTime</code>) by a fixed <code>REPLAY_FRAME_SECONDS</code>
+per iteration of the main loop. The frames, and thus the model updates, are
+then the same for each replay, whatever the speed of the machine, and only
+their duration is measured. The live input is ignored meanwhile (but the window
+events are still processed):
+*/
+
+bool Engine::replayInput(const std::string& path, std::vector<double>* frameTimesMs)
+{
+	std::vector<InputEvent> events;
+	if (!readInputEvents(path, &events))
+		return false;
+	ReplayedMouse mouse;
+	pointers.replayedMouse = &mouse;
+	this->imguiClass->useDefaultLayout();
+	this->imguiClass->setReplayedInput(&mouse, REPLAY_FRAME_SECONDS);
+	replaying = true;
+	simulatedTime = 0.0;
+
+	{
+		TRACE_SCOPE("startup");
+		initializeObjects();
+		if (useParameterAtlas)
+			buildParameterAtlas();
+		modelInit(density, topHeight, rayleigh, mie);
+	}
+	glfwSwapInterval(0);
+	int width, height;
+	glfwGetFramebufferSize(this->window, &width, &height);
+	if (!events.empty() && events[0].type == InputEventType::SIZE &&
+		(events[0].values[0] != width || events[0].values[1] != height))
+	{
+		std::cerr << "Warning: the input was recorded with a " << events[0].values[0]
+			<< "x" << events[0].values[1] << " framebuffer, replayed at " << width
+			<< "x" << height << std::endl;
+	}
+
+	size_t nextEvent = 0;
+	while (!glfwWindowShouldClose(this->window))
+	{
+		simulatedTime += REPLAY_FRAME_SECONDS;
+		pointers.dispatchingReplay = true;
+		for (; nextEvent < events.size() && events[nextEvent].time <= simulatedTime; ++nextEvent)
+		{
+			applyInputEvent(events[nextEvent], &mouse);
+			dispatch_input_event(this->window, events[nextEvent]);
+		}
+		pointers.dispatchingReplay = false;
+
+		advanceSimulation(simulatedTime);
+		if (needsRedisplay())
+		{
+			const auto frameStart = std::chrono::steady_clock::now();
+			handleRedisplayEvent();
+			glFinish();
+			const std::chrono::duration<double, std::milli> frameTime =
+				std::chrono::steady_clock::now() - frameStart;
+			frameTimesMs->push_back(frameTime.count());
+		}
+		else if (nextEvent == events.size())
+		{
+			break;
+		}
+		else
+		{
+			glfwPollEvents();
+		}
+		// In case the last frames never settle (e.g. a constantly updated sky).
+		if (nextEvent == events.size() &&
+			simulatedTime > events.back().time + REPLAY_TAIL_SECONDS)
+			break;
+	}
+
+	this->imguiClass->setReplayedInput(nullptr, 0.0);
+	pointers.replayedMouse = nullptr;
+	replaying = false;
+	return true;
+}
+
+double Engine::currentTime() const
+{
+	return replaying ? simulatedTime : glfwGetTime();
+}
+
+void Engine::setFramePacing(bool vsync, double maxFrameRate)
+{
+	this->vsync = vsync;
+	this->maxFrameRate = maxFrameRate;
+	if (glfwGetCurrentContext() == this->window)
+		glfwSwapInterval(vsync ? 1 : 0);
+}
+
+void Engine::setShadowMapLightShafts(bool enabled)
+{
+	if (enabled == useShadowMapLightShafts)
+		return;
+	useShadowMapLightShafts = enabled;
+	if (!modelPointer)
+		return;
+	// The scene program must be linked with (or without) the light shafts
+	// shader, and their shadow map is only allocated when needed.
+	if (enabled)
+		lightShafts.reset(new LightShafts);
+	modelInit(density, topHeight, rayleigh, mie);
+	if (!enabled)
+		lightShafts.reset();
+}
+
+void Engine::setLutQuality(LutQuality quality)
+{
+	if (quality == lutQuality)
+		return;
+	lutQuality = quality;
+	if (!modelPointer)
+		return;
+	// The textures of the previous sizes can't be reused, so they are deleted
+	// before the new ones are allocated. The atlas models must have the same
+	// texture sizes as the current one.
+	const bool rebuildAtlas = !atlasModels.empty();
+	skyEnvironmentPointer.reset();
+	modelPointer.reset();
+	atlasModels.clear();
+	texturePool->Clear();
+	if (rebuildAtlas)
+		buildParameterAtlas();
+	modelInit(density, topHeight, rayleigh, mie);
+}
+
+void Engine::setParameterAtlas(const double densityRange[2], const double mieRange[2])
+{
+	useParameterAtlas = true;
+	atlasDensityRange[0] = densityRange[0];
+	atlasDensityRange[1] = densityRange[1];
+	atlasMieRange[0] = mieRange[0];
+	atlasMieRange[1] = mieRange[1];
+	if (modelPointer)
+		buildParameterAtlas();
+}
+
+/*
+<p>The simulation (for now the sun motion driven by the mouse) advances in
+fixed steps of <code>SEC_PER_TICK</code>, independently of the frame rate.
+Real time is accumulated and consumed one tick at a time; the remainder is
+used by <code>handleRedisplayEvent</code> to interpolate between the last two
+ticks.
+*/
+
+void Engine::advanceSimulation(double now)
+{
+	const double frameSeconds = std::min(now - previousFrameTime, MAX_FRAME_SECONDS);
+	previousFrameTime = now;
+	tickAccumulator += frameSeconds;
+	while (tickAccumulator >= SEC_PER_TICK)
+	{
+		this->sunDirection->update();
+		tickAccumulator -= SEC_PER_TICK;
+	}
+}
+
+void Engine::limitFrameRate(double frameStart) const
+{
+	if (vsync || maxFrameRate <= 0.0)
+		return;
+	const double remaining = frameStart + 1.0 / maxFrameRate - glfwGetTime();
+	if (remaining > 0.0)
+		std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+}
+
+/*
+<p>A frame is only drawn when something visible changed since the last one:
+an input or window event, the sun direction, the view parameters or the
+model. The previous image stays on screen otherwise, and <code>run</code>
+sleeps in <code>glfwWaitEventsTimeout</code> instead of spinning.
+*/
+
+bool Engine::needsRedisplay()
+{
+	const bool changed = pointers.redisplayRequested || viewChanged ||
+		this->sunDirection->isDirty();
+	pointers.redisplayRequested = false;
+	viewChanged = false;
+	this->sunDirection->clearDirty();
+
+	if (changed)
+	{
+		settleFrames = SETTLE_FRAMES;
+		lastChangeTime = currentTime();
+		return true;
+	}
+	if (settleFrames > 0)
+	{
+		--settleFrames;
+		return true;
+	}
+	if (skyEnvironmentPointer->IsUpdating() || modelIsBlended)
+		return true;
+	// The exposure keeps adapting for a while after the last change.
+	return currentTime() - lastChangeTime < hdrRenderer->AdaptationSeconds();
 }
 
 /*
 <p>The "real" initialization work, which is specific to  atmosphere model,
 is done in the following method. It starts with the creation of an atmosphere
 <code>Model</code> instance, with parameters corresponding to the Earth
-atmosphere:
+atmosphere (see <code>earth_model.h</code>, shared with the offline tools):
 */
 
-void Engine::modelInit(double density, double kTop, double kRay, double kMie)
+Model1* Engine::createModel(double density, double kTop, double kRay, double kMie,
+	std::vector<double>* wavelengthsOut, std::vector<double>* solarIrradianceOut) const
 {
-	// Values from "Reference Solar Spectral Irradiance: ASTM G-173", ETR column
-	// (see http://rredc.nrel.gov/solar/spectra/am1.5/ASTMG173/ASTMG173.html),
-	// summed and averaged in each bin (e.g. the value for 360nm is the average
-	// of the ASTM G-173 values for all wavelengths between 360 and 370nm).
-	// Values in W.m^-2.
-	constexpr int kLambdaMin = 360;
-	constexpr int kLambdaMax = 830;
-	constexpr double kSolarIrradiance[48] = {
-	  1.11776, 1.14259, 1.01249, 1.14716, 1.72765, 1.73054, 1.6887, 1.61253,
-	  1.91198, 2.03474, 2.02042, 2.02212, 1.93377, 1.95809, 1.91686, 1.8298,
-	  1.8685, 1.8931, 1.85149, 1.8504, 1.8341, 1.8345, 1.8147, 1.78158, 1.7533,
-	  1.6965, 1.68194, 1.64654, 1.6048, 1.52143, 1.55622, 1.5113, 1.474, 1.4482,
-	  1.41018, 1.36775, 1.34188, 1.31429, 1.28303, 1.26758, 1.2367, 1.2082,
-	  1.18737, 1.14683, 1.12362, 1.1058, 1.07124, 1.04992
-	};
-	// Values from http://www.iup.uni-bremen.de/gruppen/molspec/databases/
-	// referencespectra/o3spectra2011/index.html for 233K, summed and averaged in
-	// each bin (e.g. the value for 360nm is the average of the original values
-	// for all wavelengths between 360 and 370nm). Values in m^2.
-	constexpr double kOzoneCrossSection[48] = {
-	  1.18e-27, 2.182e-28, 2.818e-28, 6.636e-28, 1.527e-27, 2.763e-27, 5.52e-27,
-	  8.451e-27, 1.582e-26, 2.316e-26, 3.669e-26, 4.924e-26, 7.752e-26, 9.016e-26,
-	  1.48e-25, 1.602e-25, 2.139e-25, 2.755e-25, 3.091e-25, 3.5e-25, 4.266e-25,
-	  4.672e-25, 4.398e-25, 4.701e-25, 5.019e-25, 4.305e-25, 3.74e-25, 3.215e-25,
-	  2.662e-25, 2.238e-25, 1.852e-25, 1.473e-25, 1.209e-25, 9.423e-26, 7.455e-26,
-	  6.566e-26, 5.105e-26, 4.15e-26, 4.228e-26, 3.237e-26, 2.451e-26, 2.801e-26,
-	  2.534e-26, 1.624e-26, 1.465e-26, 2.078e-26, 1.383e-26, 7.105e-27
-	};
-	// From https://en.wikipedia.org/wiki/Dobson_unit, in molecules.m^-2.
-	constexpr double kDobsonUnit = 2.687e20;
-	// Maximum number density of ozone molecules, in m^-3 (computed so at to get
-	// 300 Dobson units of ozone - for this we divide 300 DU by the integral of
-	// the ozone density profile defined below, which is equal to 15km).
-	constexpr double kMaxOzoneNumberDensity = 300.0 * kDobsonUnit / 15000.0;
-	// Wavelength independent solar irradiance "spectrum" (not physically
-	// realistic, but was used in the original implementation).
-	constexpr double kConstantSolarIrradiance = 1.5;
-	constexpr double kBottomRadius = 6360000.0;
-	double kTopRadius = kTop;
-	double kRayleigh = kRay;
-	constexpr double kRayleighScaleHeight = 8000.0;
-	constexpr double kMieScaleHeight = 1200.0;
-	constexpr double kMieAngstromAlpha = 0.0;
-	double kMieAngstromBeta = kMie;
-	constexpr double kMieSingleScatteringAlbedo = 0.9;
-	constexpr double kMiePhaseFunctionG = 0.8;
-	constexpr double kGroundAlbedo = 0.1;
-	const double maxSunZenithAngle = (useHalfPrecision ? 102.0 : 120.0) / 180.0 * kPi;
-
-	DensityProfileLayer
-		rayleigh_layer(0.0, density, -1.0 / kRayleighScaleHeight, 0.0, 0.0);
-	DensityProfileLayer mie_layer(0.0, density, -1.0 / kMieScaleHeight, 0.0, 0.0);
-	// Density profile increasing linearly from 0 to 1 between 10 and 25km, and
-	// decreasing linearly from 1 to 0 between 25 and 40km. This is an approximate
-	// profile from http://www.kln.ac.lk/science/Chemistry/Teaching_Resources/
-	// Documents/Introduction%20to%20atmospheric%20chemistry.pdf (page 10).
-	std::vector<DensityProfileLayer> ozone_density;
-	ozone_density.push_back(
-		DensityProfileLayer(25000.0, 0.0, 0.0, 1.0 / 15000.0, -2.0 / 3.0));
-	ozone_density.push_back(
-		DensityProfileLayer(0.0, 0.0, 0.0, -1.0 / 15000.0, 8.0 / 3.0));
+	EarthModelOptions options;
+	options.density = density;
+	options.top_radius = kTop;
+	options.rayleigh = kRay;
+	options.mie = kMie;
+	options.constant_solar_spectrum = useConstantSolarSpectrum;
+	options.ozone = useOzone;
+	options.combined_textures = useCombinedTextures;
+	options.half_precision = useHalfPrecision;
+	options.num_precomputed_wavelengths = useLuminance == PRECOMPUTED ? 15 : 3;
+	options.resolution = LutResolutionForQuality(lutQuality);
+	return NewEarthModel(options, wavelengthsOut, solarIrradianceOut,
+		texturePool.get());
+}
 
-	std::vector<double> wavelengths;
-	std::vector<double> solarIrradiance;
-	std::vector<double> rayleighScattering;
-	std::vector<double> mieScattering;
-	std::vector<double> mieExtinction;
-	std::vector<double> absorptionExtinction;
-	std::vector<double> groundAlbedo;
-	for (int l = kLambdaMin; l <= kLambdaMax; l += 10) {
-		double lambda = static_cast<double>(l) * 1e-3;  // micro-meters
-		double mie =
-			kMieAngstromBeta / kMieScaleHeight * pow(lambda, -kMieAngstromAlpha);
-		wavelengths.push_back(l);
-		if (useConstantSolarSpectrum) {
-			solarIrradiance.push_back(kConstantSolarIrradiance);
-		}
-		else {
-			solarIrradiance.push_back(kSolarIrradiance[(l - kLambdaMin) / 10]);
+/*
+<p>The precomputed textures of a new model are then loaded from the LUT cache
+if possible (which only costs the texture upload), or precomputed, quantized
+and saved in the cache otherwise:
+*/
+
+void Engine::initModelTextures(Model1& model)
+{
+	TRACE_SCOPE("Engine::initModelTextures");
+	const std::string lutPath = lutCacheDirectory.empty() ?
+		std::string() : LutCachePath(lutCacheDirectory, model);
+	LutFile luts;
+	LutArchive lutArchive;
+	if (lutPath.empty() ||
+		!((luts.Open(lutPath) && model.InitFromLuts(luts)) ||
+		  (lutArchive.Open(lutPath + "z") &&
+		   model.InitFromLutArchive(lutArchive, jobPool.get()))))
+	{
+		precomputeProfiler->BeginFrame();
+		model.Init(4, nullptr, precomputeProfiler.get());
+		precomputeProfiler->EndFrame();
+		// The quantization only pays off for the cached textures, which are
+		// loaded many times (see the atmosphere_bake tool for its reports).
+		if (!lutPath.empty())
+		{
+			if (useQuantizedLuts)
+				model.QuantizeLuts(lutErrorBudget, nullptr, jobPool.get());
+			model.SaveLuts(lutPath);
 		}
-		rayleighScattering.push_back(kRayleigh * pow(lambda, -4));
-		mieScattering.push_back(mie * kMieSingleScatteringAlbedo);
-		mieExtinction.push_back(mie);
-		absorptionExtinction.push_back(useOzone ?
-			kMaxOzoneNumberDensity * kOzoneCrossSection[(l - kLambdaMin) / 10] :
-			0.0);
-		groundAlbedo.push_back(kGroundAlbedo);
 	}
+}
 
-	modelPointer.reset(new Model1(wavelengths, solarIrradiance, kSunAngularRadius,
-		kBottomRadius, kTopRadius, { rayleigh_layer }, rayleighScattering,
-		{ mie_layer }, mieScattering, mieExtinction, kMiePhaseFunctionG,
-		ozone_density, absorptionExtinction, groundAlbedo, maxSunZenithAngle,
-		kLengthUnitInMeters, useLuminance == PRECOMPUTED ? 15 : 3,
-		useCombinedTextures, useHalfPrecision));
-	modelPointer->Init();
+void Engine::modelInit(double density, double kTop, double kRay, double kMie)
+{
+	TRACE_SCOPE("Engine::modelInit");
+	std::vector<double> wavelengths;
+	std::vector<double> solarIrradiance;
+	// The previous model is deleted first, so that the new one reuses its
+	// textures (and those of its precomputations) instead of allocating new
+	// ones while the old ones are still alive.
+	skyEnvironmentPointer.reset();
+	modelPointer.reset();
+	modelPointer.reset(createModel(density, kTop, kRay, kMie,
+		&wavelengths, &solarIrradiance));
 
 	/*
 	<p>Then, it creates and compiles the vertex and fragment shaders used to render
 	our App scene, and link them with the <code>Model</code>'s atmosphere shader
-	to get the final scene rendering program:
+	to get the final scene rendering program. This is only submitted here, before
+	the precomputations, so that the driver can compile this program while they
+	run (its status is checked after them, see <code>FinishProgramLink</code>):
 	*/
 
+	const int64_t submitBeginNs = TraceNanoseconds();
 	vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	const char* const vertex_shader_source = kVertexShader;
 	glShaderSource(vertexShader, 1, &vertex_shader_source, NULL);
@@ -362,6 +761,7 @@ void Engine::modelInit(double density, double kTop, double kRay, double kMie)
 	const std::string fragment_shader_str =
 		"#version 330\n" +
 		std::string(useLuminance != NONE ? "#define USE_LUMINANCE\n" : "") +
+		std::string(useShadowMapLightShafts ? "#define USE_SHADOW_MAP_LIGHT_SHAFTS\n" : "") +
 		"const float kLengthUnitInMeters = " +
 		std::to_string(kLengthUnitInMeters) + ";\n" +
 		demo_glsl;
@@ -377,10 +777,22 @@ void Engine::modelInit(double density, double kTop, double kRay, double kMie)
 	glAttachShader(programId, vertexShader);
 	glAttachShader(programId, fragmentShader);
 	glAttachShader(programId, modelPointer->shader());
+	if (useShadowMapLightShafts)
+		glAttachShader(programId, lightShafts->shader());
 	glLinkProgram(programId);
 	glDetachShader(programId, vertexShader);
 	glDetachShader(programId, fragmentShader);
 	glDetachShader(programId, modelPointer->shader());
+	if (useShadowMapLightShafts)
+		glDetachShader(programId, lightShafts->shader());
+	const int64_t submitEndNs = TraceNanoseconds();
+
+	initModelTextures(*modelPointer);
+	modelIsBlended = false;
+	std::vector<GLuint> shaders = { vertexShader, fragmentShader, modelPointer->shader() };
+	if (useShadowMapLightShafts)
+		shaders.push_back(lightShafts->shader());
+	FinishProgramLink(programId, shaders, "scene program", submitBeginNs, submitEndNs);
 
 	/*
 	<p>Finally, it sets the uniforms of this program that can be set once and for
@@ -390,6 +802,8 @@ void Engine::modelInit(double density, double kTop, double kRay, double kMie)
 
 	glUseProgram(programId);
 	modelPointer->setProgramUniforms(programId, 0, 1, 2, 3);
+	skyEnvironmentPointer.reset(new SkyEnvironment(*modelPointer, useLuminance != NONE));
+	glUseProgram(programId);
 	double whitePointR = 1.0;
 	double whitePointG = 1.0;
 	double whitePointB = 1.0;
@@ -413,17 +827,93 @@ void Engine::modelInit(double density, double kTop, double kRay, double kMie)
 	const GLFWvidmode* mode = glfwGetVideoMode(primary);
 
 	handleReshapeEvent(mode->width, mode->height);
+	viewChanged = true;
+	// Keep the precomputation time out of the simulation clock.
+	previousFrameTime = currentTime();
+}
 
+/*
+<p>In atlas mode, the models of the parameter grid are created once at startup
+(and loaded from the LUT cache if possible). Slider changes inside the grid
+then blend the textures of the 4 nearest models, bilinearly, into the textures
+of the current model, which is much faster than a precomputation. The shaders
+of the current model are kept, so that the parameters compiled into them
+(e.g. the Mie extinction for the aerial perspective of the analytic shadow
+volumes) lag behind until the exact model replaces the blend:
+*/
+
+void Engine::buildParameterAtlas()
+{
+	TRACE_SCOPE("Engine::buildParameterAtlas");
+	// Compiled while the grid models are loaded, so that the first slider
+	// change does not wait for it.
+	Model1::PrepareBlendLuts();
+	atlasModels.clear();
+	for (int j = 0; j < ATLAS_GRID_SIZE; ++j)
+	{
+		for (int i = 0; i < ATLAS_GRID_SIZE; ++i)
+		{
+			const double gridDensity = atlasDensityRange[0] +
+				(atlasDensityRange[1] - atlasDensityRange[0]) * i / (ATLAS_GRID_SIZE - 1);
+			const double gridMie = atlasMieRange[0] +
+				(atlasMieRange[1] - atlasMieRange[0]) * j / (ATLAS_GRID_SIZE - 1);
+			std::unique_ptr<Model1> model(createModel(gridDensity, topHeight, rayleigh, gridMie));
+			initModelTextures(*model);
+			atlasModels.push_back(std::move(model));
+		}
+	}
+	atlasTopHeight = topHeight;
+	atlasRayleigh = rayleigh;
+	this->imguiClass->setAtlasMode(true);
+}
+
+bool Engine::blendParameterAtlas(double density, double kMie)
+{
+	if (atlasModels.empty() || topHeight != atlasTopHeight || rayleigh != atlasRayleigh)
+		return false;
+	const double u = (density - atlasDensityRange[0]) /
+		(atlasDensityRange[1] - atlasDensityRange[0]) * (ATLAS_GRID_SIZE - 1);
+	const double v = (kMie - atlasMieRange[0]) /
+		(atlasMieRange[1] - atlasMieRange[0]) * (ATLAS_GRID_SIZE - 1);
+	if (u < 0.0 || u > ATLAS_GRID_SIZE - 1 || v < 0.0 || v > ATLAS_GRID_SIZE - 1)
+		return false;
+	const int i = std::min(static_cast<int>(u), ATLAS_GRID_SIZE - 2);
+	const int j = std::min(static_cast<int>(v), ATLAS_GRID_SIZE - 2);
+	const double fu = u - i;
+	const double fv = v - j;
+	const std::vector<const Model1*> models = {
+		atlasModels[j * ATLAS_GRID_SIZE + i].get(),
+		atlasModels[j * ATLAS_GRID_SIZE + i + 1].get(),
+		atlasModels[(j + 1) * ATLAS_GRID_SIZE + i].get(),
+		atlasModels[(j + 1) * ATLAS_GRID_SIZE + i + 1].get()
+	};
+	const std::vector<double> weights = {
+		(1.0 - fu) * (1.0 - fv), fu * (1.0 - fv), (1.0 - fu) * fv, fu * fv
+	};
+	modelPointer->BlendLuts(models, weights);
+	skyEnvironmentPointer->Invalidate();
+	modelIsBlended = true;
+	return true;
 }
 
 /*
-<p>The scene rendering method simply sets the uniforms related to the camera
-position and to the Sun direction, and then draws a full screen quad (and
-optionally a help screen).
+<p>The scene itself is drawn by the following method, shared by the window
+and by the offscreen rendering of image sequences. It renders into the HDR
+framebuffer and tonemaps the result into the output framebuffer of
+<code>hdrRenderer</code>:
 */
 
-void Engine::handleRedisplayEvent()
+void Engine::renderScene(int width, int height, double sunZenith, double sunAzimuth,
+	double frameSeconds)
 {
+	hdrRenderer->Resize(width, height);
+	hdrRenderer->SetManualExposure(useLuminance != NONE ? exposure * 1e-5 : exposure);
+	hdrRenderer->BeginScene();
+
+	// The post-processing passes use texture units of their own.
+	glUseProgram(programId);
+	modelPointer->setProgramUniforms(programId, 0, 1, 2, 3);
+
 	// Unit vectors of the camera frame, expressed in world space.
 	float cosZ = cos(viewZenithAngleRadians);
 	float sinZ = sin(viewZenithAngleRadians);
@@ -447,32 +937,135 @@ void Engine::handleRedisplayEvent()
 		modelFromView[3],
 		modelFromView[7],
 		modelFromView[11]);
-	glUniform1f(glGetUniformLocation(programId, "exposure"),
-		useLuminance != NONE ? exposure * 1e-5 : exposure);
 	glUniformMatrix4fv(glGetUniformLocation(programId, "model_from_view"),
 		1, true, modelFromView);
+	const std::array<float, 3> sunDirectionVector = {{
+		static_cast<float>(cos(sunAzimuth) * sin(sunZenith)),
+		static_cast<float>(sin(sunAzimuth) * sin(sunZenith)),
+		static_cast<float>(cos(sunZenith)) }};
 	glUniform3f(glGetUniformLocation(programId, "sun_direction"),
-		cos(this->sunDirection->sunAzimuthAngleRadians) * sin(this->sunDirection->sunZenithAngleRadians),
-		sin(this->sunDirection->sunAzimuthAngleRadians) * sin(this->sunDirection->sunZenithAngleRadians),
-		cos(this->sunDirection->sunZenithAngleRadians));
+		sunDirectionVector[0], sunDirectionVector[1], sunDirectionVector[2]);
+
+	// Spread the environment map updates over the frames (this restores the
+	// framebuffer and viewport, but not the program).
+	const std::array<float, 3> cameraFromEarthCenter = {{
+		modelFromView[3], modelFromView[7],
+		modelFromView[11] + static_cast<float>(kBottomRadius / kLengthUnitInMeters) }};
+	GpuProfilerScope passScope(frameProfiler.get(), "sky environment");
+	skyEnvironmentPointer->Update(cameraFromEarthCenter, sunDirectionVector);
+
+	// Same for the light shafts: render the occluders into the shadow map, and
+	// sample the view rays along the epipolar lines.
+	if (useShadowMapLightShafts)
+	{
+		passScope.Next("light shafts");
+		const std::array<float, 3> camera = {{
+			modelFromView[3], modelFromView[7], modelFromView[11] }};
+		const std::array<float, 3> earthCenter = {{
+			0.0f, 0.0f, static_cast<float>(-kBottomRadius / kLengthUnitInMeters) }};
+		lightShafts->BeginShadowPass(camera, sunDirectionVector);
+		lightShafts->DrawSphereOccluder(
+			{{ 0.0f, 0.0f, static_cast<float>(kSphereCenterZ / kLengthUnitInMeters) }},
+			static_cast<float>(kSphereRadius / kLengthUnitInMeters));
+		lightShafts->EndShadowPass();
+		lightShafts->ComputeSamples(modelFromView, viewFromClip, earthCenter,
+			width, height);
+	}
+	passScope.Next("atmosphere");
+	glUseProgram(programId);
+	if (useShadowMapLightShafts)
+		lightShafts->setProgramUniforms(programId, 4);
 
 	glBindVertexArray(fullScreenQuadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	glBindVertexArray(0);
 
+	passScope.Next("tonemapping");
+	hdrRenderer->EndScene(frameSeconds);
+}
+
+/*
+<p>The scene rendering method simply sets the uniforms related to the camera
+position and to the Sun direction, and then draws a full screen quad (and
+optionally a help screen). The quad is drawn into the HDR framebuffer of
+<code>hdrRenderer</code>, which adapts the exposure and tonemaps the result
+before the UI is drawn on top.
+*/
+
+/*
+<p>The frame time history records the wall time of each drawn frame, from the
+start of this method to the end of the buffer swap (which blocks with vsync),
+split into CPU stages. The time of the synchronous model updates (after a
+parameter change) thus shows up as spikes in its tail, which the averaged
+ImGui frame rate hides:
+*/
+
+void Engine::handleRedisplayEvent()
+{
+	TRACE_SCOPE("frame");
+	typedef std::chrono::steady_clock Clock;
+	const auto milliseconds = [](Clock::time_point begin, Clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	};
+	const Clock::time_point frameStart = Clock::now();
+	const double now = currentTime();
+	const double frameSeconds = std::min(now - lastRenderTime, MAX_FRAME_SECONDS);
+	lastRenderTime = now;
+
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(this->window, &framebufferWidth, &framebufferHeight);
+	const double alpha = tickAccumulator / SEC_PER_TICK;
+	precomputeProfiler->Poll();
+	frameProfiler->BeginFrame();
+	{
+		GpuProfilerScope sceneScope(frameProfiler.get(), "scene");
+		renderScene(framebufferWidth, framebufferHeight,
+			this->sunDirection->interpolatedZenithAngle(alpha),
+			this->sunDirection->interpolatedAzimuthAngle(alpha), frameSeconds);
+	}
+	const Clock::time_point sceneEnd = Clock::now();
+
 	double dummyDensity = density;
 	double dummyTopHeight = topHeight;
 	double dummyRayleigh = rayleigh;
 	double dummyMie = mie;
 	
-	imguiClass->renderDrawData(GPU, CPU, memory, usingMemory, density, topHeight, rayleigh, mie); //always at the end
+	refreshGpuMemoryInfo();
+	{
+		GpuProfilerScope imguiScope(frameProfiler.get(), "imgui");
+		imguiClass->renderDrawData(GPU, CPU, memory, usingMemory, inputLatency * 1000.0,
+			density, topHeight, rayleigh, mie); //always at the end
+	}
+	frameProfiler->EndFrame();
+	const Clock::time_point uiEnd = Clock::now();
 
 	if(density != dummyDensity || dummyMie != mie || dummyRayleigh != rayleigh || dummyTopHeight != topHeight)
+	{
+		lastParameterChangeTime = currentTime();
+		if (!useParameterAtlas || !blendParameterAtlas(density, mie))
+			modelInit(density, topHeight, rayleigh, mie);
+	}
+	else if (modelIsBlended && currentTime() - lastParameterChangeTime > ATLAS_SETTLE_SECONDS)
 	{
 		modelInit(density, topHeight, rayleigh, mie);
 	}
+	const Clock::time_point modelUpdateEnd = Clock::now();
 	
-    glfwSwapBuffers(this->window);
+	{
+		TRACE_SCOPE("present");
+		glfwSwapBuffers(this->window);
+	}
+	const Clock::time_point frameEnd = Clock::now();
+	frameTimeHistory->AddFrame(milliseconds(frameStart, frameEnd), {
+		milliseconds(frameStart, sceneEnd), milliseconds(sceneEnd, uiEnd),
+		milliseconds(uiEnd, modelUpdateEnd), milliseconds(modelUpdateEnd, frameEnd) });
+
+	// Input to present latency, once every queued input has reached the screen.
+	if (pointers.oldestInputTime >= 0.0 && !this->sunDirection->hasPendingInput())
+	{
+		inputLatency = glfwGetTime() - pointers.oldestInputTime;
+		pointers.oldestInputTime = -1.0;
+	}
 	glfwPollEvents();	
 }
 
@@ -491,13 +1084,15 @@ void Engine::handleReshapeEvent(int viewport_width, int viewport_height)
 
 	// Transform matrix from clip space to camera space (i.e. the inverse of a
 	// GL_PROJECTION matrix).
-	float viewFromClip[16] = {
+	const float matrix[16] = {
 	  kTanFovY * aspect_ratio, 0.0, 0.0, 0.0,
 	  0.0, kTanFovY, 0.0, 0.0,
 	  0.0, 0.0, 0.0, -1.0,
 	  0.0, 0.0, 1.0, 1.0
 	};
+	std::copy(matrix, matrix + 16, viewFromClip);
 	glUniformMatrix4fv(glGetUniformLocation(programId, "view_from_clip"), 1, true, viewFromClip);
+	viewChanged = true;
 } 
 
 
@@ -506,10 +1101,94 @@ void Engine::setView(double viewDistanceMeters,
 	double sunZenithAngleRadians, double sunAzimuthAngleRadians,
 	double exposure)
 {
-	viewDistanceMeters = viewDistanceMeters;
-	viewZenithAngleRadians = viewZenithAngleRadians;
-	viewAzimuthAngleRadians = viewAzimuthAngleRadians;
-	this->sunDirection->sunZenithAngleRadians = sunZenithAngleRadians;
-	this->sunDirection->sunAzimuthAngleRadians = sunAzimuthAngleRadians;
-	exposure = exposure;
+	this->viewDistanceMeters = viewDistanceMeters;
+	this->viewZenithAngleRadians = viewZenithAngleRadians;
+	this->viewAzimuthAngleRadians = viewAzimuthAngleRadians;
+	this->sunDirection->setAngles(sunZenithAngleRadians, sunAzimuthAngleRadians);
+	this->exposure = exposure;
+	viewChanged = true;
+}
+
+/*
+<p>Image sequences are rendered offscreen, at a fixed size and with the exposure
+of each pose, into a framebuffer of their own. The frames are read back
+asynchronously, through a few pixel pack buffers, and encoded on the job pool
+while the next frames are rendered. The PNG files contain the tonemapped
+frames, and the PFM files (in HDR mode) the radiance before tonemapping:
+*/
+
+bool Engine::renderSequence(const std::vector<RenderPose>& poses, int width, int height,
+	const std::string& outputDirectory, bool hdr)
+{
+	initializeObjects();
+	modelInit(density, topHeight, rayleigh, mie);
+
+	GLuint outputTexture;
+	glGenTextures(1, &outputTexture);
+	glBindTexture(GL_TEXTURE_2D, outputTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, NULL);
+	TrackGpuTexture(outputTexture, GPU_MEMORY_SCENE, GlTextureBytes(GL_RGBA8, width, height));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GLuint outputFramebuffer;
+	glGenFramebuffers(1, &outputFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+		outputTexture, 0);
+	const bool complete =
+		glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	bool success = complete;
+	if (complete)
+	{
+		const bool autoExposure = hdrRenderer->auto_exposure();
+		hdrRenderer->SetAutoExposure(false);
+		hdrRenderer->SetOutputFramebuffer(outputFramebuffer);
+		handleReshapeEvent(width, height);
+
+		FrameReadback readback(SEQUENCE_READBACK_BUFFERS, jobPool.get(),
+			SEQUENCE_PENDING_ENCODINGS);
+		for (size_t i = 0; i < poses.size(); ++i)
+		{
+			const RenderPose& pose = poses[i];
+			this->viewDistanceMeters = pose.viewDistanceMeters;
+			this->viewZenithAngleRadians = pose.viewZenithAngleRadians;
+			this->viewAzimuthAngleRadians = pose.viewAzimuthAngleRadians;
+			this->exposure = pose.exposure;
+			renderScene(width, height, pose.sunZenithAngleRadians,
+				pose.sunAzimuthAngleRadians, 0.0);
+
+			char fileName[32];
+			snprintf(fileName, sizeof(fileName), "frame_%05d.%s",
+				static_cast<int>(i), hdr ? "pfm" : "png");
+			const std::string path = outputDirectory + "/" + fileName;
+			if (hdr)
+			{
+				readback.Read(hdrRenderer->hdr_framebuffer(), width, height, GL_RGB,
+					GL_FLOAT, 3 * sizeof(float),
+					[path, width, height](const std::vector<unsigned char>& pixels) {
+						return WritePfm(path, width, height,
+							reinterpret_cast<const float*>(pixels.data()));
+					});
+			}
+			else
+			{
+				readback.Read(outputFramebuffer, width, height, GL_RGBA,
+					GL_UNSIGNED_BYTE, 4,
+					[path, width, height](const std::vector<unsigned char>& pixels) {
+						return WritePng(path, width, height, pixels.data());
+					});
+			}
+		}
+		success = readback.Finish();
+
+		hdrRenderer->SetOutputFramebuffer(0);
+		hdrRenderer->SetAutoExposure(autoExposure);
+	}
+	glDeleteFramebuffers(1, &outputFramebuffer);
+	DeleteGpuTextures(1, &outputTexture);
+	return success;
 }
@@ -2,10 +2,21 @@
 #include "ENGINE/WindowClass.h"
 #include "ENGINE/InputEngine.h"
 #include "ENGINE/EngineInputFunctions.h"
+#include "ENGINE/InputRecording.h"
 #include "IMGUI/ImguiClass.h"
 #include <string>
 #include "MODEL/model1.h"
+#include "MODEL/earth_model.h"
+#include "MODEL/texture_pool.h"
+#include "CORE/frame_time_history.h"
+#include "CORE/job_pool.h"
+#include "CORE/system_telemetry.h"
 #include "TEXT/text_renderer.h"
+#include "RENDER/frame_readback.h"
+#include "RENDER/gpu_profiler.h"
+#include "RENDER/hdr_renderer.h"
+#include "RENDER/light_shafts.h"
+#include "RENDER/sky_environment.h"
 #include "MATHS/SunDirection.h"
 
 #ifdef _WIN64
@@ -22,10 +33,56 @@ const int TICKS_PER_SECOND = 60;
 const float SEC_PER_TICK = 1.0f / TICKS_PER_SECOND;
 const float MS_PER_TICK = 1000.0f / TICKS_PER_SECOND;
 
+// How long run() blocks waiting for events when nothing on screen changed.
+const double IDLE_WAIT_SECONDS = 0.25;
+// ImGui reacts to input one frame late, so a few more frames are drawn after
+// the last change to let its widgets settle.
+const int SETTLE_FRAMES = 3;
+// Longest frame fed to the simulation; slower frames (model precompute, a
+// stalled swap) are clamped rather than replayed as a burst of ticks.
+const double MAX_FRAME_SECONDS = 0.25;
+// Number of density and Mie values of the parameter atlas grid.
+const int ATLAS_GRID_SIZE = 3;
+// How long the atlas blend is shown after the last parameter change, before
+// the exact model is precomputed.
+const double ATLAS_SETTLE_SECONDS = 0.5;
+// Pixel pack buffers in flight when rendering an image sequence, and frames
+// waiting for an encoder thread.
+const int SEQUENCE_READBACK_BUFFERS = 3;
+const int SEQUENCE_PENDING_ENCODINGS = 8;
+// Simulated duration of each frame of an input replay, and how long a replay
+// keeps drawing after the last event if the frames don't settle before.
+const double REPLAY_FRAME_SECONDS = 1.0 / TICKS_PER_SECOND;
+const double REPLAY_TAIL_SECONDS = 5.0;
+// Number of frames in the frame time history (see Engine::handleRedisplayEvent).
+const int FRAME_TIME_HISTORY_SIZE = 600;
+// Period of the GPU memory queries (see Engine::refreshGpuMemoryInfo).
+const double GPU_MEMORY_QUERY_SECONDS = 1.0;
+
+// A camera and sun pose of an image sequence (see Engine::renderSequence).
+struct RenderPose
+{
+	double viewDistanceMeters;
+	double viewZenithAngleRadians;
+	double viewAzimuthAngleRadians;
+	double sunZenithAngleRadians;
+	double sunAzimuthAngleRadians;
+	double exposure;
+};
+
  struct Pointers
 {
 	InputEngine<EngineInputFunctions> *inputEngine = nullptr;
 	SunDirection *sunDirection = nullptr;
+	bool redisplayRequested = true;
+	// glfwGetTime() of the oldest input event not presented yet, or -1.
+	double oldestInputTime = -1.0;
+	// Where the input events are recorded, if not null.
+	InputRecorder *inputRecorder = nullptr;
+	// During a replay, the replayed mouse state, and whether the callbacks are
+	// called with a replayed event (instead of a live one, which is ignored).
+	ReplayedMouse *replayedMouse = nullptr;
+	bool dispatchingReplay = false;
  	
 	Pointers::~Pointers()
 	{
@@ -50,6 +107,7 @@ private:
 private:
 	void getSystemInfo() noexcept;
 	void refreshMemoryInfo() noexcept;
+	void refreshGpuMemoryInfo();
 
 	enum Luminance {
 		// Render the spectral radiance at kLambdaR, kLambdaG, kLambdaB.
@@ -61,14 +119,27 @@ private:
 
 		PRECOMPUTED
 	};
+	// glfwGetTime(), or the simulated time during a replay.
+	double currentTime() const;
+	void advanceSimulation(double now);
+	bool needsRedisplay();
+	void limitFrameRate(double frameStart) const;
 	void handleRedisplayEvent() ;
+	void renderScene(int width, int height, double sunZenith, double sunAzimuth,
+		double frameSeconds);
 	void handleReshapeEvent(int viewport_width, int viewport_height);
 
 	void setView(double viewDistanceMeters, double viewZenithAngleRadians,
 				double viewAzimuthAngleRadians, double sunZenithAngleRadians,
 				double sunAzimuthAngleRadians, double exposure);
 
+	Model1* createModel(double density, double kTop, double kRay, double kMie,
+		std::vector<double>* wavelengths = nullptr,
+		std::vector<double>* solarIrradiance = nullptr) const;
+	void initModelTextures(Model1& model);
 	void modelInit(double density, double kTop, double kRay, double kMie);
+	void buildParameterAtlas();
+	bool blendParameterAtlas(double density, double kMie);
 
 	bool useConstantSolarSpectrum;
 	bool useOzone;
@@ -76,20 +147,80 @@ private:
 	bool useHalfPrecision;
 	Luminance useLuminance;
 	bool doWhiteBalance;
+	// Light shafts from the shadow map of the scene occluders, instead of the
+	// analytic shadow volume of the sphere (exact for the current scene, and
+	// much cheaper). Disabled by default.
+	bool useShadowMapLightShafts;
+	// Directory of the LUT files (or of their compressed archives), loaded
+	// instead of precomputing the model when they exist, and saved after each
+	// precomputation (if the directory exists). Empty to disable.
+	std::string lutCacheDirectory;
+	// Converts the precomputed textures to smaller formats, within the error
+	// budget (see lut_quantization.h), before they are cached.
+	bool useQuantizedLuts;
+	LutErrorBudget lutErrorBudget;
+	// The texture sizes of the models (see lut_resolution.h).
+	LutQuality lutQuality;
+	// Prebakes the models of a coarse grid over the density and Mie ranges,
+	// and blends the nearest ones while these sliders move (for the current
+	// top height and Rayleigh constant only). The exact model is precomputed
+	// once the sliders settle. Disabled by default (see setParameterAtlas).
+	bool useParameterAtlas;
+	double atlasDensityRange[2];
+	double atlasMieRange[2];
 
+	// The textures of all the models, reused when they are rebuilt (declared
+	// first, since it must outlive them).
+	std::unique_ptr<TexturePool> texturePool;
 	std::unique_ptr<Model1> modelPointer;
+	std::unique_ptr<SkyEnvironment> skyEnvironmentPointer;
+	// ATLAS_GRID_SIZE^2 models, density first.
+	std::vector<std::unique_ptr<Model1>> atlasModels;
+	double atlasTopHeight;
+	double atlasRayleigh;
+	// Whether the textures of modelPointer are an atlas blend.
+	bool modelIsBlended;
+	double lastParameterChangeTime;
 	GLuint vertexShader;
 	GLuint fragmentShader;
 	GLuint programId;
 	GLuint fullScreenQuadVAO;
 	GLuint fullScreenQuadVBO;
 	std::unique_ptr<TextRenderer> textRenderer;
+	std::unique_ptr<HdrRenderer> hdrRenderer;
+	std::unique_ptr<LightShafts> lightShafts;
+	std::unique_ptr<JobPool> jobPool;
+	// GPU times of the passes of each frame, and of the stages of the last
+	// precomputation (shown in the UI).
+	std::unique_ptr<GpuProfiler> frameProfiler;
+	std::unique_ptr<GpuProfiler> precomputeProfiler;
+	// Memory and CPU usage, sampled in the background (shown in the UI).
+	std::unique_ptr<SystemTelemetry> systemTelemetry;
+	// Durations of the last frames and of their CPU stages (shown in the UI).
+	std::unique_ptr<FrameTimeHistory> frameTimeHistory;
+	double lastGpuMemoryQueryTime;
 	int windowId;
 
 	double viewDistanceMeters;
 	double viewZenithAngleRadians;
 	double viewAzimuthAngleRadians;
 	double exposure;
+	float viewFromClip[16];
+
+	bool viewChanged;
+	int settleFrames;
+
+	double previousFrameTime;
+	double tickAccumulator;
+	bool vsync;
+	double maxFrameRate;
+	double inputLatency;
+	double lastChangeTime;
+	double lastRenderTime;
+	// See recordInput and replayInput.
+	std::string inputRecordingPath;
+	bool replaying;
+	double simulatedTime;
 
 
 public:
@@ -99,15 +230,50 @@ public:
 	double mie;
 
 	const Model1& model1() const { return *modelPointer; }
+	const SkyEnvironment& skyEnvironment() const { return *skyEnvironmentPointer; }
 	const GLuint vertex_shader() const { return vertexShader; }
 	const GLuint fragment_shader() const { return fragmentShader; }
 	const GLuint program() const { return programId; }
 
 
-	Engine();
+	// Without 'visible', the window is hidden (see renderSequence).
+	explicit Engine(bool visible = true);
 	~Engine();
 
 	void run();
+	// Renders each pose into an offscreen framebuffer of the given size, and
+	// writes the tonemapped images as PNG files (or the linear radiance as PFM
+	// files if 'hdr') in 'outputDirectory', named frame_00000.png, etc. The
+	// readbacks and the file encodings overlap with the rendering of the next
+	// frames. Returns false if a file could not be written.
+	bool renderSequence(const std::vector<RenderPose>& poses, int width, int height,
+		const std::string& outputDirectory, bool hdr);
+	// Renders at the display refresh rate with 'vsync', otherwise at most
+	// 'maxFrameRate' frames per second (unlimited if 0). The simulation always
+	// advances at TICKS_PER_SECOND.
+	void setFramePacing(bool vsync, double maxFrameRate);
+	// Renders the light shafts with a shadow map of the scene occluders
+	// instead of the analytic sphere shadow, and relinks the scene program if
+	// the engine is running (the model is reloaded from the LUT cache if
+	// possible).
+	void setShadowMapLightShafts(bool enabled);
+	// Selects the texture sizes of the models, and recreates them if the
+	// engine is running (from the LUT cache if possible).
+	void setLutQuality(LutQuality quality);
+	// Enables the parameter atlas, with a grid over the given [min, max]
+	// density and Mie ranges (min < max), and builds it if the engine is
+	// running.
+	void setParameterAtlas(const double densityRange[2], const double mieRange[2]);
+	// Records the input events of the next run() to 'path' (see
+	// InputRecording.h).
+	void recordInput(const std::string& path);
+	// Initializes the engine, like run(), but replays the input events recorded
+	// in 'path' instead of handling the live ones, at a fixed simulated time of
+	// REPLAY_FRAME_SECONDS per frame. Returns the duration of each drawn frame
+	// (including its GPU work) in 'frameTimesMs', or false if the events could
+	// not be read.
+	bool replayInput(const std::string& path, std::vector<double>* frameTimesMs);
+	double inputLatencySeconds() const { return inputLatency; }
 	void initializeObjects();
 	void updateModel();
 
@@ -1,7 +1,10 @@
 #pragma once
 #include "GLFW/glfw3.h"
 #include <ENGINE/Engine.h>
+#include "CORE/trace.h"
 #include <algorithm>
+#include <ctime>
+#include <iostream>
 
 class EngineInputFunctions
 {
@@ -37,4 +40,16 @@ private:
 			firstMouse = false;
 		}
 	}
+
+	// Writes the recorded trace zones to a new file of the working directory.
+	void dumpTrace() const
+	{
+		char path[64];
+		const std::time_t now = std::time(nullptr);
+		std::strftime(path, sizeof(path), "trace_%Y%m%d_%H%M%S.json", std::localtime(&now));
+		if (WriteChromeTrace(path))
+			std::cout << "Trace written to " << path << std::endl;
+		else
+			std::cerr << "Cannot write the trace to " << path << std::endl;
+	}
 };
@@ -16,6 +16,9 @@ public:
 		this->functions = new EngineInputFunctions(window);
 		addBinding(GLFW_KEY_ESCAPE, &EngineInputFunctions::escapeKey);
 		addBinding(GLFW_KEY_P, &EngineInputFunctions::mouseCursor);
+#if ATMOSPHERE_TRACING
+		addBinding(GLFW_KEY_F12, &EngineInputFunctions::dumpTrace);
+#endif
 	}
 	
 	InputEngine::~InputEngine()
@@ -0,0 +1,87 @@
+#include "InputRecording.h"
+#include "GLFW/glfw3.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+	const char* const EVENT_NAMES[] = { "size", "cursor", "button", "key", "scroll", "char" };
+	// The number of int values of each event type (the others have x and y).
+	const int EVENT_VALUE_COUNTS[] = { 2, 0, 3, 4, 0, 1 };
+}
+
+InputRecorder::InputRecorder(const std::string& path, double now) :
+	file(path),
+	startTime(now)
+{
+	// Enough digits to replay the exact cursor positions and times.
+	this->file.precision(std::numeric_limits<double>::max_digits10);
+}
+
+void InputRecorder::record(InputEvent event, double now)
+{
+	if (!this->file.is_open())
+		return;
+	const int type = static_cast<int>(event.type);
+	this->file << now - this->startTime << " " << EVENT_NAMES[type];
+	if (EVENT_VALUE_COUNTS[type] == 0)
+		this->file << " " << event.x << " " << event.y;
+	for (int i = 0; i < EVENT_VALUE_COUNTS[type]; ++i)
+		this->file << " " << event.values[i];
+	// Flushed per event, so that the recording survives a crash.
+	this->file << std::endl;
+}
+
+bool readInputEvents(const std::string& path, std::vector<InputEvent>* events)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+		std::istringstream fields(line);
+		InputEvent event;
+		std::string name;
+		bool valid = static_cast<bool>(fields >> event.time >> name);
+		const char* const* found = std::find(std::begin(EVENT_NAMES), std::end(EVENT_NAMES), name);
+		valid = valid && found != std::end(EVENT_NAMES);
+		if (valid)
+		{
+			const int type = static_cast<int>(found - std::begin(EVENT_NAMES));
+			event.type = static_cast<InputEventType>(type);
+			if (EVENT_VALUE_COUNTS[type] == 0)
+				valid = static_cast<bool>(fields >> event.x >> event.y);
+			for (int i = 0; valid && i < EVENT_VALUE_COUNTS[type]; ++i)
+				valid = static_cast<bool>(fields >> event.values[i]);
+		}
+		if (!valid)
+		{
+			std::cerr << path << ": invalid input event '" << line << "'" << std::endl;
+			return false;
+		}
+		events->push_back(event);
+	}
+	std::stable_sort(events->begin(), events->end(),
+		[](const InputEvent& a, const InputEvent& b) { return a.time < b.time; });
+	return true;
+}
+
+void applyInputEvent(const InputEvent& event, ReplayedMouse* mouse)
+{
+	if (event.type == InputEventType::CURSOR)
+	{
+		mouse->x = event.x;
+		mouse->y = event.y;
+	}
+	else if (event.type == InputEventType::BUTTON &&
+		event.values[0] >= 0 && event.values[0] <= GLFW_MOUSE_BUTTON_LAST)
+	{
+		mouse->buttons[event.values[0]] = event.values[1] == GLFW_PRESS;
+	}
+}
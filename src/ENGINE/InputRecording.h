@@ -0,0 +1,69 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+
+// The GLFW input events handled by the Engine callbacks, recorded to a text
+// file with one event per line (the time in seconds since the start of the
+// recording, the event type and its arguments):
+//
+//   0.0 size 1920 1080
+//   0.51234 cursor 812.5 430.25
+//   0.60012 button 0 1 0
+//   1.20345 key 80 25 1 0
+//
+// The first event is always the framebuffer size of the window, which a
+// replay needs to reproduce the same frames.
+enum class InputEventType
+{
+	SIZE,    // width, height (values[0], values[1])
+	CURSOR,  // x, y
+	BUTTON,  // button, action, mods
+	KEY,     // key, scancode, action, mods
+	SCROLL,  // x offset, y offset
+	CHAR     // codepoint
+};
+
+struct InputEvent
+{
+	double time = 0.0;
+	InputEventType type = InputEventType::SIZE;
+	double x = 0.0;
+	double y = 0.0;
+	int values[4] = { 0, 0, 0, 0 };
+};
+
+// The mouse state implied by the events replayed so far, used instead of the
+// state polled from GLFW (by ImGui and by the sun direction), which still
+// follows the real mouse during a replay.
+struct ReplayedMouse
+{
+	double x = 0.0;
+	double y = 0.0;
+	// Indexed by GLFW_MOUSE_BUTTON_1 to GLFW_MOUSE_BUTTON_LAST.
+	bool buttons[8] = { false, false, false, false, false, false, false, false };
+};
+
+class InputRecorder
+{
+public:
+	// Opens 'path' for writing, and starts the recording clock at 'now' (in
+	// glfwGetTime() seconds).
+	InputRecorder(const std::string& path, double now);
+	InputRecorder(InputRecorder const&) = delete;
+
+	bool isOpen() const { return this->file.is_open(); }
+	// Writes 'event' with 'now' converted to the recording clock.
+	void record(InputEvent event, double now);
+
+private:
+	std::ofstream file;
+	double startTime;
+};
+
+// Reads the events of a file written by InputRecorder, in time order. Returns
+// false (after printing the invalid line, if any) on failure.
+bool readInputEvents(const std::string& path, std::vector<InputEvent>* events);
+
+// Updates 'mouse' with a replayed event.
+void applyInputEvent(const InputEvent& event, ReplayedMouse* mouse);
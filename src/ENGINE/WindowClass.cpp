@@ -1,4 +1,5 @@
 #include "WindowClass.h"
+#include "RENDER/shader_compile.h"
 
 void WindowClass::initializeWindow()
 {
@@ -15,6 +16,7 @@ void WindowClass::initializeWindow()
 	glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
 	glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
 	glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, this->visible ? GLFW_TRUE : GLFW_FALSE);
 	this->window = glfwCreateWindow(mode->width, mode->height, SCREEN_TITLE, NULL, NULL);
 	glfwSetWindowAspectRatio(window, 16, 9);
 	//this->window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_TITLE, NULL, NULL);
@@ -57,12 +59,15 @@ bool WindowClass::checkGlad()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return false;
 	}
+	// Lets the driver compile the shaders on its own threads, if it can.
+	EnableParallelShaderCompile((GLADloadproc)glfwGetProcAddress);
 	return true;
 }
 
 
-WindowClass::WindowClass()
+WindowClass::WindowClass(bool visible)
 {
+	this->visible = visible;
 	initializeWindow();
 }
 
@@ -12,12 +12,15 @@ class WindowClass
 {
 private:
 	GLFWwindow* window;
+	bool visible;
 private:
 	void initializeWindow();
 	bool checkWindow();
 	bool checkGlad();
 public:
-	WindowClass();
+	// A hidden window only provides the OpenGL context (e.g. to render image
+	// sequences offscreen).
+	explicit WindowClass(bool visible = true);
 	~WindowClass();
 	GLFWwindow* getGlfwWindow();
 };
\ No newline at end of file
@@ -1,9 +1,22 @@
 #include "ImguiClass.h"
+#include "CORE/frame_time_stats.h"
+#include "RENDER/gl_trace_scope.h"
+#include "RENDER/gpu_memory_tracker.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 ImguiClass::ImguiClass(GLFWwindow *window)
 {
 	this->window = window;
+	this->atlasMode = false;
+	this->frameTimings = nullptr;
+	this->precomputeTimings = nullptr;
+	this->systemTelemetry = nullptr;
+	this->frameTimeHistory = nullptr;
+	this->showFrameTimes = false;
+	this->replayedMouse = nullptr;
+	this->replayFrameSeconds = 0.0;
 	
 #if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
 	bool err = gl3wInit() != 0;
@@ -38,20 +51,175 @@ void ImguiClass::newFrame()
 {
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
+	if (this->replayedMouse != nullptr)
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		io.MousePos = ImVec2((float)this->replayedMouse->x, (float)this->replayedMouse->y);
+		for (int i = 0; i < IM_ARRAYSIZE(io.MouseDown); i++)
+			io.MouseDown[i] = this->replayedMouse->buttons[i];
+		io.DeltaTime = (float)this->replayFrameSeconds;
+	}
 	ImGui::NewFrame();
 }
 
-void ImguiClass::drawApplicationDataWindow(const std::string & GPU, const std::string & CPU, const std::string & memory, const std::string & usingMemory)
+void ImguiClass::useDefaultLayout()
+{
+	ImGui::GetIO().IniFilename = NULL;
+}
+
+void ImguiClass::drawApplicationDataWindow(const std::string & GPU, const std::string & CPU, const std::string & memory, const std::string & usingMemory,
+										   double inputLatencyMs)
 {
 	ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Once);
 	ImGui::Begin("Application Data", NULL, ImGuiWindowFlags_AlwaysAutoResize);
 	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+	ImGui::Text("Input latency %.1f ms", inputLatencyMs);
+	if (this->frameTimeHistory != nullptr)
+		ImGui::Checkbox("Show frame times", &this->showFrameTimes);
 	ImGui::Text("CPU: %s", CPU.c_str());
 	ImGui::Text("GPU: %s", GPU.c_str());
-	ImGui::Text("Using memory: %s / %s MB", usingMemory.c_str(), memory.c_str());
+	// The snapshot is the last one published by the sampler thread, so this
+	// never waits for a sample.
+	if (this->systemTelemetry != nullptr && this->systemTelemetry->snapshot().valid)
+		drawSystemTelemetry(this->systemTelemetry->snapshot());
+	else
+		ImGui::Text("Using memory: %s / %s MB", usingMemory.c_str(), memory.c_str());
+	drawGpuAllocations();
+	ImGui::End();
+}
+
+// The sizes counted by the GPU memory tracker, which are available with all the
+// drivers, unlike the GPU memory of the system telemetry.
+void ImguiClass::drawGpuAllocations()
+{
+	const double megabyte = 1024.0 * 1024.0;
+	const GpuMemoryUsage total = GetTotalGpuMemoryUsage();
+	if (!ImGui::TreeNode("GPU allocations", "GPU allocations: %.1f MB (peak %.1f MB)",
+		total.current_bytes / megabyte, total.peak_bytes / megabyte))
+		return;
+	for (int i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i)
+	{
+		const GpuMemoryCategory category = static_cast<GpuMemoryCategory>(i);
+		const GpuMemoryUsage usage = GetGpuMemoryUsage(category);
+		ImGui::Text("%s: %.1f MB (peak %.1f MB)", GpuMemoryCategoryName(category),
+			usage.current_bytes / megabyte, usage.peak_bytes / megabyte);
+	}
+	if (ImGui::Button("Reset peaks"))
+		ResetGpuMemoryPeaks();
+	ImGui::TreePop();
+}
+
+void ImguiClass::drawSystemTelemetry(const SystemSnapshot & snapshot)
+{
+	const double megabyte = 1024.0 * 1024.0;
+	ImGui::Text("Process memory: %.0f MB (peak %.0f MB)",
+		snapshot.process_rss_bytes / megabyte, snapshot.process_peak_rss_bytes / megabyte);
+	ImGui::Text("Using memory: %.0f / %.0f MB",
+		(snapshot.system_total_bytes - snapshot.system_available_bytes) / megabyte,
+		snapshot.system_total_bytes / megabyte);
+	if (snapshot.gpu_total_bytes > 0)
+		ImGui::Text("GPU memory: %.0f / %.0f MB",
+			(snapshot.gpu_total_bytes - snapshot.gpu_available_bytes) / megabyte,
+			snapshot.gpu_total_bytes / megabyte);
+	else if (snapshot.gpu_available_bytes > 0)
+		ImGui::Text("GPU free memory: %.0f MB", snapshot.gpu_available_bytes / megabyte);
+	ImGui::Text("CPU usage: process %.0f%%, system %.0f%%",
+		snapshot.process_cpu_percent, snapshot.system_cpu_percent);
+	if (ImGui::TreeNode("Threads"))
+	{
+		// The busiest ones only (the driver may have many idle threads).
+		const size_t maxThreads = 8;
+		for (size_t i = 0; i < snapshot.threads.size() && i < maxThreads; ++i)
+		{
+			const ThreadCpuUsage & thread = snapshot.threads[i];
+			ImGui::Text("%s (%d): %.0f%%", thread.name.c_str(), thread.id, thread.cpu_percent);
+		}
+		ImGui::TreePop();
+	}
+}
+
+void ImguiClass::drawFrameTimesWindow()
+{
+	if (!this->showFrameTimes || this->frameTimeHistory == nullptr || this->frameTimeHistory->size() == 0)
+		return;
+	const FrameTimeHistory & history = *this->frameTimeHistory;
+	const FrameTimeSummary summary = SummarizeFrameTimes(history.FrameTimes());
+	const ImVec2 plotSize(400, 80);
+	ImGui::Begin("Frame times", &this->showFrameTimes, ImGuiWindowFlags_AlwaysAutoResize);
+	ImGui::Text("Last %d frames: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms",
+		static_cast<int>(summary.count), summary.median, summary.p95, summary.p99, summary.max);
+
+	ImGui::PlotLines("Timeline", history.frame_ms().data(), static_cast<int>(history.size()),
+		static_cast<int>(history.offset()), NULL, 0.0f, static_cast<float>(summary.max), plotSize);
+
+	// The histogram range stops at twice the 99th percentile, so that a few
+	// very long frames (e.g. a precomputation) don't squash the others into
+	// the first bins: the last bin counts all the frames above it.
+	const int binCount = 40;
+	const double range = std::max(std::min(summary.max, 2.0 * summary.p99), 1e-3);
+	std::vector<float> bins(binCount, 0.0f);
+	for (double frameMs : history.FrameTimes())
+		bins[std::min(static_cast<int>(frameMs / range * binCount), binCount - 1)] += 1.0f;
+	char histogramLabel[64];
+	snprintf(histogramLabel, sizeof(histogramLabel), "0 - %.1f ms", range);
+	ImGui::PlotHistogram("Histogram", bins.data(), binCount, 0, histogramLabel, 0.0f, FLT_MAX, plotSize);
+
+	// The CPU stages of each frame, and the GPU passes of the last profiled one.
+	ImGui::Columns(4, "stages");
+	ImGui::Text("CPU stage");
+	ImGui::NextColumn();
+	ImGui::Text("p50");
+	ImGui::NextColumn();
+	ImGui::Text("p99");
+	ImGui::NextColumn();
+	ImGui::Text("max");
+	ImGui::NextColumn();
+	ImGui::Separator();
+	for (size_t stage = 0; stage < history.stage_names().size(); ++stage)
+	{
+		const FrameTimeSummary stageSummary = SummarizeFrameTimes(history.StageTimes(stage));
+		ImGui::Text("%s", history.stage_names()[stage].c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%.2f ms", stageSummary.median);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f ms", stageSummary.p99);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f ms", stageSummary.max);
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	if (this->frameTimings != nullptr && !this->frameTimings->empty())
+	{
+		ImGui::Separator();
+		ImGui::Text("GPU passes (last frame)");
+		drawGpuTimings(*this->frameTimings);
+	}
+	ImGui::End();
+}
+
+void ImguiClass::drawGpuTimingsWindow()
+{
+	if (this->frameTimings == nullptr)
+		return;
+	ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetIO().DisplaySize.y / 2), ImGuiCond_Once);
+	ImGui::Begin("GPU timings", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+	ImGui::Text("Frame");
+	drawGpuTimings(*this->frameTimings);
+	if (this->precomputeTimings != nullptr && !this->precomputeTimings->empty())
+	{
+		ImGui::Separator();
+		ImGui::Text("Last precomputation");
+		drawGpuTimings(*this->precomputeTimings);
+	}
 	ImGui::End();
 }
 
+void ImguiClass::drawGpuTimings(const std::vector<GpuTiming> & timings)
+{
+	for (const GpuTiming & timing : timings)
+		ImGui::Text("%*s%s: %.3f ms", 2 * (timing.depth + 1), "", timing.name.c_str(), timing.milliseconds);
+}
+
 void ImguiClass::drawParametersSettingsWindow(double & density, double & topHeight, double & rayleigh, double & mie)
 {
 	ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - ImGui::GetWindowWidth(), 0), ImGuiCond_Once);
@@ -71,7 +239,7 @@ void ImguiClass::setDensity(double & density)
 	float sliderDensity = sliderDensityInitialValue;
 	ImGui::SliderFloat("Density", &sliderDensity, 0.5f, 2.5f);
 	//if (sliderDensity != sliderDensityInitialValue) {
-	if ((abs(sliderDensity - sliderDensityInitialValue) > 0.4)) {
+	if (std::fabs(sliderDensity - sliderDensityInitialValue) > (this->atlasMode ? 0.0 : 0.4)) {
 		density = sliderDensity;
 	}
 }
@@ -107,18 +275,24 @@ void ImguiClass::setMieConstant(double & mie)
 	float sliderkMie = sliderkMieInitialValue;
 	ImGui::SliderFloat("Mie constant", &sliderkMie, 1.328e-3, 9.328e-3);
 	//if (sliderkMie != sliderkMieInitialValue)
-	if (abs(sliderkMie - sliderkMieInitialValue) > 0.0015) {
+	if (std::fabs(sliderkMie - sliderkMieInitialValue) > (this->atlasMode ? 0.0 : 0.0015)) {
 		mie = sliderkMie;
 	}
 }
 
 void ImguiClass::renderDrawData(const std::string & GPU, const std::string & CPU, const std::string & memory, const std::string & usingMemory,
-								double & density, double & topHeight, double & rayleigh, double & mie)
+								double inputLatencyMs, double & density, double & topHeight, double & rayleigh, double & mie)
 {
-	newFrame();
-	drawParametersSettingsWindow(density, topHeight, rayleigh, mie);
-	drawApplicationDataWindow(GPU, CPU, memory, usingMemory);
-	ImGui::Render();
+	{
+		TRACE_SCOPE("ImguiClass::buildWindows");
+		newFrame();
+		drawParametersSettingsWindow(density, topHeight, rayleigh, mie);
+		drawApplicationDataWindow(GPU, CPU, memory, usingMemory, inputLatencyMs);
+		drawGpuTimingsWindow();
+		drawFrameTimesWindow();
+		ImGui::Render();
+	}
+	TRACE_GL_SCOPE("ImguiClass::renderDrawData");
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 	ImGui::EndFrame();
 }
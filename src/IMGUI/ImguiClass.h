@@ -1,23 +1,67 @@
 #pragma once
 
 #include "IMGUI/ImguiHeader.h"
+#include "CORE/frame_time_history.h"
+#include "CORE/system_telemetry.h"
+#include "ENGINE/InputRecording.h"
+#include "RENDER/gpu_profiler.h"
 #include <cstdio>
 #include <string>
+#include <vector>
 
 class ImguiClass
 {
 private:
 	GLFWwindow * window;
+	// Apply every density and Mie change, which the parameter atlas can blend
+	// immediately, instead of only large ones.
+	bool atlasMode;
+	// Shown in the GPU timings window, if not null.
+	const std::vector<GpuTiming> * frameTimings;
+	const std::vector<GpuTiming> * precomputeTimings;
+	// Shown in the application data window, if not null and once sampled.
+	SystemTelemetry * systemTelemetry;
+	// Shown in the frame times window, if not null. The window is hidden by
+	// default, and its statistics are only computed while it is shown.
+	const FrameTimeHistory * frameTimeHistory;
+	bool showFrameTimes;
+	// The mouse state and frame duration of an input replay, used instead of
+	// the GLFW mouse and clock if not null.
+	const ReplayedMouse * replayedMouse;
+	double replayFrameSeconds;
 public:
 	ImguiClass() = delete;
 	explicit ImguiClass(GLFWwindow * window);
 	~ImguiClass();
 	void newFrame();
+	void setAtlasMode(bool atlasMode) { this->atlasMode = atlasMode; }
+	void setReplayedInput(const ReplayedMouse * mouse, double frameSeconds)
+	{
+		this->replayedMouse = mouse;
+		this->replayFrameSeconds = frameSeconds;
+	}
+	// Ignores the saved window layout (imgui.ini), so that the input recorded
+	// in one session replays on the same layout in another. Must be called
+	// before the first frame.
+	void useDefaultLayout();
+	void setFrameTimeHistory(const FrameTimeHistory * frameTimeHistory) { this->frameTimeHistory = frameTimeHistory; }
+	void setSystemTelemetry(SystemTelemetry * systemTelemetry) { this->systemTelemetry = systemTelemetry; }
+	void setGpuTimings(const std::vector<GpuTiming> * frameTimings, const std::vector<GpuTiming> * precomputeTimings)
+	{
+		this->frameTimings = frameTimings;
+		this->precomputeTimings = precomputeTimings;
+	}
 	void renderDrawData(const std::string & GPU, const std::string & CPU, const std::string & memory, const std::string & usingMemory, 
-						double & density, double & topHeight, double & rayleigh, double & mie);
+						double inputLatencyMs, double & density, double & topHeight, double & rayleigh, double & mie);
 
 private:
-	void inline drawApplicationDataWindow(const std::string & GPU, const std::string & CPU, const std::string & memory, const std::string & usingMemory);
+	void inline drawApplicationDataWindow(const std::string & GPU, const std::string & CPU, const std::string & memory, const std::string & usingMemory,
+										  double inputLatencyMs);
+	void inline drawSystemTelemetry(const SystemSnapshot & snapshot);
+	void inline drawGpuAllocations();
+	void inline drawFrameTimesWindow();
+	void inline drawGpuTimingsWindow();
+	void inline drawGpuTimings(const std::vector<GpuTiming> & timings);
 	void inline drawParametersSettingsWindow(double & density, double & topHeight, double & rayleigh, double & mie);
 	void inline setDensity(double & density);
 	void inline setTopHeight(double & topHeight);
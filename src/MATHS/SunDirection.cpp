@@ -3,30 +3,58 @@
 SunDirection::SunDirection(GLFWwindow * window, double sunZenithAngleRadians, double sunAzimuthAngleRadians)
 {
 	this->window = window;
-	this->sunZenithAngleRadians = sunZenithAngleRadians;
-	this->sunAzimuthAngleRadians = sunAzimuthAngleRadians;
+	setAngles(sunZenithAngleRadians, sunAzimuthAngleRadians);
 }
 
 
-void SunDirection::handleMouseClickEvent(int button, int action, int mods) {
-	double x;
-	double y;
+void SunDirection::handleMouseClickEvent(int button, int action, int mods, double mouseX, double mouseY) {
+	previousMouseX = mouseX;
+	previousMouseY = mouseY;
+}
 
-	glfwGetCursorPos(window, &x, &y);
+void SunDirection::handleMouseDragEvent(double mouseX, double mouseY) {
+	pendingDeltaX += previousMouseX - mouseX;
+	pendingDeltaY += previousMouseY - mouseY;
+	pendingInput = true;
 
-	previousMouseX = x;
-	previousMouseY = y;
+	previousMouseX = mouseX;
+	previousMouseY = mouseY;
+	
 }
 
-void SunDirection::handleMouseDragEvent(double mouseX, double mouseY) {
+bool SunDirection::update() {
 	constexpr double kScale = 500.0;
-	
-	sunZenithAngleRadians -= (previousMouseY - mouseY) / kScale;
+
+	previousZenithAngleRadians = sunZenithAngleRadians;
+	previousAzimuthAngleRadians = sunAzimuthAngleRadians;
+	if (!pendingInput)
+		return false;
+
+	sunZenithAngleRadians -= pendingDeltaY / kScale;
 	sunZenithAngleRadians =
 		std::max(0.0, std::min(kPi, sunZenithAngleRadians));
-	sunAzimuthAngleRadians += (previousMouseX - mouseX) / kScale;
+	sunAzimuthAngleRadians += pendingDeltaX / kScale;
 
-	previousMouseX = mouseX;
-	previousMouseY = mouseY;
-	
-}
\ No newline at end of file
+	pendingDeltaX = 0.0;
+	pendingDeltaY = 0.0;
+	pendingInput = false;
+	return true;
+}
+
+void SunDirection::setAngles(double sunZenithAngleRadians, double sunAzimuthAngleRadians) {
+	this->sunZenithAngleRadians = sunZenithAngleRadians;
+	this->sunAzimuthAngleRadians = sunAzimuthAngleRadians;
+	previousZenithAngleRadians = sunZenithAngleRadians;
+	previousAzimuthAngleRadians = sunAzimuthAngleRadians;
+	dirty = true;
+}
+
+double SunDirection::interpolatedZenithAngle(double alpha) const {
+	return previousZenithAngleRadians +
+		(sunZenithAngleRadians - previousZenithAngleRadians) * alpha;
+}
+
+double SunDirection::interpolatedAzimuthAngle(double alpha) const {
+	return previousAzimuthAngleRadians +
+		(sunAzimuthAngleRadians - previousAzimuthAngleRadians) * alpha;
+}
@@ -7,6 +7,16 @@ class SunDirection
 private:
 	GLFWwindow * window;
 	double kPi = 3.1415926;
+	bool dirty = true;
+
+	// Mouse motion received since the last simulation tick.
+	double pendingDeltaX = 0.0;
+	double pendingDeltaY = 0.0;
+	bool pendingInput = false;
+
+	// Angles at the previous tick, used to interpolate between ticks.
+	double previousZenithAngleRadians;
+	double previousAzimuthAngleRadians;
 public:
 	double sunZenithAngleRadians;
 	double sunAzimuthAngleRadians;
@@ -17,7 +27,28 @@ public:
 	SunDirection(GLFWwindow * window, double sunZenithAngleRadians, double sunAzimuthAngleRadians);
 	~SunDirection() = default;
 
-	void handleMouseClickEvent(int button, int action, int mods);
+	// The cursor position is passed in rather than polled, so that replayed
+	// clicks don't depend on the real cursor.
+	void handleMouseClickEvent(int button, int action, int mods, double mouseX, double mouseY);
 	void handleMouseDragEvent(double mouseX, double mouseY);
+
+	// Advances the sun by one fixed simulation tick, applying the mouse motion
+	// queued since the previous one. Returns true if queued input was consumed.
+	bool update();
+	void setAngles(double sunZenithAngleRadians, double sunAzimuthAngleRadians);
+
+	// Sun angles blended between the previous and the current tick, with
+	// 'alpha' in [0,1] the fraction of a tick elapsed since the current one.
+	double interpolatedZenithAngle(double alpha) const;
+	double interpolatedAzimuthAngle(double alpha) const;
+
+	bool hasPendingInput() const { return pendingInput; }
+	bool isDirty() const
+	{
+		return dirty || pendingInput ||
+			previousZenithAngleRadians != sunZenithAngleRadians ||
+			previousAzimuthAngleRadians != sunAzimuthAngleRadians;
+	}
+	void clearDirty() { dirty = false; }
 };
 
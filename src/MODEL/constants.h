@@ -1,8 +1,7 @@
 
 /*<h2>atmosphere/constants.h</h2>
 
-<p>This file defines the size of the precomputed texures used in our atmosphere
-model. It also provides tabulated values of the <a href=
+<p>This file provides tabulated values of the <a href=
 "https://en.wikipedia.org/wiki/CIE_1931_color_space#Color_matching_functions"
 >CIE color matching functions</a> and the conversion matrix from the <a href=
 "https://en.wikipedia.org/wiki/CIE_1931_color_space">XYZ</a> to the
@@ -15,22 +14,6 @@ sRGB luminance values).
 #define ATMOSPHERE_CONSTANTS_H_
 
 
-constexpr int TRANSMITTANCE_TEXTURE_WIDTH = 256;
-constexpr int TRANSMITTANCE_TEXTURE_HEIGHT = 64;
-
-constexpr int SCATTERING_TEXTURE_R_SIZE = 32;
-constexpr int SCATTERING_TEXTURE_MU_SIZE = 128;
-constexpr int SCATTERING_TEXTURE_MU_S_SIZE = 32;
-constexpr int SCATTERING_TEXTURE_NU_SIZE = 8;
-
-constexpr int SCATTERING_TEXTURE_WIDTH =
-    SCATTERING_TEXTURE_NU_SIZE * SCATTERING_TEXTURE_MU_S_SIZE;
-constexpr int SCATTERING_TEXTURE_HEIGHT = SCATTERING_TEXTURE_MU_SIZE;
-constexpr int SCATTERING_TEXTURE_DEPTH = SCATTERING_TEXTURE_R_SIZE;
-
-constexpr int IRRADIANCE_TEXTURE_WIDTH = 64;
-constexpr int IRRADIANCE_TEXTURE_HEIGHT = 16;
-
 // The conversion factor between watts and lumens.
 constexpr double MAX_LUMINOUS_EFFICACY = 683.0;
 
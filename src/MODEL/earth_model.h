@@ -0,0 +1,50 @@
+#ifndef ATMOSPHERE_EARTH_MODEL_H_
+#define ATMOSPHERE_EARTH_MODEL_H_
+
+#include <string>
+#include <vector>
+
+#include "model1.h"
+
+// The Earth atmosphere of the application, shared by the interactive app and
+// the offline tools, so that they compute the same LUTs (with the same
+// parameter hashes) for the same parameters.
+
+constexpr double kEarthSunAngularRadius = 0.00935 / 2.0;
+constexpr double kEarthBottomRadius = 6360000.0;
+constexpr double kEarthLengthUnitInMeters = 1000.0;
+
+struct EarthModelOptions {
+  // Scale factor of the Rayleigh and Mie densities.
+  double density = 1.0;
+  // Radius of the top of the atmosphere, in meters.
+  double top_radius = 6420000.0;
+  // Rayleigh scattering coefficient at 1 micro-meter, in m^-1.
+  double rayleigh = 1.24062e-6;
+  // Mie Angstrom beta coefficient.
+  double mie = 5.328e-3;
+  bool constant_solar_spectrum = false;
+  bool ozone = true;
+  bool combined_textures = true;
+  bool half_precision = true;
+  // 3 for radiance LUTs, 15 for precomputed luminance LUTs (see Model1).
+  unsigned int num_precomputed_wavelengths = 3;
+  // The texture sizes, e.g. LutResolutionForQuality(LUT_QUALITY_LOW).
+  LutResolution resolution;
+  // The integration sample counts (see SampleCounts).
+  SampleCounts sample_counts;
+};
+
+// Returns a new model for the given options, to be initialized by the caller.
+// Also returns the wavelengths and solar irradiance spectrum used, if
+// requested (e.g. for white balance). The model borrows its textures from
+// 'texture_pool', if not null (see Model1).
+Model1* NewEarthModel(const EarthModelOptions& options,
+                      std::vector<double>* wavelengths = nullptr,
+                      std::vector<double>* solar_irradiance = nullptr,
+                      TexturePool* texture_pool = nullptr);
+
+// The path of the LUT file of 'model' in a LUT cache directory.
+std::string LutCachePath(const std::string& directory, const Model1& model);
+
+#endif  // ATMOSPHERE_EARTH_MODEL_H_
@@ -0,0 +1,205 @@
+#include "lut_archive.h"
+
+#include <zlib.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+#include "CORE/job_pool.h"
+
+namespace {
+
+constexpr int kCompressionLevel = 6;
+
+template <typename Word>
+void FilterSlice(const unsigned char* texels, size_t value_count,
+                 int components, unsigned char* filtered) {
+  const size_t element_count = value_count / components;
+  const Word* values = reinterpret_cast<const Word*>(texels);
+  for (int c = 0; c < components; ++c) {
+    Word previous = 0;
+    for (size_t e = 0; e < element_count; ++e) {
+      const Word value = values[e * components + c];
+      const Word delta = static_cast<Word>(value - previous);
+      previous = value;
+      for (size_t b = 0; b < sizeof(Word); ++b) {
+        filtered[(b * components + c) * element_count + e] =
+            static_cast<unsigned char>(delta >> (8 * b));
+      }
+    }
+  }
+}
+
+template <typename Word>
+void UnfilterSlice(const unsigned char* filtered, size_t value_count,
+                   int components, unsigned char* texels) {
+  const size_t element_count = value_count / components;
+  Word* values = reinterpret_cast<Word*>(texels);
+  for (int c = 0; c < components; ++c) {
+    Word previous = 0;
+    for (size_t e = 0; e < element_count; ++e) {
+      Word delta = 0;
+      for (size_t b = 0; b < sizeof(Word); ++b) {
+        delta |= static_cast<Word>(
+            filtered[(b * components + c) * element_count + e]) << (8 * b);
+      }
+      previous = static_cast<Word>(previous + delta);
+      values[e * components + c] = previous;
+    }
+  }
+}
+
+}  // anonymous namespace
+
+bool LutArchive::Open(const std::string& path) {
+  if (!file_.Open(path) || file_.size() < sizeof(LutFileHeader)) {
+    Close();
+    return false;
+  }
+  const LutFileHeader& archive_header = header();
+  if (std::memcmp(archive_header.magic, LUT_ARCHIVE_MAGIC,
+                  sizeof(LUT_ARCHIVE_MAGIC)) != 0 ||
+      archive_header.version != LUT_FILE_VERSION) {
+    Close();
+    return false;
+  }
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutEntry& entry = archive_header.luts[i];
+    if (entry.size == 0) {
+      continue;
+    }
+    // The bounds are checked without computing offset + size, which could
+    // overflow with a corrupt header or slice table.
+    const uint64_t table_size =
+        static_cast<uint64_t>(entry.depth) * sizeof(LutSlice);
+    if (entry.depth == 0 || entry.offset < sizeof(LutFileHeader) ||
+        entry.offset > file_.size() ||
+        table_size > file_.size() - entry.offset) {
+      Close();
+      return false;
+    }
+    const LutSlice* slice_table = slices(static_cast<LutId>(i));
+    for (uint32_t z = 0; z < entry.depth; ++z) {
+      if (slice_table[z].offset > file_.size() ||
+          slice_table[z].size > file_.size() - slice_table[z].offset) {
+        Close();
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+size_t LutArchive::SliceSize(LutId id) const {
+  const LutEntry& entry = header().luts[id];
+  return static_cast<size_t>(entry.width) * entry.height * entry.components *
+      entry.bytes_per_component;
+}
+
+bool LutArchive::DecodeSlice(LutId id, int z, void* texels) const {
+  const LutEntry& entry = header().luts[id];
+  const LutSlice& slice = slices(id)[z];
+  const size_t slice_size = SliceSize(id);
+  std::vector<unsigned char> filtered(slice_size);
+  uLongf filtered_size = static_cast<uLongf>(slice_size);
+  if (uncompress(filtered.data(), &filtered_size, file_.data() + slice.offset,
+                 static_cast<uLong>(slice.size)) != Z_OK ||
+      filtered_size != slice_size) {
+    return false;
+  }
+  const size_t value_count = slice_size / entry.bytes_per_component;
+  unsigned char* output = static_cast<unsigned char*>(texels);
+  if (entry.bytes_per_component == 2) {
+    UnfilterSlice<uint16_t>(filtered.data(), value_count, entry.components,
+                            output);
+  } else {
+    UnfilterSlice<uint32_t>(filtered.data(), value_count, entry.components,
+                            output);
+  }
+  return true;
+}
+
+bool LutArchive::Write(const LutFile& luts, const std::string& path,
+                       JobPool* job_pool) {
+  LutFileHeader archive_header = luts.header();
+  std::memcpy(archive_header.magic, LUT_ARCHIVE_MAGIC,
+              sizeof(archive_header.magic));
+
+  // Compress all the slices in parallel.
+  struct SliceJob {
+    LutId id;
+    int z;
+    std::vector<unsigned char> data;
+  };
+  std::vector<SliceJob> jobs;
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutEntry& entry = archive_header.luts[i];
+    for (uint32_t z = 0; entry.size != 0 && z < entry.depth; ++z) {
+      jobs.push_back(SliceJob{static_cast<LutId>(i), static_cast<int>(z), {}});
+    }
+  }
+  std::atomic<bool> success(true);
+  job_pool->ParallelFor(static_cast<int>(jobs.size()), [&](int j) {
+    SliceJob& job = jobs[j];
+    const LutView lut = luts.lut(job.id);
+    const LutEntry& entry = lut.entry();
+    const size_t slice_size = static_cast<size_t>(entry.width) *
+        entry.height * entry.components * entry.bytes_per_component;
+    const unsigned char* texels =
+        static_cast<const unsigned char*>(lut.data()) + job.z * slice_size;
+    std::vector<unsigned char> filtered(slice_size);
+    const size_t value_count = slice_size / entry.bytes_per_component;
+    if (entry.bytes_per_component == 2) {
+      FilterSlice<uint16_t>(texels, value_count, entry.components,
+                            filtered.data());
+    } else {
+      FilterSlice<uint32_t>(texels, value_count, entry.components,
+                            filtered.data());
+    }
+    uLongf compressed_size = compressBound(static_cast<uLong>(slice_size));
+    job.data.resize(compressed_size);
+    if (compress2(job.data.data(), &compressed_size, filtered.data(),
+                  static_cast<uLong>(slice_size), kCompressionLevel) != Z_OK) {
+      success = false;
+    }
+    job.data.resize(compressed_size);
+  });
+  if (!success) {
+    return false;
+  }
+
+  // Lay out the slice tables after the header, then the compressed slices.
+  std::vector<std::vector<LutSlice>> slice_tables(LUT_COUNT);
+  uint64_t offset = sizeof(archive_header);
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    LutEntry& entry = archive_header.luts[i];
+    if (entry.size == 0) {
+      continue;
+    }
+    entry.offset = offset;
+    offset += entry.depth * sizeof(LutSlice);
+    slice_tables[i].resize(entry.depth);
+  }
+  for (const SliceJob& job : jobs) {
+    slice_tables[job.id][job.z].offset = offset;
+    slice_tables[job.id][job.z].size = job.data.size();
+    offset += job.data.size();
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&archive_header),
+             sizeof(archive_header));
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    file.write(reinterpret_cast<const char*>(slice_tables[i].data()),
+               slice_tables[i].size() * sizeof(LutSlice));
+  }
+  for (const SliceJob& job : jobs) {
+    file.write(reinterpret_cast<const char*>(job.data.data()),
+               job.data.size());
+  }
+  return static_cast<bool>(file);
+}
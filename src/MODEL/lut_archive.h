@@ -0,0 +1,73 @@
+#ifndef ATMOSPHERE_LUT_ARCHIVE_H_
+#define ATMOSPHERE_LUT_ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lut_file.h"
+
+class JobPool;
+
+// A compressed variant of the LUT file (see lut_file.h), for libraries of
+// many precomputed atmospheres. It has the same header (with a different
+// magic), but each z slice of each texture is compressed independently, so
+// that the slices can be decoded in parallel, and uploaded one by one as soon
+// as they are decoded.
+//
+// Before compression with zlib, the values of each slice are filtered to
+// expose their redundancy: each component is delta encoded along the rows
+// (the bit patterns of positive floats are ordered like their values, so
+// smooth data gives small deltas), and the bytes of the deltas are then
+// shuffled into byte planes (all the low bytes, then all the next bytes, etc),
+// which separates the noisy low mantissa bits from the compressible high
+// bits.
+//
+// In the header, the 'offset' of each LutEntry is the file offset of its
+// slice table (one LutSlice per z slice), and its 'size' is the uncompressed
+// size.
+
+constexpr char LUT_ARCHIVE_MAGIC[8] = "ATMOLUZ";
+
+struct LutSlice {
+  uint64_t offset;
+  uint64_t size;
+};
+
+class LutArchive {
+ public:
+  LutArchive() {}
+  LutArchive(LutArchive const&) = delete;
+  LutArchive(LutArchive&&) = delete;
+
+  // Maps the given file and validates its header and slice tables. Returns
+  // false on failure.
+  bool Open(const std::string& path);
+  void Close() { file_.Close(); }
+  bool is_open() const { return file_.is_open(); }
+
+  const LutFileHeader& header() const {
+    return *reinterpret_cast<const LutFileHeader*>(file_.data());
+  }
+  // The size in bytes of one uncompressed slice of the given texture.
+  size_t SliceSize(LutId id) const;
+  // Decodes the given slice into 'texels' (of size SliceSize(id)). This can be
+  // called concurrently from several threads. Returns false if the data is
+  // corrupted.
+  bool DecodeSlice(LutId id, int z, void* texels) const;
+
+  // Compresses the given LUT file into an archive, with one job per slice.
+  // Returns false on failure.
+  static bool Write(const LutFile& luts, const std::string& path,
+                    JobPool* job_pool);
+
+ private:
+  const LutSlice* slices(LutId id) const {
+    return reinterpret_cast<const LutSlice*>(
+        file_.data() + header().luts[id].offset);
+  }
+
+  MappedFile file_;
+};
+
+#endif  // ATMOSPHERE_LUT_ARCHIVE_H_
@@ -0,0 +1,235 @@
+#include "lut_file.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// The largest page size of the supported platforms (the allocation
+// granularity on Windows is 64KB, but pages are 4KB).
+constexpr uint64_t kPageSize = 4096;
+
+// Converts an unsigned float with a 5 bits exponent (biased by 15) and a
+// 'mantissa_bits' mantissa, as in GL_R11F_G11F_B10F, to a float.
+float SmallFloatToFloat(uint32_t value, int mantissa_bits) {
+  const uint32_t exponent = value >> mantissa_bits;
+  const uint32_t mantissa = value & ((1u << mantissa_bits) - 1);
+  if (exponent == 0) {
+    return std::ldexp(static_cast<float>(mantissa), -14 - mantissa_bits);
+  }
+  if (exponent == 31) {
+    return mantissa == 0 ? HUGE_VALF : NAN;
+  }
+  return std::ldexp(static_cast<float>(mantissa + (1u << mantissa_bits)),
+                    static_cast<int>(exponent) - 15 - mantissa_bits);
+}
+
+}  // anonymous namespace
+
+uint64_t AlignLutOffset(uint64_t offset) {
+  return (offset + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+float HalfToFloat(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Denormal half: normalize it.
+    exponent = 113;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+  }
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void Rgb9E5ToFloat(uint32_t texel, float rgb[3]) {
+  // The components are 9 bits mantissas, without implicit leading 1, of a
+  // shared exponent biased by 15.
+  const float scale = std::ldexp(1.0f, static_cast<int>(texel >> 27) - 24);
+  for (int i = 0; i < 3; ++i) {
+    rgb[i] = ((texel >> (9 * i)) & 0x1FF) * scale;
+  }
+}
+
+void R11fG11fB10fToFloat(uint32_t texel, float rgb[3]) {
+  rgb[0] = SmallFloatToFloat(texel & 0x7FF, 6);
+  rgb[1] = SmallFloatToFloat((texel >> 11) & 0x7FF, 6);
+  rgb[2] = SmallFloatToFloat(texel >> 22, 5);
+}
+
+float LutView::Fetch(int x, int y, int z, int component) const {
+  const size_t texel =
+      (static_cast<size_t>(z) * entry_.height + y) * entry_.width + x;
+  if (entry_.format == LUT_FORMAT_RGB9_E5 ||
+      entry_.format == LUT_FORMAT_R11F_G11F_B10F) {
+    float rgb[3];
+    const uint32_t word = static_cast<const uint32_t*>(data_)[texel];
+    if (entry_.format == LUT_FORMAT_RGB9_E5) {
+      Rgb9E5ToFloat(word, rgb);
+    } else {
+      R11fG11fB10fToFloat(word, rgb);
+    }
+    return component < 3 ? rgb[component] : 1.0f;
+  }
+  const size_t index = texel * entry_.components + component;
+  if (entry_.format == LUT_FORMAT_UNORM16) {
+    return static_cast<const uint16_t*>(data_)[index] / 65535.0f;
+  }
+  if (entry_.bytes_per_component == 2) {
+    return HalfToFloat(static_cast<const uint16_t*>(data_)[index]);
+  }
+  return static_cast<const float*>(data_)[index];
+}
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0),
+#ifdef _WIN32
+      file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(nullptr) {
+#else
+      file_descriptor_(-1) {
+#endif
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+  Close();
+#ifdef _WIN32
+  file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+    Close();
+    return false;
+  }
+  mapping_handle_ =
+      CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_handle_ == nullptr) {
+    Close();
+    return false;
+  }
+  data_ = static_cast<const unsigned char*>(
+      MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+  file_descriptor_ = open(path.c_str(), O_RDONLY);
+  if (file_descriptor_ < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(file_descriptor_, &file_stat) != 0 || file_stat.st_size == 0) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+  void* data =
+      mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_descriptor_, 0);
+  if (data != MAP_FAILED) {
+    // The textures are uploaded (or scanned) front to back.
+    madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const unsigned char*>(data);
+  }
+#endif
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+    mapping_handle_ = nullptr;
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+#else
+  if (data_ != nullptr) {
+    munmap(const_cast<unsigned char*>(data_), size_);
+  }
+  if (file_descriptor_ >= 0) {
+    close(file_descriptor_);
+    file_descriptor_ = -1;
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool LutFile::Open(const std::string& path) {
+  if (!file_.Open(path) || file_.size() < sizeof(LutFileHeader)) {
+    Close();
+    return false;
+  }
+  const LutFileHeader& file_header = header();
+  if (std::memcmp(file_header.magic, LUT_FILE_MAGIC, sizeof(LUT_FILE_MAGIC))
+          != 0 ||
+      file_header.version != LUT_FILE_VERSION) {
+    Close();
+    return false;
+  }
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutEntry& entry = file_header.luts[i];
+    const uint64_t expected_size = static_cast<uint64_t>(entry.width) *
+        entry.height * entry.depth * entry.components *
+        entry.bytes_per_component;
+    // The bounds are checked without computing offset + size, which could
+    // overflow with a corrupt header.
+    if (entry.size != 0 && (entry.size != expected_size ||
+        entry.offset < sizeof(LutFileHeader) ||
+        entry.offset > file_.size() ||
+        entry.size > file_.size() - entry.offset)) {
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+LutView LutFile::lut(LutId id) const {
+  const LutEntry& entry = header().luts[id];
+  if (entry.size == 0) {
+    return LutView(nullptr, entry);
+  }
+  return LutView(file_.data() + entry.offset, entry);
+}
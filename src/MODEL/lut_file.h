@@ -0,0 +1,152 @@
+#ifndef ATMOSPHERE_LUT_FILE_H_
+#define ATMOSPHERE_LUT_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A binary container for the precomputed textures of a Model1, designed to be
+// memory mapped: a fixed size header, followed by the raw texels of each
+// texture, in the GL layout (rows of x, then y, then z slices), each starting
+// on a page boundary. The texels can then be uploaded to the GPU, or read on
+// the CPU, directly from the mapping.
+//
+// Files are written with Model1::SaveLuts, and loaded with
+// Model1::InitFromLuts, which checks the header against the model (the texture
+// sizes, precision, texture layout and parameter hash). The textures are
+// stored in their precomputed format, or in the smaller format chosen by
+// Model1::QuantizeLuts.
+
+enum LutId {
+  LUT_TRANSMITTANCE,
+  LUT_SCATTERING,
+  LUT_SINGLE_MIE_SCATTERING,
+  LUT_IRRADIANCE,
+  LUT_COUNT
+};
+
+// The storage format of the texels of a LUT (see lut_quantization.h).
+enum LutFormat : uint32_t {
+  // 'components' half floats or floats (2 or 4 bytes per component).
+  LUT_FORMAT_FLOAT,
+  // 'components' 16 bits normalized unsigned integers.
+  LUT_FORMAT_UNORM16,
+  // One 32 bits word per texel (i.e. 1 component of 4 bytes), with the RGB
+  // components of the GL_RGB9_E5 and GL_R11F_G11F_B10F formats (packed as
+  // GL_UNSIGNED_INT_5_9_9_9_REV and GL_UNSIGNED_INT_10F_11F_11F_REV).
+  LUT_FORMAT_RGB9_E5,
+  LUT_FORMAT_R11F_G11F_B10F
+};
+
+// The description of one texture in a LUT file. 'size' is 0 for absent
+// textures (e.g. the single Mie scattering with combined textures).
+struct LutEntry {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t components;
+  uint32_t bytes_per_component;
+  // A LutFormat.
+  uint32_t format;
+  uint64_t offset;
+  uint64_t size;
+};
+
+constexpr char LUT_FILE_MAGIC[8] = "ATMOLUT";
+constexpr uint32_t LUT_FILE_VERSION = 2;
+
+// The values of the LutFileHeader flags.
+constexpr uint32_t LUT_HALF_PRECISION = 1;
+constexpr uint32_t LUT_COMBINED_SCATTERING_TEXTURES = 2;
+constexpr uint32_t LUT_PRECOMPUTED_ILLUMINANCE = 4;
+
+struct LutFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t parameter_hash;
+  LutEntry luts[LUT_COUNT];
+};
+
+// Returns the file offset of the texels following 'offset', i.e. 'offset'
+// rounded up to the next page boundary.
+uint64_t AlignLutOffset(uint64_t offset);
+
+// Converts an IEEE 754 half precision float to a float.
+float HalfToFloat(uint16_t half);
+// Converts the RGB components of a GL_UNSIGNED_INT_5_9_9_9_REV or of a
+// GL_UNSIGNED_INT_10F_11F_11F_REV word to floats.
+void Rgb9E5ToFloat(uint32_t texel, float rgb[3]);
+void R11fG11fB10fToFloat(uint32_t texel, float rgb[3]);
+
+// A read-only view of the texels of one texture.
+class LutView {
+ public:
+  LutView() : data_(nullptr), entry_() {}
+  LutView(const void* data, const LutEntry& entry)
+      : data_(data), entry_(entry) {}
+
+  const void* data() const { return data_; }
+  const LutEntry& entry() const { return entry_; }
+  bool empty() const { return data_ == nullptr || entry_.size == 0; }
+
+  // The value of the given component of the given texel.
+  float Fetch(int x, int y, int z, int component) const;
+
+ private:
+  const void* data_;
+  LutEntry entry_;
+};
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile();
+  MappedFile(MappedFile const&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  ~MappedFile();
+
+  // Returns false if the file can't be mapped (or is empty).
+  bool Open(const std::string& path);
+  void Close();
+  bool is_open() const { return data_ != nullptr; }
+
+  const unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const unsigned char* data_;
+  size_t size_;
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#else
+  int file_descriptor_;
+#endif
+};
+
+// A memory mapped LUT file. The mapping stays valid for the lifetime of this
+// object, and is shared by the GPU uploads and the CPU queries.
+class LutFile {
+ public:
+  LutFile() {}
+  LutFile(LutFile const&) = delete;
+  LutFile(LutFile&&) = delete;
+
+  // Maps the given file and validates its header (magic, version, and that
+  // the texels are inside the file). Returns false on failure.
+  bool Open(const std::string& path);
+  void Close() { file_.Close(); }
+  bool is_open() const { return file_.is_open(); }
+
+  const LutFileHeader& header() const {
+    return *reinterpret_cast<const LutFileHeader*>(file_.data());
+  }
+  LutView lut(LutId id) const;
+  size_t size() const { return file_.size(); }
+
+ private:
+  MappedFile file_;
+};
+
+#endif  // ATMOSPHERE_LUT_FILE_H_
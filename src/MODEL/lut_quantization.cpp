@@ -0,0 +1,295 @@
+#include "lut_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include "CORE/job_pool.h"
+
+namespace {
+
+// Converts a float to an unsigned float with a 5 bits exponent (biased by 15)
+// and a 'mantissa_bits' mantissa, rounded to nearest. Negative values and NaN
+// give 0, and large values the largest finite value.
+uint32_t FloatToSmallFloat(float value, int mantissa_bits) {
+  const uint32_t max_finite =
+      (30u << mantissa_bits) | ((1u << mantissa_bits) - 1);
+  if (!(value > 0.0f)) {
+    return 0;
+  }
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+  if (exponent >= 31) {
+    return max_finite;
+  }
+  if (exponent <= 0) {
+    // Denormal result (which rounds up to the smallest normal value if needed,
+    // i.e. to 1 << mantissa_bits).
+    return static_cast<uint32_t>(
+        std::ldexp(static_cast<double>(value), 14 + mantissa_bits) + 0.5);
+  }
+  // A mantissa rounded up to 1 << mantissa_bits carries into the exponent.
+  const int shift = 23 - mantissa_bits;
+  const uint32_t result = (static_cast<uint32_t>(exponent) << mantissa_bits) +
+      (((bits & 0x7FFFFF) + (1u << (shift - 1))) >> shift);
+  return std::min(result, max_finite);
+}
+
+// Converts RGB floats to GL_UNSIGNED_INT_5_9_9_9_REV, as specified in
+// EXT_texture_shared_exponent.
+uint32_t FloatToRgb9E5(const float* rgb) {
+  constexpr int kMantissaBits = 9;
+  constexpr int kExponentBias = 15;
+  constexpr float kMaxValue = 65408.0f;
+  float clamped[3];
+  for (int i = 0; i < 3; ++i) {
+    clamped[i] = rgb[i] > 0.0f ? std::min(rgb[i], kMaxValue) : 0.0f;
+  }
+  const float max_component =
+      std::max(clamped[0], std::max(clamped[1], clamped[2]));
+  int exponent = 0;
+  if (max_component > 0.0f) {
+    int max_exponent;
+    std::frexp(max_component, &max_exponent);
+    exponent = std::max(-kExponentBias, max_exponent) + kExponentBias;
+  }
+  if (std::floor(std::ldexp(max_component,
+          kExponentBias + kMantissaBits - exponent) + 0.5f) ==
+      (1 << kMantissaBits)) {
+    ++exponent;
+  }
+  uint32_t texel = static_cast<uint32_t>(exponent) << 27;
+  for (int i = 0; i < 3; ++i) {
+    const float mantissa = std::floor(std::ldexp(
+        clamped[i], kExponentBias + kMantissaBits - exponent) + 0.5f);
+    texel |= static_cast<uint32_t>(mantissa) << (kMantissaBits * i);
+  }
+  return texel;
+}
+
+uint32_t FloatToR11fG11fB10f(const float* rgb) {
+  return FloatToSmallFloat(rgb[0], 6) | (FloatToSmallFloat(rgb[1], 6) << 11) |
+      (FloatToSmallFloat(rgb[2], 5) << 22);
+}
+
+uint16_t FloatToUnorm16(float value) {
+  const float clamped = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+  return static_cast<uint16_t>(clamped * 65535.0f + 0.5f);
+}
+
+// The relative errors are computed with respect to at least this fraction
+// of the largest value of each component.
+void ComputeErrorFloors(const float* values, size_t texel_count, int stride,
+                        int components, double relative_error_floor,
+                        double floors[4]) {
+  for (int c = 0; c < 4; ++c) {
+    floors[c] = 0.0;
+  }
+  for (size_t t = 0; t < texel_count; ++t) {
+    for (int c = 0; c < components; ++c) {
+      floors[c] = std::max(floors[c],
+          static_cast<double>(std::fabs(values[t * stride + c])));
+    }
+  }
+  for (int c = 0; c < components; ++c) {
+    floors[c] *= relative_error_floor;
+  }
+}
+
+double RelativeError(float value, float reference, double floor) {
+  const double denominator =
+      std::max(static_cast<double>(std::fabs(reference)), floor);
+  return denominator > 0.0 ?
+      std::fabs(static_cast<double>(value) - reference) / denominator : 0.0;
+}
+
+}  // anonymous namespace
+
+
+const char* LutEncodingName(LutEncoding encoding) {
+  switch (encoding) {
+    case LUT_ENCODING_RGB9_E5: return "RGB9_E5";
+    case LUT_ENCODING_R11F_G11F_B10F: return "R11F_G11F_B10F";
+    case LUT_ENCODING_RGB16: return "RGB16";
+    case LUT_ENCODING_RGB16F: return "RGB16F";
+    case LUT_ENCODING_RGBA16F: return "RGBA16F";
+    default: return "?";
+  }
+}
+
+int LutEncodingTexelSize(LutEncoding encoding) {
+  switch (encoding) {
+    case LUT_ENCODING_RGB9_E5: return 4;
+    case LUT_ENCODING_R11F_G11F_B10F: return 4;
+    case LUT_ENCODING_RGB16: return 6;
+    case LUT_ENCODING_RGB16F: return 6;
+    case LUT_ENCODING_RGBA16F: return 8;
+  }
+  return 0;
+}
+
+uint16_t FloatToHalf(float value) {
+  const uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+  return sign | static_cast<uint16_t>(FloatToSmallFloat(std::fabs(value), 10));
+}
+
+QuantizedLut QuantizeLut(const LutEntry& source, const float* values,
+                         LutEncoding encoding, double relative_error_floor) {
+  const size_t texel_count =
+      static_cast<size_t>(source.width) * source.height * source.depth;
+  const int components = encoding == LUT_ENCODING_RGBA16F ? 4 : 3;
+
+  QuantizedLut result;
+  result.encoding = encoding;
+  result.entry = source;
+  switch (encoding) {
+    case LUT_ENCODING_RGB9_E5:
+    case LUT_ENCODING_R11F_G11F_B10F:
+      result.entry.format = encoding == LUT_ENCODING_RGB9_E5 ?
+          LUT_FORMAT_RGB9_E5 : LUT_FORMAT_R11F_G11F_B10F;
+      result.entry.components = 1;
+      result.entry.bytes_per_component = 4;
+      break;
+    case LUT_ENCODING_RGB16:
+      result.entry.format = LUT_FORMAT_UNORM16;
+      result.entry.components = 3;
+      result.entry.bytes_per_component = 2;
+      break;
+    default:
+      result.entry.format = LUT_FORMAT_FLOAT;
+      result.entry.components = components;
+      result.entry.bytes_per_component = 2;
+      break;
+  }
+  result.entry.size = texel_count * result.entry.components *
+      result.entry.bytes_per_component;
+  result.texels.resize(static_cast<size_t>(result.entry.size));
+
+  double floors[4];
+  ComputeErrorFloors(values, texel_count, source.components, components,
+                     relative_error_floor, floors);
+
+  uint32_t* words = reinterpret_cast<uint32_t*>(result.texels.data());
+  uint16_t* shorts = reinterpret_cast<uint16_t*>(result.texels.data());
+  double max_error = 0.0;
+  double sum_squared_error = 0.0;
+  for (size_t t = 0; t < texel_count; ++t) {
+    const float* texel = values + t * source.components;
+    float decoded[4];
+    switch (encoding) {
+      case LUT_ENCODING_RGB9_E5:
+        words[t] = FloatToRgb9E5(texel);
+        Rgb9E5ToFloat(words[t], decoded);
+        break;
+      case LUT_ENCODING_R11F_G11F_B10F:
+        words[t] = FloatToR11fG11fB10f(texel);
+        R11fG11fB10fToFloat(words[t], decoded);
+        break;
+      case LUT_ENCODING_RGB16:
+        for (int c = 0; c < 3; ++c) {
+          shorts[3 * t + c] = FloatToUnorm16(texel[c]);
+          decoded[c] = shorts[3 * t + c] / 65535.0f;
+        }
+        break;
+      default:
+        for (int c = 0; c < components; ++c) {
+          shorts[components * t + c] = FloatToHalf(texel[c]);
+          decoded[c] = HalfToFloat(shorts[components * t + c]);
+        }
+        break;
+    }
+    for (int c = 0; c < components; ++c) {
+      const double error = RelativeError(decoded[c], texel[c], floors[c]);
+      max_error = std::max(max_error, error);
+      sum_squared_error += error * error;
+    }
+  }
+  result.error.max_relative_error = max_error;
+  result.error.rms_relative_error = texel_count == 0 ? 0.0 :
+      std::sqrt(sum_squared_error / (texel_count * components));
+  return result;
+}
+
+LutError ComputeLutError(const float* reference, const float* values,
+                         size_t texel_count, int components,
+                         double relative_error_floor) {
+  double floors[4];
+  ComputeErrorFloors(reference, texel_count, components, components,
+                     relative_error_floor, floors);
+  double max_error = 0.0;
+  double sum_squared_error = 0.0;
+  for (size_t i = 0; i < texel_count * components; ++i) {
+    const double error =
+        RelativeError(values[i], reference[i], floors[i % components]);
+    max_error = std::max(max_error, error);
+    sum_squared_error += error * error;
+  }
+  LutError result;
+  result.max_relative_error = max_error;
+  result.rms_relative_error = texel_count == 0 ? 0.0 :
+      std::sqrt(sum_squared_error / (texel_count * components));
+  return result;
+}
+
+bool SelectLutEncoding(const LutEntry& source, const float* values,
+                       const std::vector<LutEncoding>& candidates,
+                       const LutErrorBudget& budget, QuantizedLut* result,
+                       JobPool* job_pool) {
+  std::vector<LutEncoding> encodings;
+  for (LutEncoding encoding : candidates) {
+    if (encoding != LUT_ENCODING_RGBA16F || source.components == 4) {
+      encodings.push_back(encoding);
+    }
+  }
+  std::vector<QuantizedLut> quantized(encodings.size());
+  auto quantize = [&](int i) {
+    quantized[i] = QuantizeLut(source, values, encodings[i],
+                               budget.relative_error_floor);
+  };
+  if (job_pool != nullptr && encodings.size() > 1) {
+    job_pool->ParallelFor(static_cast<int>(encodings.size()), quantize);
+  } else {
+    for (size_t i = 0; i < encodings.size(); ++i) {
+      quantize(static_cast<int>(i));
+    }
+  }
+
+  bool found = false;
+  for (QuantizedLut& candidate : quantized) {
+    if (candidate.error.max_relative_error > budget.max_relative_error ||
+        candidate.error.rms_relative_error > budget.rms_relative_error) {
+      continue;
+    }
+    if (!found || candidate.entry.size < result->entry.size ||
+        (candidate.entry.size == result->entry.size &&
+         candidate.error.rms_relative_error <
+             result->error.rms_relative_error)) {
+      *result = std::move(candidate);
+      found = true;
+    }
+  }
+  return found;
+}
+
+std::string FormatLutQuantizationReport(const LutQuantizationReport& report) {
+  static const char* const kLutNames[LUT_COUNT] = {
+      "transmittance", "scattering", "single Mie scattering", "irradiance"};
+  std::ostringstream result;
+  result.setf(std::ios::fixed);
+  result.precision(1);
+  result << kLutNames[report.id] << ": ";
+  if (!report.quantized) {
+    result << "unchanged, " << report.size / 1024.0 << " KB";
+    return result.str();
+  }
+  result << LutEncodingName(report.encoding) << ", "
+         << report.original_size / 1024.0 << " KB -> "
+         << report.size / 1024.0 << " KB";
+  result.precision(2);
+  result << ", max error " << report.error.max_relative_error * 100.0
+         << "%, rms error " << report.error.rms_relative_error * 100.0 << "%";
+  return result.str();
+}
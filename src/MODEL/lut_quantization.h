@@ -0,0 +1,107 @@
+#ifndef ATMOSPHERE_LUT_QUANTIZATION_H_
+#define ATMOSPHERE_LUT_QUANTIZATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lut_file.h"
+
+class JobPool;
+
+// Smaller storage formats for the precomputed textures. The precomputations
+// render into float textures, which are then converted, on the CPU, to the
+// smallest candidate format whose error is within a budget. The conversion
+// error is measured against the precomputed values (i.e. against the float32
+// bake, unless the model uses half precision), with relative errors per
+// component.
+
+// The candidate formats. All of them drop the alpha component, except
+// LUT_ENCODING_RGBA16F (the alpha component is only used by the combined
+// scattering texture).
+enum LutEncoding {
+  // Shared exponent floats, 4 bytes per texel.
+  LUT_ENCODING_RGB9_E5,
+  // Unsigned floats with 6, 6 and 5 bits mantissas, 4 bytes per texel.
+  LUT_ENCODING_R11F_G11F_B10F,
+  // 16 bits normalized integers, for values in [0,1], 6 bytes per texel.
+  LUT_ENCODING_RGB16,
+  // Half floats, 6 and 8 bytes per texel.
+  LUT_ENCODING_RGB16F,
+  LUT_ENCODING_RGBA16F
+};
+
+const char* LutEncodingName(LutEncoding encoding);
+
+// The size of a texel in 'encoding', in bytes.
+int LutEncodingTexelSize(LutEncoding encoding);
+
+struct LutErrorBudget {
+  // The maximum and root mean square relative errors allowed.
+  double max_relative_error = 0.02;
+  double rms_relative_error = 0.005;
+  // The relative errors of the values smaller than this fraction of the
+  // largest value of their component, in the whole texture, are computed
+  // relatively to this smaller value (the relative error of values close to 0
+  // is meaningless, and invisible next to the large values).
+  double relative_error_floor = 1e-3;
+};
+
+struct LutError {
+  double max_relative_error;
+  double rms_relative_error;
+};
+
+struct QuantizedLut {
+  LutEncoding encoding;
+  // The format, components and size of 'texels' (the other fields are those
+  // of the source LUT).
+  LutEntry entry;
+  std::vector<unsigned char> texels;
+  LutError error;
+};
+
+// Converts 'values', the float texels of the LUT described by 'source' (with
+// 'source.components' floats per texel), to 'encoding', and measures the
+// error of the RGB components (and of alpha for LUT_ENCODING_RGBA16F).
+QuantizedLut QuantizeLut(const LutEntry& source, const float* values,
+                         LutEncoding encoding, double relative_error_floor);
+
+// Measures the error of 'values' with respect to 'reference', two arrays of
+// 'texel_count' texels of 'components' floats each, in the same way as
+// QuantizeLut (e.g. to compare LUTs precomputed with different settings).
+LutError ComputeLutError(const float* reference, const float* values,
+                         size_t texel_count, int components,
+                         double relative_error_floor);
+
+// Quantizes 'values' with each candidate encoding, and returns in 'result' the
+// smallest one within 'budget' (the most accurate one in case of a tie).
+// Returns false if no candidate is within the budget. The candidates are
+// quantized in parallel on 'job_pool', if not null.
+bool SelectLutEncoding(const LutEntry& source, const float* values,
+                       const std::vector<LutEncoding>& candidates,
+                       const LutErrorBudget& budget, QuantizedLut* result,
+                       JobPool* job_pool = nullptr);
+
+// The result of Model1::QuantizeLuts for one texture.
+struct LutQuantizationReport {
+  LutId id;
+  // Whether the texture was converted (to 'encoding', with 'error'), or kept
+  // in its precomputed format.
+  bool quantized;
+  LutEncoding encoding;
+  uint64_t original_size;
+  uint64_t size;
+  LutError error;
+};
+
+// Returns a one line description of 'report', e.g. "irradiance: RGB9_E5,
+// 64.0 KB -> 16.0 KB, max error 0.35%, rms error 0.09%".
+std::string FormatLutQuantizationReport(const LutQuantizationReport& report);
+
+// Converts a float to an IEEE 754 half precision float (rounded to nearest,
+// and clamped to the largest finite half).
+uint16_t FloatToHalf(float value);
+
+#endif  // ATMOSPHERE_LUT_QUANTIZATION_H_
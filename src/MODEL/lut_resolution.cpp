@@ -0,0 +1,61 @@
+#include "lut_resolution.h"
+
+namespace {
+
+struct LutQualityPreset {
+  const char* name;
+  int transmittance_width;
+  int transmittance_height;
+  int scattering_r_size;
+  int scattering_mu_size;
+  int scattering_mu_s_size;
+  int scattering_nu_size;
+  int irradiance_width;
+  int irradiance_height;
+};
+
+// In LutQuality order.
+constexpr LutQualityPreset kPresets[] = {
+  {"low", 128, 32, 16, 64, 16, 8, 32, 8},
+  {"default", 256, 64, 32, 128, 32, 8, 64, 16},
+  {"high", 512, 128, 48, 192, 48, 12, 128, 32},
+  {"ultra", 1024, 256, 64, 256, 64, 16, 256, 64}
+};
+constexpr int kPresetCount = sizeof(kPresets) / sizeof(kPresets[0]);
+
+}  // anonymous namespace
+
+bool LutResolution::IsValid() const {
+  return transmittance_width > 0 && transmittance_height > 0 &&
+      scattering_r_size > 0 && scattering_mu_size > 0 &&
+      scattering_mu_size % 2 == 0 && scattering_mu_s_size > 0 &&
+      scattering_nu_size > 0 && irradiance_width > 0 && irradiance_height > 0;
+}
+
+LutResolution LutResolutionForQuality(LutQuality quality) {
+  const LutQualityPreset& preset = kPresets[quality];
+  LutResolution resolution;
+  resolution.transmittance_width = preset.transmittance_width;
+  resolution.transmittance_height = preset.transmittance_height;
+  resolution.scattering_r_size = preset.scattering_r_size;
+  resolution.scattering_mu_size = preset.scattering_mu_size;
+  resolution.scattering_mu_s_size = preset.scattering_mu_s_size;
+  resolution.scattering_nu_size = preset.scattering_nu_size;
+  resolution.irradiance_width = preset.irradiance_width;
+  resolution.irradiance_height = preset.irradiance_height;
+  return resolution;
+}
+
+const char* LutQualityName(LutQuality quality) {
+  return kPresets[quality].name;
+}
+
+bool ParseLutQuality(const std::string& name, LutQuality* quality) {
+  for (int i = 0; i < kPresetCount; ++i) {
+    if (name == kPresets[i].name) {
+      *quality = static_cast<LutQuality>(i);
+      return true;
+    }
+  }
+  return false;
+}
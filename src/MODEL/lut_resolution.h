@@ -0,0 +1,48 @@
+#ifndef ATMOSPHERE_LUT_RESOLUTION_H_
+#define ATMOSPHERE_LUT_RESOLUTION_H_
+
+#include <string>
+
+// The sizes of the precomputed textures of a Model1. They are compiled into
+// its shaders, like the atmosphere parameters, so that each model can use its
+// own sizes. The 4D scattering table, of NU x MU_S x MU x R values, is stored
+// in a 3D texture of (NU * MU_S) x MU x R texels. The default values are those
+// of the original implementation.
+struct LutResolution {
+  int transmittance_width = 256;
+  int transmittance_height = 64;
+  int scattering_r_size = 32;
+  // Must be even (the view zenith angles above and below the horizon use
+  // half of the values each).
+  int scattering_mu_size = 128;
+  int scattering_mu_s_size = 32;
+  int scattering_nu_size = 8;
+  int irradiance_width = 64;
+  int irradiance_height = 16;
+
+  int scattering_width() const {
+    return scattering_nu_size * scattering_mu_s_size;
+  }
+  int scattering_height() const { return scattering_mu_size; }
+  int scattering_depth() const { return scattering_r_size; }
+  // Whether all the sizes are positive, and the MU size is even.
+  bool IsValid() const;
+};
+
+// Named presets, from low memory nodes (about 8 times less texels than the
+// default) to high fidelity offline renders (about 16 times more, which
+// requires a GL_MAX_3D_TEXTURE_SIZE of at least 1024).
+enum LutQuality {
+  LUT_QUALITY_LOW,
+  LUT_QUALITY_DEFAULT,
+  LUT_QUALITY_HIGH,
+  LUT_QUALITY_ULTRA
+};
+
+LutResolution LutResolutionForQuality(LutQuality quality);
+// "low", "default", "high" or "ultra".
+const char* LutQualityName(LutQuality quality);
+// Returns false if 'name' is not a LutQualityName.
+bool ParseLutQuality(const std::string& name, LutQuality* quality);
+
+#endif  // ATMOSPHERE_LUT_RESOLUTION_H_
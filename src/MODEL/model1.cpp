@@ -16,12 +16,22 @@ of the following C++ code.
 
 #include <glad/glad.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
 
 #include "constants.h"
+#include "CORE/job_pool.h"
+#include "CORE/trace.h"
+#include "RENDER/gl_trace_scope.h"
+#include "RENDER/gpu_memory_tracker.h"
+#include "RENDER/gpu_profiler.h"
+#include "RENDER/shader_compile.h"
 
 /*
 <h3 id="shaders">Shader definitions</h3>
@@ -234,69 +244,60 @@ const char kAtmosphereShader[] = R"(
 /*<h3 id="utilities">Utility classes and functions</h3>
 
 <p>To compile and link these shaders into programs, and to set their uniforms,
-we use the following utility class:
+we use the following utility class. Its constructor only submits the
+compilation and link commands, and their status is checked when the program is
+first used (see <code>FinishProgramLink</code>). This allows the driver to
+compile several programs in parallel, if they are all created before using
+any of them:
 */
 
 class Program {
  public:
   Program(
+      const std::string& name,
       const std::string& vertex_shader_source,
       const std::string& fragment_shader_source)
-    : Program(vertex_shader_source, "", fragment_shader_source) {
+    : Program(name, vertex_shader_source, "", fragment_shader_source) {
   }
 
   Program(
+      const std::string& name,
       const std::string& vertex_shader_source,
       const std::string& geometry_shader_source,
-      const std::string& fragment_shader_source) {
+      const std::string& fragment_shader_source)
+    : name_(name), linked_(false) {
+    submit_begin_ns_ = TraceNanoseconds();
     program_ = glCreateProgram();
-
-    const char* source;
-    source = vertex_shader_source.c_str();
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &source, NULL);
-    glCompileShader(vertex_shader);
-    CheckShader(vertex_shader);
-    glAttachShader(program_, vertex_shader);
-
-    GLuint geometry_shader = 0;
+    AttachShader(GL_VERTEX_SHADER, vertex_shader_source);
     if (!geometry_shader_source.empty()) {
-      source = geometry_shader_source.c_str();
-      geometry_shader = glCreateShader(GL_GEOMETRY_SHADER);
-      glShaderSource(geometry_shader, 1, &source, NULL);
-      glCompileShader(geometry_shader);
-      CheckShader(geometry_shader);
-      glAttachShader(program_, geometry_shader);
+      AttachShader(GL_GEOMETRY_SHADER, geometry_shader_source);
     }
-
-    source = fragment_shader_source.c_str();
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &source, NULL);
-    glCompileShader(fragment_shader);
-    CheckShader(fragment_shader);
-    glAttachShader(program_, fragment_shader);
-
+    AttachShader(GL_FRAGMENT_SHADER, fragment_shader_source);
     glLinkProgram(program_);
-    CheckProgram(program_);
-
-    glDetachShader(program_, vertex_shader);
-    glDeleteShader(vertex_shader);
-    if (!geometry_shader_source.empty()) {
-      glDetachShader(program_, geometry_shader);
-      glDeleteShader(geometry_shader);
-    }
-    glDetachShader(program_, fragment_shader);
-    glDeleteShader(fragment_shader);
+    submit_end_ns_ = TraceNanoseconds();
   }
 
+  Program(Program const&) = delete;
+
   ~Program() {
+    DeleteShaders();
     glDeleteProgram(program_);
   }
 
   void Use() const {
+    if (!linked_) {
+      const bool link_status = FinishProgramLink(
+          program_, shaders_, name_, submit_begin_ns_, submit_end_ns_);
+      assert(link_status);
+      (void) link_status;
+      DeleteShaders();
+      linked_ = true;
+    }
     glUseProgram(program_);
   }
 
+  GLuint id() const { return program_; }
+
   void BindMat3(const std::string& uniform_name,
       const std::array<float, 9>& value) const {
     glUniformMatrix3fv(glGetUniformLocation(program_, uniform_name.c_str()),
@@ -322,88 +323,51 @@ class Program {
   }
 
  private:
-  static void CheckShader(GLuint shader) {
-    GLint compile_status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-    if (compile_status == GL_FALSE) {
-      PrintShaderLog(shader);
-    }
-    assert(compile_status == GL_TRUE);
+  void AttachShader(GLenum type, const std::string& shader_source) {
+    const char* source = shader_source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glAttachShader(program_, shader);
+    shaders_.push_back(shader);
   }
 
-  static void PrintShaderLog(GLuint shader) {
-    GLint log_length;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
-    if (log_length > 0) {
-      std::unique_ptr<char[]> log_data(new char[log_length]);
-      glGetShaderInfoLog(shader, log_length, &log_length, log_data.get());
-      std::cerr << "compile log = "
-                << std::string(log_data.get(), log_length) << std::endl;
-    }
-  }
-
-  static void CheckProgram(GLuint program) {
-    GLint link_status;
-    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-    if (link_status == GL_FALSE) {
-      PrintProgramLog(program);
-    }
-    assert(link_status == GL_TRUE);
-    assert(glGetError() == 0);
-  }
-
-  static void PrintProgramLog(GLuint program) {
-    GLint log_length;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
-    if (log_length > 0) {
-      std::unique_ptr<char[]> log_data(new char[log_length]);
-      glGetProgramInfoLog(program, log_length, &log_length, log_data.get());
-      std::cerr << "link log = "
-                << std::string(log_data.get(), log_length) << std::endl;
+  // The shaders are kept until the link is finished, to print their compile
+  // logs if it fails.
+  void DeleteShaders() const {
+    for (GLuint shader : shaders_) {
+      glDetachShader(program_, shader);
+      glDeleteShader(shader);
     }
+    shaders_.clear();
   }
 
+  std::string name_;
   GLuint program_;
+  mutable std::vector<GLuint> shaders_;
+  mutable bool linked_;
+  int64_t submit_begin_ns_;
+  int64_t submit_end_ns_;
 };
 
 /*
-<p>We also need functions to allocate the precomputed textures on GPU:
+<p>We also need functions to allocate the precomputed textures on GPU (or
+rather to borrow them from a <code>TexturePool</code>, so that rebuilding a
+model with the same texture sizes reuses the textures of the previous one):
 */
 
-GLuint NewTexture2d(int width, int height) {
-  GLuint texture;
-  glGenTextures(1, &texture);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+GLuint NewTexture2d(TexturePool* pool, GpuMemoryCategory category, int width,
+    int height) {
   // 16F precision for the transmittance gives artifacts.
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0,
-      GL_RGBA, GL_FLOAT, NULL);
-  return texture;
+  return pool->Acquire(category, GL_RGBA32F, width, height);
 }
 
-GLuint NewTexture3d(int width, int height, int depth, GLenum format,
-    bool half_precision) {
-  GLuint texture;
-  glGenTextures(1, &texture);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_3D, texture);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+GLuint NewTexture3d(TexturePool* pool, GpuMemoryCategory category, int width,
+    int height, int depth, GLenum format, bool half_precision) {
   GLenum internal_format = format == GL_RGBA ?
       (half_precision ? GL_RGBA16F : GL_RGBA32F) :
       (half_precision ? GL_RGB16F : GL_RGB32F);
-  glTexImage3D(GL_TEXTURE_3D, 0, internal_format, width, height, depth, 0,
-      format, GL_FLOAT, NULL);
-  return texture;
+  return pool->Acquire(category, internal_format, width, height, depth);
 }
 
 /*
@@ -420,17 +384,78 @@ bool IsFramebufferRgbFormatSupported(bool half_precision) {
   glGenTextures(1, &test_texture);
   glBindTexture(GL_TEXTURE_2D, test_texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D, 0, half_precision ? GL_RGB16F : GL_RGB32F,
-               1, 1, 0, GL_RGB, GL_FLOAT, NULL);
+  const GLenum internal_format = half_precision ? GL_RGB16F : GL_RGB32F;
+  glTexImage2D(GL_TEXTURE_2D, 0, internal_format, 1, 1, 0, GL_RGB, GL_FLOAT,
+               NULL);
+  TrackGpuTexture(test_texture, GPU_MEMORY_TEMPORARY,
+                  GlTextureBytes(internal_format, 1, 1));
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                          GL_TEXTURE_2D, test_texture, 0);
   bool rgb_format_supported =
       glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
-  glDeleteTextures(1, &test_texture);
+  DeleteGpuTextures(1, &test_texture);
   glDeleteFramebuffers(1, &test_fbo);
   return rgb_format_supported;
 }
 
+/*
+<p>and functions to get the OpenGL formats corresponding to the texels of a
+<code>LutEntry</code> (see <code>lut_file.h</code>), and to validate them:
+*/
+
+bool IsValidLutStorage(const LutEntry& entry) {
+  switch (entry.format) {
+    case LUT_FORMAT_FLOAT:
+      return (entry.components == 3 || entry.components == 4) &&
+          (entry.bytes_per_component == 2 || entry.bytes_per_component == 4);
+    case LUT_FORMAT_UNORM16:
+      return entry.components == 3 && entry.bytes_per_component == 2;
+    case LUT_FORMAT_RGB9_E5:
+    case LUT_FORMAT_R11F_G11F_B10F:
+      return entry.components == 1 && entry.bytes_per_component == 4;
+    default:
+      return false;
+  }
+}
+
+void GetLutPixelFormat(const LutEntry& entry, GLenum* internal_format,
+    GLenum* format, GLenum* type) {
+  const bool rgba = entry.components == 4;
+  *format = rgba ? GL_RGBA : GL_RGB;
+  switch (entry.format) {
+    case LUT_FORMAT_UNORM16:
+      *internal_format = GL_RGB16;
+      *type = GL_UNSIGNED_SHORT;
+      break;
+    case LUT_FORMAT_RGB9_E5:
+      *internal_format = GL_RGB9_E5;
+      *type = GL_UNSIGNED_INT_5_9_9_9_REV;
+      break;
+    case LUT_FORMAT_R11F_G11F_B10F:
+      *internal_format = GL_R11F_G11F_B10F;
+      *type = GL_UNSIGNED_INT_10F_11F_11F_REV;
+      break;
+    default:
+      if (entry.bytes_per_component == 2) {
+        *internal_format = rgba ? GL_RGBA16F : GL_RGB16F;
+        *type = GL_HALF_FLOAT;
+      } else {
+        *internal_format = rgba ? GL_RGBA32F : GL_RGB32F;
+        *type = GL_FLOAT;
+      }
+      break;
+  }
+}
+
+// Whether texels in the format of 'entry' can be uploaded to a texture in the
+// format of 'texture_entry' (which may differ in RGB vs RGBA).
+bool HasSameLutStorage(const LutEntry& entry, const LutEntry& texture_entry) {
+  return entry.format == texture_entry.format &&
+      entry.bytes_per_component == texture_entry.bytes_per_component &&
+      (entry.format == LUT_FORMAT_FLOAT ||
+       entry.components == texture_entry.components);
+}
+
 /*
 <p>and a function to draw a full screen quad in an offscreen framebuffer (with
 blending separately enabled or disabled for each color attachment):
@@ -547,6 +572,39 @@ void ComputeSpectralRadianceToLuminanceFactors(
 
 }  // anonymous namespace
 
+/*
+<p>The precomputations require specific GLSL programs, for each precomputation
+step and for each group of 3 wavelengths. They are grouped in the following
+structure, whose constructor submits their compilation:
+*/
+
+struct Model1::PrecomputePrograms {
+  PrecomputePrograms(const std::string& header, const std::string& suffix)
+    : compute_transmittance("transmittance" + suffix,
+          kVertexShader, header + kComputeTransmittanceShader),
+      compute_direct_irradiance("direct irradiance" + suffix,
+          kVertexShader, header + kComputeDirectIrradianceShader),
+      compute_single_scattering("single scattering" + suffix,
+          kVertexShader, kGeometryShader,
+          header + kComputeSingleScatteringShader),
+      compute_scattering_density("scattering density" + suffix,
+          kVertexShader, kGeometryShader,
+          header + kComputeScatteringDensityShader),
+      compute_indirect_irradiance("indirect irradiance" + suffix,
+          kVertexShader, header + kComputeIndirectIrradianceShader),
+      compute_multiple_scattering("multiple scattering" + suffix,
+          kVertexShader, kGeometryShader,
+          header + kComputeMultipleScatteringShader) {
+  }
+
+  Program compute_transmittance;
+  Program compute_direct_irradiance;
+  Program compute_single_scattering;
+  Program compute_scattering_density;
+  Program compute_indirect_irradiance;
+  Program compute_multiple_scattering;
+};
+
 /*<h3 id="implementation">Model implementation</h3>
 
 <p>Using the above utility functions and classes, we can now implement the
@@ -579,11 +637,24 @@ Model1::Model1(
     double lengthUnitInMeters,
     unsigned int numPrecomputedWavelengths,
     bool combineScatteringTextures,
-    bool halfPrecision) :
+    bool halfPrecision,
+    const LutResolution& resolution,
+    const SampleCounts& sampleCounts,
+    TexturePool* sharedTexturePool) :
         numPrecomputedWavelengths(numPrecomputedWavelengths),
         halfPrecision(halfPrecision),
+        lutResolution(resolution),
+        integrationSampleCounts(sampleCounts),
+        ownedTexturePool(
+            sharedTexturePool == nullptr ? new TexturePool : nullptr),
+        texturePool(sharedTexturePool == nullptr ?
+            ownedTexturePool.get() : sharedTexturePool),
         rgbFormatSupported(IsFramebufferRgbFormatSupported(halfPrecision)) {
-  auto to_string = [&wavelengths](const std::vector<double>& v,
+  assert(resolution.IsValid());
+  assert(sampleCounts.IsValid());
+  // Captured by value, since glsl_header_factory_ is used after the
+  // constructor returns (by Init, ParameterHash, etc).
+  auto to_string = [wavelengths](const std::vector<double>& v,
       const vec3& lambdas, double scale) {
     double r = Interpolate(wavelengths, v, lambdas[0]) * scale;
     double g = Interpolate(wavelengths, v, lambdas[1]) * scale;
@@ -647,21 +718,31 @@ Model1::Model1(
       "#define TEMPLATE_ARGUMENT(x)\n"
       "#define assert(x)\n"
       "const int TRANSMITTANCE_TEXTURE_WIDTH = " +
-          std::to_string(TRANSMITTANCE_TEXTURE_WIDTH) + ";\n" +
+          std::to_string(resolution.transmittance_width) + ";\n" +
       "const int TRANSMITTANCE_TEXTURE_HEIGHT = " +
-          std::to_string(TRANSMITTANCE_TEXTURE_HEIGHT) + ";\n" +
+          std::to_string(resolution.transmittance_height) + ";\n" +
       "const int SCATTERING_TEXTURE_R_SIZE = " +
-          std::to_string(SCATTERING_TEXTURE_R_SIZE) + ";\n" +
+          std::to_string(resolution.scattering_r_size) + ";\n" +
       "const int SCATTERING_TEXTURE_MU_SIZE = " +
-          std::to_string(SCATTERING_TEXTURE_MU_SIZE) + ";\n" +
+          std::to_string(resolution.scattering_mu_size) + ";\n" +
       "const int SCATTERING_TEXTURE_MU_S_SIZE = " +
-          std::to_string(SCATTERING_TEXTURE_MU_S_SIZE) + ";\n" +
+          std::to_string(resolution.scattering_mu_s_size) + ";\n" +
       "const int SCATTERING_TEXTURE_NU_SIZE = " +
-          std::to_string(SCATTERING_TEXTURE_NU_SIZE) + ";\n" +
+          std::to_string(resolution.scattering_nu_size) + ";\n" +
       "const int IRRADIANCE_TEXTURE_WIDTH = " +
-          std::to_string(IRRADIANCE_TEXTURE_WIDTH) + ";\n" +
+          std::to_string(resolution.irradiance_width) + ";\n" +
       "const int IRRADIANCE_TEXTURE_HEIGHT = " +
-          std::to_string(IRRADIANCE_TEXTURE_HEIGHT) + ";\n" +
+          std::to_string(resolution.irradiance_height) + ";\n" +
+      "const int TRANSMITTANCE_SAMPLE_COUNT = " +
+          std::to_string(sampleCounts.transmittance) + ";\n" +
+      "const int SINGLE_SCATTERING_SAMPLE_COUNT = " +
+          std::to_string(sampleCounts.single_scattering) + ";\n" +
+      "const int SCATTERING_DENSITY_SAMPLE_COUNT = " +
+          std::to_string(sampleCounts.scattering_density) + ";\n" +
+      "const int MULTIPLE_SCATTERING_SAMPLE_COUNT = " +
+          std::to_string(sampleCounts.multiple_scattering) + ";\n" +
+      "const int INDIRECT_IRRADIANCE_SAMPLE_COUNT = " +
+          std::to_string(sampleCounts.indirect_irradiance) + ";\n" +
       (combineScatteringTextures ?
           "#define COMBINED_SCATTERING_TEXTURES\n" : "") +
       definitions_glsl +
@@ -694,28 +775,33 @@ Model1::Model1(
   };
 
   // Allocate the precomputed textures, but don't precompute them yet.
-  transmittanceTexture = NewTexture2d(
-      TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT);
-  scatteringTexture = NewTexture3d(
-      SCATTERING_TEXTURE_WIDTH,
-      SCATTERING_TEXTURE_HEIGHT,
-      SCATTERING_TEXTURE_DEPTH,
+  transmittanceTexture = NewTexture2d(texturePool, GPU_MEMORY_LUT,
+      lutResolution.transmittance_width, lutResolution.transmittance_height);
+  scatteringTexture = NewTexture3d(texturePool, GPU_MEMORY_LUT,
+      lutResolution.scattering_width(),
+      lutResolution.scattering_height(),
+      lutResolution.scattering_depth(),
       combineScatteringTextures || !rgbFormatSupported ? GL_RGBA : GL_RGB,
       halfPrecision);
   if (combineScatteringTextures) {
     optionalSingleMieScatteringTexture = 0;
   } else {
-    optionalSingleMieScatteringTexture = NewTexture3d(
-        SCATTERING_TEXTURE_WIDTH,
-        SCATTERING_TEXTURE_HEIGHT,
-        SCATTERING_TEXTURE_DEPTH,
+    optionalSingleMieScatteringTexture = NewTexture3d(texturePool,
+        GPU_MEMORY_LUT, lutResolution.scattering_width(),
+        lutResolution.scattering_height(),
+        lutResolution.scattering_depth(),
         rgbFormatSupported ? GL_RGB : GL_RGBA,
         halfPrecision);
   }
-  irradianceTexture = NewTexture2d(
-      IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
+  irradianceTexture = NewTexture2d(texturePool, GPU_MEMORY_LUT,
+      lutResolution.irradiance_width, lutResolution.irradiance_height);
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    lutEntries[i] = precomputedLutEntry(static_cast<LutId>(i));
+  }
 
-  // Create and compile the shader providing our API.
+  // Create and compile the shader providing our API (its compile status is
+  // only checked when linking the programs which use it, so that its
+  // compilation can overlap with the precomputations).
   std::string shader =
       glsl_header_factory_({kLambdaR, kLambdaG, kLambdaB}) +
       (precompute_illuminance ? "" : "#define RADIANCE_API_ENABLED\n") +
@@ -738,6 +824,7 @@ Model1::Model1(
   };
   constexpr int kCoordsPerVertex = 2;
   glBufferData(GL_ARRAY_BUFFER, sizeof vertices, vertices, GL_STATIC_DRAW);
+  TrackGpuBuffer(fullScreenQuadVBO, GPU_MEMORY_TEMPORARY, sizeof vertices);
   constexpr GLuint kAttribIndex = 0;
   glVertexAttribPointer(kAttribIndex, kCoordsPerVertex, GL_FLOAT, false, 0, 0);
   glEnableVertexAttribArray(kAttribIndex);
@@ -749,14 +836,14 @@ Model1::Model1(
 */
 
 Model1::~Model1() {
-  glDeleteBuffers(1, &fullScreenQuadVBO);
+  DeleteGpuBuffers(1, &fullScreenQuadVBO);
   glDeleteVertexArrays(1, &fullScreenQuadVAO);
-  glDeleteTextures(1, &transmittanceTexture);
-  glDeleteTextures(1, &scatteringTexture);
+  texturePool->Release(transmittanceTexture);
+  texturePool->Release(scatteringTexture);
   if (optionalSingleMieScatteringTexture != 0) {
-    glDeleteTextures(1, &optionalSingleMieScatteringTexture);
+    texturePool->Release(optionalSingleMieScatteringTexture);
   }
-  glDeleteTextures(1, &irradianceTexture);
+  texturePool->Release(irradianceTexture);
   glDeleteShader(atmosphereShader);
 }
 
@@ -815,30 +902,35 @@ want to store precomputed irradiance or illuminance values:
 <p>This yields the following implementation:
 */
 
-void Model1::Init(unsigned int num_scattering_orders) {
+void Model1::Init(unsigned int num_scattering_orders,
+                  LayerExchange* layer_exchange,
+                  GpuProfiler* profiler) {
+  TRACE_SCOPE("Model1::Init");
+  RestorePrecomputedLutStorage();
   // The precomputations require temporary textures, in particular to store the
   // contribution of one scattering order, which is needed to compute the next
   // order of scattering (the final precomputed textures store the sum of all
   // the scattering orders). We allocate them here, and destroy them at the end
   // of this method.
-  GLuint delta_irradiance_texture = NewTexture2d(
-      IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
-  GLuint delta_rayleigh_scattering_texture = NewTexture3d(
-      SCATTERING_TEXTURE_WIDTH,
-      SCATTERING_TEXTURE_HEIGHT,
-      SCATTERING_TEXTURE_DEPTH,
+  GLuint delta_irradiance_texture = NewTexture2d(texturePool,
+      GPU_MEMORY_TEMPORARY, lutResolution.irradiance_width,
+      lutResolution.irradiance_height);
+  GLuint delta_rayleigh_scattering_texture = NewTexture3d(texturePool,
+      GPU_MEMORY_TEMPORARY, lutResolution.scattering_width(),
+      lutResolution.scattering_height(),
+      lutResolution.scattering_depth(),
       rgbFormatSupported ? GL_RGB : GL_RGBA,
       halfPrecision);
-  GLuint delta_mie_scattering_texture = NewTexture3d(
-      SCATTERING_TEXTURE_WIDTH,
-      SCATTERING_TEXTURE_HEIGHT,
-      SCATTERING_TEXTURE_DEPTH,
+  GLuint delta_mie_scattering_texture = NewTexture3d(texturePool,
+      GPU_MEMORY_TEMPORARY, lutResolution.scattering_width(),
+      lutResolution.scattering_height(),
+      lutResolution.scattering_depth(),
       rgbFormatSupported ? GL_RGB : GL_RGBA,
       halfPrecision);
-  GLuint delta_scattering_density_texture = NewTexture3d(
-      SCATTERING_TEXTURE_WIDTH,
-      SCATTERING_TEXTURE_HEIGHT,
-      SCATTERING_TEXTURE_DEPTH,
+  GLuint delta_scattering_density_texture = NewTexture3d(texturePool,
+      GPU_MEMORY_TEMPORARY, lutResolution.scattering_width(),
+      lutResolution.scattering_height(),
+      lutResolution.scattering_depth(),
       rgbFormatSupported ? GL_RGB : GL_RGBA,
       halfPrecision);
   // delta_multiple_scattering_texture is only needed to compute scattering
@@ -854,26 +946,57 @@ void Model1::Init(unsigned int num_scattering_orders) {
   glGenFramebuffers(1, &fbo);
   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
+  // The precomputations are done for 3 wavelengths at a time: once, or for
+  // each group of 3 wavelengths if we want to store precomputed illuminance
+  // values. Their GLSL programs are all created here, before using any of
+  // them, so that the driver can compile them in parallel (they are
+  // automatically destroyed when this method returns, via the Program
+  // destructor).
+  constexpr double kLambdaMin = 360.0;
+  constexpr double kLambdaMax = 830.0;
+  const bool precompute_illuminance = numPrecomputedWavelengths > 3;
+  int num_iterations =
+      precompute_illuminance ? (numPrecomputedWavelengths + 2) / 3 : 1;
+  double dlambda = (kLambdaMax - kLambdaMin) / (3 * num_iterations);
+  std::vector<vec3> wavelength_groups;
+  std::vector<std::unique_ptr<PrecomputePrograms>> programs;
+  for (int i = 0; i < num_iterations; ++i) {
+    if (precompute_illuminance) {
+      wavelength_groups.push_back({
+        kLambdaMin + (3 * i + 0.5) * dlambda,
+        kLambdaMin + (3 * i + 1.5) * dlambda,
+        kLambdaMin + (3 * i + 2.5) * dlambda
+      });
+    } else {
+      wavelength_groups.push_back({kLambdaR, kLambdaG, kLambdaB});
+    }
+    programs.emplace_back(new PrecomputePrograms(
+        glsl_header_factory_(wavelength_groups.back()),
+        precompute_illuminance ? " (wavelengths " + std::to_string(3 * i + 1) +
+            "-" + std::to_string(3 * i + 3) + ")" : ""));
+  }
+  // The transmittance at kLambdaR, kLambdaG, kLambdaB, if the above
+  // wavelengths are different (see below).
+  std::unique_ptr<Program> compute_final_transmittance;
+  if (precompute_illuminance) {
+    compute_final_transmittance.reset(new Program("final transmittance",
+        kVertexShader,
+        glsl_header_factory_({kLambdaR, kLambdaG, kLambdaB}) +
+            kComputeTransmittanceShader));
+  }
+
   // The actual precomputations depend on whether we want to store precomputed
   // irradiance or illuminance values.
-  if (numPrecomputedWavelengths <= 3) {
-    vec3 lambdas{kLambdaR, kLambdaG, kLambdaB};
+  if (!precompute_illuminance) {
     mat3 luminance_from_radiance{1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
     Precompute(fbo, delta_irradiance_texture, delta_rayleigh_scattering_texture,
         delta_mie_scattering_texture, delta_scattering_density_texture,
-        delta_multiple_scattering_texture, lambdas, luminance_from_radiance,
-        false /* blend */, num_scattering_orders);
+        delta_multiple_scattering_texture, *programs[0],
+        luminance_from_radiance, false /* blend */, num_scattering_orders,
+        layer_exchange, profiler);
   } else {
-    constexpr double kLambdaMin = 360.0;
-    constexpr double kLambdaMax = 830.0;
-    int num_iterations = (numPrecomputedWavelengths + 2) / 3;
-    double dlambda = (kLambdaMax - kLambdaMin) / (3 * num_iterations);
     for (int i = 0; i < num_iterations; ++i) {
-      vec3 lambdas{
-        kLambdaMin + (3 * i + 0.5) * dlambda,
-        kLambdaMin + (3 * i + 1.5) * dlambda,
-        kLambdaMin + (3 * i + 2.5) * dlambda
-      };
+      const vec3& lambdas = wavelength_groups[i];
       auto coeff = [dlambda](double lambda, int component) {
         // Note that we don't include MAX_LUMINOUS_EFFICACY here, to avoid
         // artefacts due to too large values when using half precision on GPU.
@@ -893,36 +1016,49 @@ void Model1::Init(unsigned int num_scattering_orders) {
         coeff(lambdas[0], 1), coeff(lambdas[1], 1), coeff(lambdas[2], 1),
         coeff(lambdas[0], 2), coeff(lambdas[1], 2), coeff(lambdas[2], 2)
       };
+      GpuProfilerScope wavelengths_scope(
+          profiler, "wavelengths " + std::to_string(3 * i + 1) + "-" +
+              std::to_string(3 * i + 3));
       Precompute(fbo, delta_irradiance_texture,
           delta_rayleigh_scattering_texture, delta_mie_scattering_texture,
           delta_scattering_density_texture, delta_multiple_scattering_texture,
-          lambdas, luminance_from_radiance, i > 0 /* blend */,
-          num_scattering_orders);
+          *programs[i], luminance_from_radiance, i > 0 /* blend */,
+          num_scattering_orders, layer_exchange, profiler);
     }
 
     // After the above iterations, the transmittance texture contains the
     // transmittance for the 3 wavelengths used at the last iteration. But we
     // want the transmittance at kLambdaR, kLambdaG, kLambdaB instead, so we
     // must recompute it here for these 3 wavelengths:
-    std::string header = glsl_header_factory_({kLambdaR, kLambdaG, kLambdaB});
-    Program compute_transmittance(
-        kVertexShader, header + kComputeTransmittanceShader);
+    GpuProfilerScope transmittance_scope(profiler, "transmittance");
     glFramebufferTexture(
         GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, transmittanceTexture, 0);
     glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    glViewport(0, 0, TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT);
-    compute_transmittance.Use();
+    glViewport(0, 0, lutResolution.transmittance_width,
+        lutResolution.transmittance_height);
+    compute_final_transmittance->Use();
     DrawQuad({}, fullScreenQuadVAO);
   }
 
-  // Delete the temporary resources allocated at the begining of this method.
+  // Each shard only accumulated its own layers in the final textures.
+  if (layer_exchange != nullptr) {
+    if (optionalSingleMieScatteringTexture != 0) {
+      layer_exchange->Exchange(
+          {scatteringTexture, optionalSingleMieScatteringTexture});
+    } else {
+      layer_exchange->Exchange({scatteringTexture});
+    }
+  }
+
+  // Delete the temporary resources allocated at the begining of this method
+  // (the textures are returned to the pool, for the next precomputations).
   glUseProgram(0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
   glDeleteFramebuffers(1, &fbo);
-  glDeleteTextures(1, &delta_scattering_density_texture);
-  glDeleteTextures(1, &delta_mie_scattering_texture);
-  glDeleteTextures(1, &delta_rayleigh_scattering_texture);
-  glDeleteTextures(1, &delta_irradiance_texture);
+  texturePool->Release(delta_scattering_density_texture);
+  texturePool->Release(delta_mie_scattering_texture);
+  texturePool->Release(delta_rayleigh_scattering_texture);
+  texturePool->Release(delta_irradiance_texture);
   assert(glGetError() == 0);
 }
 
@@ -962,6 +1098,527 @@ void Model1::setProgramUniforms(
   }
 }
 
+/*
+<p>The precomputed textures can also be saved in, and loaded from, a memory
+mappable LUT file (see <code>lut_file.h</code>). Each texture is described by a
+<code>LutEntry</code>, with the sizes of the <code>LutResolution</code> and the
+format chosen in the constructor (or by <code>QuantizeLuts</code>):
+*/
+
+LutEntry Model1::precomputedLutEntry(LutId id) const {
+  LutEntry entry = LutEntry();
+  const bool combined = optionalSingleMieScatteringTexture == 0;
+  switch (id) {
+    case LUT_TRANSMITTANCE:
+      entry.width = lutResolution.transmittance_width;
+      entry.height = lutResolution.transmittance_height;
+      entry.depth = 1;
+      entry.components = 4;
+      entry.bytes_per_component = 4;
+      break;
+    case LUT_SCATTERING:
+      entry.width = lutResolution.scattering_width();
+      entry.height = lutResolution.scattering_height();
+      entry.depth = lutResolution.scattering_depth();
+      entry.components = combined || !rgbFormatSupported ? 4 : 3;
+      entry.bytes_per_component = halfPrecision ? 2 : 4;
+      break;
+    case LUT_SINGLE_MIE_SCATTERING:
+      if (combined) {
+        return entry;
+      }
+      entry.width = lutResolution.scattering_width();
+      entry.height = lutResolution.scattering_height();
+      entry.depth = lutResolution.scattering_depth();
+      entry.components = rgbFormatSupported ? 3 : 4;
+      entry.bytes_per_component = halfPrecision ? 2 : 4;
+      break;
+    case LUT_IRRADIANCE:
+      entry.width = lutResolution.irradiance_width;
+      entry.height = lutResolution.irradiance_height;
+      entry.depth = 1;
+      entry.components = 4;
+      entry.bytes_per_component = 4;
+      break;
+    default:
+      return entry;
+  }
+  entry.size = static_cast<uint64_t>(entry.width) * entry.height *
+      entry.depth * entry.components * entry.bytes_per_component;
+  return entry;
+}
+
+GLuint Model1::lutTexture(LutId id) const {
+  switch (id) {
+    case LUT_TRANSMITTANCE: return transmittanceTexture;
+    case LUT_SCATTERING: return scatteringTexture;
+    case LUT_SINGLE_MIE_SCATTERING: return optionalSingleMieScatteringTexture;
+    case LUT_IRRADIANCE: return irradianceTexture;
+    default: return 0;
+  }
+}
+
+void Model1::SetLutStorage(LutId id, const LutEntry& entry,
+    const void* texels) {
+  GLenum internal_format, format, type;
+  GetLutPixelFormat(entry, &internal_format, &format, &type);
+  // The pooled textures have an immutable format and size, so the texture is
+  // replaced with one in the new format (which is the same texture if the
+  // format and size did not change).
+  GLuint texture = lutTexture(id);
+  texturePool->Release(texture);
+  texture = texturePool->Acquire(GPU_MEMORY_LUT,
+      internal_format, entry.width, entry.height, entry.depth);
+  switch (id) {
+    case LUT_TRANSMITTANCE: transmittanceTexture = texture; break;
+    case LUT_SCATTERING: scatteringTexture = texture; break;
+    case LUT_SINGLE_MIE_SCATTERING:
+      optionalSingleMieScatteringTexture = texture;
+      break;
+    case LUT_IRRADIANCE: irradianceTexture = texture; break;
+    default: break;
+  }
+  lutEntries[id] = entry;
+  lutEntries[id].offset = 0;
+  if (texels == nullptr) {
+    return;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glActiveTexture(GL_TEXTURE0);
+  if (entry.depth > 1) {
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, entry.width, entry.height,
+        entry.depth, format, type, texels);
+  } else {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height,
+        format, type, texels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Model1::RestorePrecomputedLutStorage() {
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutId id = static_cast<LutId>(i);
+    const LutEntry entry = precomputedLutEntry(id);
+    if (entry.size != 0 && !HasSameLutStorage(lutEntries[i], entry)) {
+      SetLutStorage(id, entry, nullptr);
+    }
+  }
+}
+
+/*
+<p>The precomputed textures can then be converted to smaller formats. This
+reads them back from the GPU, in float, selects the smallest candidate format
+within the error budget (see <code>lut_quantization.h</code>), and uploads the
+quantized texels. The candidates depend on the texture: the transmittance is
+in [0,1], and only the combined scattering texture uses its alpha component:
+*/
+
+void Model1::QuantizeLuts(const LutErrorBudget& budget,
+    std::vector<LutQuantizationReport>* reports, JobPool* job_pool) {
+  TRACE_GL_SCOPE("Model1::QuantizeLuts");
+  const bool combined = optionalSingleMieScatteringTexture == 0;
+  std::vector<float> values;
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutId id = static_cast<LutId>(i);
+    const LutEntry entry = lutEntry(id);
+    if (entry.size == 0 || !HasSameLutStorage(entry, precomputedLutEntry(id))) {
+      continue;
+    }
+    std::vector<LutEncoding> candidates;
+    if (id == LUT_TRANSMITTANCE) {
+      candidates = {LUT_ENCODING_RGB16, LUT_ENCODING_RGB16F};
+    } else if (id == LUT_SCATTERING && combined) {
+      candidates = {LUT_ENCODING_RGBA16F};
+    } else {
+      candidates = {LUT_ENCODING_RGB9_E5, LUT_ENCODING_R11F_G11F_B10F,
+          LUT_ENCODING_RGB16F};
+    }
+    // Only the formats smaller than the current one are worth the readback
+    // and the conversions (e.g. not RGBA16F for a half precision texture).
+    const uint64_t texel_count =
+        static_cast<uint64_t>(entry.width) * entry.height * entry.depth;
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+        [&](LutEncoding encoding) {
+          return texel_count * LutEncodingTexelSize(encoding) >= entry.size;
+        }), candidates.end());
+
+    LutQuantizationReport report;
+    report.id = id;
+    report.quantized = false;
+    report.encoding = LUT_ENCODING_RGB16F;
+    report.original_size = entry.size;
+    report.size = entry.size;
+    report.error.max_relative_error = 0.0;
+    report.error.rms_relative_error = 0.0;
+    if (!candidates.empty()) {
+      ReadLut(id, &values);
+      LutEntry source = entry;
+      source.bytes_per_component = 4;
+      source.size = values.size() * sizeof(float);
+      QuantizedLut quantized;
+      if (SelectLutEncoding(source, values.data(), candidates, budget,
+                            &quantized, job_pool)) {
+        SetLutStorage(id, quantized.entry, quantized.texels.data());
+        report.quantized = true;
+        report.encoding = quantized.encoding;
+        report.size = quantized.entry.size;
+        report.error = quantized.error;
+      }
+    }
+    if (reports != nullptr) {
+      reports->push_back(report);
+    }
+  }
+}
+
+bool Model1::ReadLut(LutId id, std::vector<float>* values,
+                     LutEntry* entry) const {
+  const LutEntry current = lutEntry(id);
+  if (current.size == 0) {
+    return false;
+  }
+  const int components = precomputedLutEntry(id).components;
+  values->resize(static_cast<size_t>(current.width) * current.height *
+      current.depth * components);
+  const GLenum target = current.depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(target, lutTexture(id));
+  glGetTexImage(target, 0, components == 4 ? GL_RGBA : GL_RGB, GL_FLOAT,
+      values->data());
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  if (entry != nullptr) {
+    *entry = current;
+  }
+  return true;
+}
+
+uint64_t Model1::LutMemorySize() const {
+  uint64_t size = 0;
+  for (int id = 0; id < LUT_COUNT; ++id) {
+    size += lutEntries[id].size;
+  }
+  return size;
+}
+
+/*
+<p>The parameter hash is simply a 64 bits FNV-1a hash of the GLSL header used
+for the precomputations, which contains all the atmosphere parameters (as well
+as the precomputation functions, so that files saved with a different version
+of these functions are not reused), and of the number of precomputed
+wavelengths:
+*/
+
+uint64_t Model1::ParameterHash() const {
+  const std::string header =
+      glsl_header_factory_({kLambdaR, kLambdaG, kLambdaB}) +
+      std::to_string(numPrecomputedWavelengths);
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : header) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  return hash;
+}
+
+/*
+<p>Saving the textures reads them back from the GPU, in their own format, and
+writes them after the header, each one on a page boundary:
+*/
+
+bool Model1::SaveLuts(const std::string& path) const {
+  TRACE_GL_SCOPE("Model1::SaveLuts");
+  LutFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, LUT_FILE_MAGIC, sizeof(header.magic));
+  header.version = LUT_FILE_VERSION;
+  header.flags = (halfPrecision ? LUT_HALF_PRECISION : 0) |
+      (optionalSingleMieScatteringTexture == 0 ?
+          LUT_COMBINED_SCATTERING_TEXTURES : 0) |
+      (numPrecomputedWavelengths > 3 ? LUT_PRECOMPUTED_ILLUMINANCE : 0);
+  header.parameter_hash = ParameterHash();
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    header.luts[i] = lutEntry(static_cast<LutId>(i));
+    if (header.luts[i].size != 0) {
+      offset = AlignLutOffset(offset);
+      header.luts[i].offset = offset;
+      offset += header.luts[i].size;
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  std::vector<char> texels;
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutEntry& entry = header.luts[i];
+    if (entry.size == 0) {
+      continue;
+    }
+    texels.resize(static_cast<size_t>(entry.size));
+    const GLenum target = entry.depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(target, lutTexture(static_cast<LutId>(i)));
+    GLenum internal_format, format, type;
+    GetLutPixelFormat(entry, &internal_format, &format, &type);
+    glGetTexImage(target, 0, format, type, texels.data());
+    file.seekp(static_cast<std::streamoff>(entry.offset));
+    file.write(texels.data(), texels.size());
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  return static_cast<bool>(file);
+}
+
+/*
+<p>Loading the textures, on the other hand, does not copy them: they are
+uploaded directly from the file mapping (after checking that the file matches
+this model):
+*/
+
+bool Model1::IsCompatible(const LutFileHeader& header) const {
+  const uint32_t flags = (halfPrecision ? LUT_HALF_PRECISION : 0) |
+      (optionalSingleMieScatteringTexture == 0 ?
+          LUT_COMBINED_SCATTERING_TEXTURES : 0) |
+      (numPrecomputedWavelengths > 3 ? LUT_PRECOMPUTED_ILLUMINANCE : 0);
+  if (header.flags != flags || header.parameter_hash != ParameterHash()) {
+    return false;
+  }
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    // The RGB or RGBA choice depends on the GPU which saved the file, but the
+    // upload converts between the two. The texture format can differ, if the
+    // file was quantized, but not the precision of unquantized textures.
+    const LutEntry expected = precomputedLutEntry(static_cast<LutId>(i));
+    const LutEntry& entry = header.luts[i];
+    if ((entry.size == 0) != (expected.size == 0) ||
+        entry.width != expected.width || entry.height != expected.height ||
+        entry.depth != expected.depth) {
+      return false;
+    }
+    if (entry.size != 0 && (!IsValidLutStorage(entry) ||
+        (entry.format == LUT_FORMAT_FLOAT &&
+         entry.bytes_per_component > expected.bytes_per_component))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Model1::InitFromLuts(const LutFile& luts) {
+  TRACE_GL_SCOPE("Model1::InitFromLuts");
+  if (!luts.is_open() || !IsCompatible(luts.header())) {
+    return false;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutView lut = luts.lut(static_cast<LutId>(i));
+    if (lut.empty()) {
+      continue;
+    }
+    const LutEntry& entry = lut.entry();
+    if (!HasSameLutStorage(entry, lutEntries[i])) {
+      SetLutStorage(static_cast<LutId>(i), entry, lut.data());
+      continue;
+    }
+    GLenum internal_format, format, type;
+    GetLutPixelFormat(entry, &internal_format, &format, &type);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glActiveTexture(GL_TEXTURE0);
+    if (entry.depth > 1) {
+      glBindTexture(GL_TEXTURE_3D, lutTexture(static_cast<LutId>(i)));
+      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, entry.width, entry.height,
+          entry.depth, format, type, lut.data());
+    } else {
+      glBindTexture(GL_TEXTURE_2D, lutTexture(static_cast<LutId>(i)));
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height,
+          format, type, lut.data());
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return true;
+}
+
+/*
+<p>Loading a compressed archive decodes all the slices in parallel, while the
+main thread uploads them in order, as soon as each one is available (the
+uploads overlap with the decoding of the next slices):
+*/
+
+bool Model1::InitFromLutArchive(const LutArchive& archive, JobPool* job_pool) {
+  TRACE_GL_SCOPE("Model1::InitFromLutArchive");
+  if (!archive.is_open() || !IsCompatible(archive.header())) {
+    return false;
+  }
+  struct Slice {
+    LutId id;
+    int z;
+    std::future<std::shared_ptr<std::vector<char>>> texels;
+  };
+  std::vector<Slice> slices;
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutId id = static_cast<LutId>(i);
+    const LutEntry& entry = archive.header().luts[i];
+    if (entry.size != 0 && !HasSameLutStorage(entry, lutEntries[i])) {
+      SetLutStorage(id, entry, nullptr);
+    }
+    for (uint32_t z = 0; entry.size != 0 && z < entry.depth; ++z) {
+      Slice slice;
+      slice.id = id;
+      slice.z = static_cast<int>(z);
+      slice.texels = job_pool->Submit<std::shared_ptr<std::vector<char>>>(
+          [&archive, id, z]() {
+            TRACE_SCOPE("decode LUT slice");
+            std::shared_ptr<std::vector<char>> texels =
+                std::make_shared<std::vector<char>>(archive.SliceSize(id));
+            if (!archive.DecodeSlice(id, static_cast<int>(z), texels->data())) {
+              texels.reset();
+            }
+            return texels;
+          });
+      slices.push_back(std::move(slice));
+    }
+  }
+
+  bool success = true;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glActiveTexture(GL_TEXTURE0);
+  for (Slice& slice : slices) {
+    // Wait for every job, even after a failure, since they use 'archive'.
+    std::shared_ptr<std::vector<char>> texels = slice.texels.get();
+    if (!success || !texels) {
+      success = false;
+      continue;
+    }
+    const LutEntry& entry = archive.header().luts[slice.id];
+    GLenum internal_format, format, type;
+    GetLutPixelFormat(entry, &internal_format, &format, &type);
+    if (entry.depth > 1) {
+      glBindTexture(GL_TEXTURE_3D, lutTexture(slice.id));
+      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, slice.z, entry.width,
+          entry.height, 1, format, type, texels->data());
+    } else {
+      glBindTexture(GL_TEXTURE_2D, lutTexture(slice.id));
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height,
+          format, type, texels->data());
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return success;
+}
+
+/*
+<p>Finally, the textures of up to 4 models with the same texture formats can be
+blended into the textures of this model, to approximate the textures of an
+intermediate atmosphere without precomputing them (this is linear in the
+texture values, not in the atmosphere parameters, but is sufficient for
+interactive previews). This uses the following fragment shader, with the above
+geometry shader for the 3D textures:
+*/
+
+namespace {
+
+const char kBlendLutsShader[] = R"(
+    uniform vec4 weights;
+    uniform int layer;
+    layout(location = 0) out vec4 blended;
+    #ifdef TEXTURE_3D
+    uniform sampler3D source0;
+    uniform sampler3D source1;
+    uniform sampler3D source2;
+    uniform sampler3D source3;
+    #define FETCH(source) texelFetch(source, ivec3(gl_FragCoord.xy, layer), 0)
+    #else
+    uniform sampler2D source0;
+    uniform sampler2D source1;
+    uniform sampler2D source2;
+    uniform sampler2D source3;
+    #define FETCH(source) texelFetch(source, ivec2(gl_FragCoord.xy), 0)
+    #endif
+    void main() {
+      blended = weights.x * FETCH(source0) + weights.y * FETCH(source1) +
+          weights.z * FETCH(source2) + weights.w * FETCH(source3);
+    })";
+
+// The blending programs for the 2D and 3D textures, created on first use and
+// then reused by all the models (there is a single OpenGL context). Never
+// deleted, since the context can be destroyed before the static destructors.
+const Program& BlendLutsProgram(bool is_3d) {
+  static const Program* blend_2d = new Program("blend 2d LUTs", kVertexShader,
+      std::string("#version 330\n") + kBlendLutsShader);
+  static const Program* blend_3d = new Program("blend 3d LUTs", kVertexShader,
+      kGeometryShader,
+      std::string("#version 330\n#define TEXTURE_3D\n") + kBlendLutsShader);
+  return is_3d ? *blend_3d : *blend_2d;
+}
+
+}  // anonymous namespace
+
+void Model1::PrepareBlendLuts() {
+  BlendLutsProgram(false);
+}
+
+void Model1::BlendLuts(const std::vector<const Model1*>& models,
+                       const std::vector<double>& weights) {
+  TRACE_GL_SCOPE("Model1::BlendLuts");
+  assert(!models.empty() && models.size() <= 4);
+  assert(models.size() == weights.size());
+  // The quantized formats can't be rendered to.
+  RestorePrecomputedLutStorage();
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLuint fbo;
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const LutId id = static_cast<LutId>(i);
+    const LutEntry entry = lutEntry(id);
+    if (entry.size == 0) {
+      continue;
+    }
+    const bool is_3d = entry.depth > 1;
+    const Program& program = BlendLutsProgram(is_3d);
+    program.Use();
+    // The unused sources get a zero weight.
+    GLfloat source_weights[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (unsigned int j = 0; j < 4; ++j) {
+      const Model1& source = *models[j < models.size() ? j : 0];
+      if (j < weights.size()) {
+        source_weights[j] = static_cast<GLfloat>(weights[j]);
+      }
+      const std::string name = "source" + std::to_string(j);
+      if (is_3d) {
+        program.BindTexture3d(name, source.lutTexture(id), j);
+      } else {
+        program.BindTexture2d(name, source.lutTexture(id), j);
+      }
+    }
+    glUniform4fv(glGetUniformLocation(program.id(), "weights"), 1,
+        source_weights);
+    glFramebufferTexture(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, lutTexture(id), 0);
+    glViewport(0, 0, entry.width, entry.height);
+    for (uint32_t layer = 0; layer < entry.depth; ++layer) {
+      program.BindInt("layer", layer);
+      DrawQuad({}, fullScreenQuadVAO);
+    }
+  }
+  glUseProgram(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &fbo);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
 /*
 <p>The utility method <code>ConvertSpectrumToLinearSrgb</code> is implemented
 with a simple numerical integration of the given function, times the CIE color
@@ -1003,26 +1660,23 @@ void Model1::Precompute(
     GLuint delta_mie_scattering_texture,
     GLuint delta_scattering_density_texture,
     GLuint delta_multiple_scattering_texture,
-    const vec3& lambdas,
+    const PrecomputePrograms& programs,
     const mat3& luminance_from_radiance,
     bool blend,
-    unsigned int num_scattering_orders) {
-  // The precomputations require specific GLSL programs, for each precomputation
-  // step. We create and compile them here (they are automatically destroyed
-  // when this method returns, via the Program destructor).
-  std::string header = glsl_header_factory_(lambdas);
-  Program compute_transmittance(
-      kVertexShader, header + kComputeTransmittanceShader);
-  Program compute_direct_irradiance(
-      kVertexShader, header + kComputeDirectIrradianceShader);
-  Program compute_single_scattering(kVertexShader, kGeometryShader,
-      header + kComputeSingleScatteringShader);
-  Program compute_scattering_density(kVertexShader, kGeometryShader,
-      header + kComputeScatteringDensityShader);
-  Program compute_indirect_irradiance(
-      kVertexShader, header + kComputeIndirectIrradianceShader);
-  Program compute_multiple_scattering(kVertexShader, kGeometryShader,
-      header + kComputeMultipleScatteringShader);
+    unsigned int num_scattering_orders,
+    LayerExchange* layer_exchange,
+    GpuProfiler* profiler) {
+  // The GLSL programs of each precomputation step, for the wavelengths to
+  // precompute (their compilation is submitted in Init).
+  const Program& compute_transmittance = programs.compute_transmittance;
+  const Program& compute_direct_irradiance = programs.compute_direct_irradiance;
+  const Program& compute_single_scattering = programs.compute_single_scattering;
+  const Program& compute_scattering_density =
+      programs.compute_scattering_density;
+  const Program& compute_indirect_irradiance =
+      programs.compute_indirect_irradiance;
+  const Program& compute_multiple_scattering =
+      programs.compute_multiple_scattering;
 
   const GLuint kDrawBuffers[4] = {
     GL_COLOR_ATTACHMENT0,
@@ -1033,11 +1687,20 @@ void Model1::Precompute(
   glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
   glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ONE);
 
+  // The layers of the 3D textures computed here (all of them, unless the
+  // precomputation is sharded).
+  const unsigned int layer_begin =
+      layer_exchange != nullptr ? layer_exchange->layer_begin() : 0;
+  const unsigned int layer_end = layer_exchange != nullptr ?
+      layer_exchange->layer_end() : lutResolution.scattering_depth();
+
   // Compute the transmittance, and store it in transmittanceTexture.
+  GpuProfilerScope stage_scope(profiler, "transmittance");
   glFramebufferTexture(
       GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, transmittanceTexture, 0);
   glDrawBuffer(GL_COLOR_ATTACHMENT0);
-  glViewport(0, 0, TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT);
+  glViewport(0, 0, lutResolution.transmittance_width,
+      lutResolution.transmittance_height);
   compute_transmittance.Use();
   DrawQuad({}, fullScreenQuadVAO);
 
@@ -1045,12 +1708,14 @@ void Model1::Precompute(
   // depending on 'blend', either initialize irradianceTexture with zeros or
   // leave it unchanged (we don't want the direct irradiance in
   // irradianceTexture, but only the irradiance from the sky).
+  stage_scope.Next("direct irradiance");
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
       delta_irradiance_texture, 0);
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
       irradianceTexture, 0);
   glDrawBuffers(2, kDrawBuffers);
-  glViewport(0, 0, IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
+  glViewport(0, 0, lutResolution.irradiance_width,
+      lutResolution.irradiance_height);
   compute_direct_irradiance.Use();
   compute_direct_irradiance.BindTexture2d(
       "transmittance_texture", transmittanceTexture, 0);
@@ -1060,6 +1725,7 @@ void Model1::Precompute(
   // delta_rayleigh_scattering_texture and delta_mie_scattering_texture, and
   // either store them or accumulate them in scatteringTexture and
   // optionalSingleMieScatteringTexture.
+  stage_scope.Next("single scattering");
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
       delta_rayleigh_scattering_texture, 0);
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
@@ -1073,30 +1739,40 @@ void Model1::Precompute(
   } else {
     glDrawBuffers(3, kDrawBuffers);
   }
-  glViewport(0, 0, SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT);
+  glViewport(0, 0, lutResolution.scattering_width(),
+      lutResolution.scattering_height());
   compute_single_scattering.Use();
   compute_single_scattering.BindMat3(
       "luminance_from_radiance", luminance_from_radiance);
   compute_single_scattering.BindTexture2d(
       "transmittance_texture", transmittanceTexture, 0);
-  for (unsigned int layer = 0; layer < SCATTERING_TEXTURE_DEPTH; ++layer) {
+  for (unsigned int layer = layer_begin; layer < layer_end; ++layer) {
     compute_single_scattering.BindInt("layer", layer);
     DrawQuad({false, false, blend, blend}, fullScreenQuadVAO);
   }
+  if (layer_exchange != nullptr) {
+    layer_exchange->Exchange(
+        {delta_rayleigh_scattering_texture, delta_mie_scattering_texture});
+  }
 
   // Compute the 2nd, 3rd and 4th order of scattering, in sequence.
+  stage_scope.Next("multiple scattering");
   for (unsigned int scattering_order = 2;
        scattering_order <= num_scattering_orders;
        ++scattering_order) {
+    GpuProfilerScope order_scope(
+        profiler, "order " + std::to_string(scattering_order));
     // Compute the scattering density, and store it in
     // delta_scattering_density_texture.
+    GpuProfilerScope order_stage_scope(profiler, "scattering density");
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
         delta_scattering_density_texture, 0);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, 0, 0);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, 0, 0);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, 0, 0);
     glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    glViewport(0, 0, SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT);
+    glViewport(0, 0, lutResolution.scattering_width(),
+        lutResolution.scattering_height());
     compute_scattering_density.Use();
     compute_scattering_density.BindTexture2d(
         "transmittance_texture", transmittanceTexture, 0);
@@ -1111,19 +1787,24 @@ void Model1::Precompute(
     compute_scattering_density.BindTexture2d(
         "irradiance_texture", delta_irradiance_texture, 4);
     compute_scattering_density.BindInt("scattering_order", scattering_order);
-    for (unsigned int layer = 0; layer < SCATTERING_TEXTURE_DEPTH; ++layer) {
+    for (unsigned int layer = layer_begin; layer < layer_end; ++layer) {
       compute_scattering_density.BindInt("layer", layer);
       DrawQuad({}, fullScreenQuadVAO);
     }
+    if (layer_exchange != nullptr) {
+      layer_exchange->Exchange({delta_scattering_density_texture});
+    }
 
     // Compute the indirect irradiance, store it in delta_irradiance_texture and
     // accumulate it in irradianceTexture.
+    order_stage_scope.Next("indirect irradiance");
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
         delta_irradiance_texture, 0);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
         irradianceTexture, 0);
     glDrawBuffers(2, kDrawBuffers);
-    glViewport(0, 0, IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
+    glViewport(0, 0, lutResolution.irradiance_width,
+        lutResolution.irradiance_height);
     compute_indirect_irradiance.Use();
     compute_indirect_irradiance.BindMat3(
         "luminance_from_radiance", luminance_from_radiance);
@@ -1142,12 +1823,14 @@ void Model1::Precompute(
     // Compute the multiple scattering, store it in
     // delta_multiple_scattering_texture, and accumulate it in
     // scatteringTexture.
+    order_stage_scope.Next("multiple scattering");
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
         delta_multiple_scattering_texture, 0);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
         scatteringTexture, 0);
     glDrawBuffers(2, kDrawBuffers);
-    glViewport(0, 0, SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT);
+    glViewport(0, 0, lutResolution.scattering_width(),
+        lutResolution.scattering_height());
     compute_multiple_scattering.Use();
     compute_multiple_scattering.BindMat3(
         "luminance_from_radiance", luminance_from_radiance);
@@ -1155,10 +1838,15 @@ void Model1::Precompute(
         "transmittance_texture", transmittanceTexture, 0);
     compute_multiple_scattering.BindTexture3d(
         "scattering_density_texture", delta_scattering_density_texture, 1);
-    for (unsigned int layer = 0; layer < SCATTERING_TEXTURE_DEPTH; ++layer) {
+    for (unsigned int layer = layer_begin; layer < layer_end; ++layer) {
       compute_multiple_scattering.BindInt("layer", layer);
       DrawQuad({false, true}, fullScreenQuadVAO);
     }
+    // The last order is not used by any other pass.
+    if (layer_exchange != nullptr &&
+        scattering_order < num_scattering_orders) {
+      layer_exchange->Exchange({delta_multiple_scattering_texture});
+    }
   }
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, 0, 0);
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, 0, 0);
@@ -129,11 +129,40 @@ along the specified segment at the 3 wavelengths <code>kLambdaR</code>,
 
 #include <glad/glad.h>
 #include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
-
+#include "lut_archive.h"
+#include "lut_file.h"
+#include "lut_quantization.h"
+#include "lut_resolution.h"
+#include "sample_counts.h"
+#include "texture_pool.h"
+
+class GpuProfiler;
+class JobPool;
+
+// Splits the precomputation of the 3D textures between several shards (e.g.
+// processes, each with its own OpenGL context), each one computing a range of
+// layers (i.e. of r values), while the cheap 2D textures are computed by all
+// the shards. Since each scattering order uses all the layers of the previous
+// one, the shards exchange the layers they computed after each 3D pass.
+class LayerExchange {
+ public:
+  virtual ~LayerExchange() {}
+  // The layers computed by this shard, in [0, depth], where depth is the
+  // scattering_depth() of the model's LutResolution.
+  virtual unsigned int layer_begin() const = 0;
+  virtual unsigned int layer_end() const = 0;
+  // Replaces the layers outside [layer_begin, layer_end) of the given 3D
+  // textures (of scattering_width() x height() x depth() texels) with those
+  // computed by the other shards. All the shards call this at the same points
+  // of the precomputation, with the same number of textures.
+  virtual void Exchange(const std::vector<GLuint>& textures) = 0;
+};
 
 // An atmosphere layer of width 'width' (in m), and whose density is defined as
 //   'expTerm' * exp('expScale' * h) + 'linearTerm' * h + 'constantTerm',
@@ -256,13 +285,76 @@ class Model1 {
     // Whether to use half precision floats (16 bits) or single precision floats
     // (32 bits) for the precomputed textures. Half precision is sufficient for
     // most cases, except for very high exposure values.
-    bool halfPrecision);
+    bool halfPrecision,
+    // The sizes of the precomputed textures (see lut_resolution.h). Larger
+    // textures are more accurate, but use more memory, and take longer to
+    // precompute.
+    const LutResolution& resolution = LutResolution(),
+    // The number of samples of the numerical integrations (see
+    // sample_counts.h). More samples are more accurate, but take longer to
+    // precompute.
+    const SampleCounts& sampleCounts = SampleCounts(),
+    // The pool from which the precomputed and temporary textures are borrowed
+    // (see texture_pool.h), which must outlive the model. If null, the model
+    // uses a pool of its own.
+    TexturePool* texturePool = nullptr);
 
   ~Model1();
 
-  void Init(unsigned int num_scattering_orders = 4);
+  // Precomputes the textures. With a 'layer_exchange', only computes the
+  // layers of this shard, and gets the others from the other shards. With a
+  // 'profiler', measures the GPU time of each precomputation stage, and of
+  // each scattering order, in the current profiler frame.
+  void Init(unsigned int num_scattering_orders = 4,
+            LayerExchange* layer_exchange = nullptr,
+            GpuProfiler* profiler = nullptr);
+
+  // Alternative to Init, which loads the precomputed textures from a LUT file
+  // saved with SaveLuts, for the same atmosphere parameters and texture
+  // formats. The texels are uploaded directly from the file mapping. Returns
+  // false (leaving the textures uninitialized) if the file does not match this
+  // model.
+  bool InitFromLuts(const LutFile& luts);
+  // Same as InitFromLuts, for a compressed LUT archive. The slices are decoded
+  // in parallel on 'job_pool', and uploaded as soon as they are decoded.
+  bool InitFromLutArchive(const LutArchive& archive, JobPool* job_pool);
+  // Converts each precomputed texture to the smallest format within 'budget'
+  // (see lut_quantization.h), after Init. The quantized textures can be used
+  // and saved like the others, but not precomputed again (Init and BlendLuts
+  // first restore the precomputed formats). Appends a report per texture to
+  // 'reports', if not null. The candidate formats are tried in parallel on
+  // 'job_pool', if not null (only those smaller than the precomputed format
+  // are tried, and the textures without any are not read back).
+  void QuantizeLuts(const LutErrorBudget& budget,
+                    std::vector<LutQuantizationReport>* reports = nullptr,
+                    JobPool* job_pool = nullptr);
+  // Reads back a precomputed texture in float, with as many components per
+  // texel as its precomputed format (even if it was quantized since), and
+  // returns its current format in 'entry', if not null. Returns false if the
+  // texture does not exist (e.g. the single Mie scattering texture, with
+  // combined textures).
+  bool ReadLut(LutId id, std::vector<float>* values,
+               LutEntry* entry = nullptr) const;
+  // Saves the precomputed textures in a LUT file. Returns false on failure.
+  bool SaveLuts(const std::string& path) const;
+  // A hash of all the parameters which affect the precomputed textures.
+  uint64_t ParameterHash() const;
+  // The size, in bytes, of the precomputed textures in their current formats
+  // (without the mipmaps and padding the driver might add).
+  uint64_t LutMemorySize() const;
+  // Replaces the precomputed textures with the weighted sum of those of the
+  // given models (at most 4, with the same texture sizes and layout as this
+  // model, but possibly quantized).
+  // The weights should sum to 1.
+  void BlendLuts(const std::vector<const Model1*>& models,
+                 const std::vector<double>& weights);
+  // Submits the compilation of the BlendLuts shaders, so that they are ready
+  // (or being compiled by the driver) at the first BlendLuts call. Optional.
+  static void PrepareBlendLuts();
 
   GLuint shader() const { return atmosphereShader; }
+  const LutResolution& resolution() const { return lutResolution; }
+  const SampleCounts& sampleCounts() const { return integrationSampleCounts; }
 
  void setProgramUniforms(
       GLuint program,
@@ -289,6 +381,9 @@ class Model1 {
   typedef std::array<double, 3> vec3;
   typedef std::array<float, 9> mat3;
 
+  // The GLSL programs of the precomputations, for 3 wavelengths.
+  struct PrecomputePrograms;
+
   void Precompute(
       GLuint fbo,
       GLuint deltaIrradianceTexture,
@@ -296,19 +391,37 @@ class Model1 {
       GLuint deltaMieScatteringTexture,
       GLuint deltaScatteringDensityTexture,
       GLuint deltaMultipleScatteringTexture,
-      const vec3& lambdas,
+      const PrecomputePrograms& programs,
       const mat3& luminanceFromRadiance,
       bool blend,
-      unsigned int numScatteringOrders);
+      unsigned int numScatteringOrders,
+      LayerExchange* layerExchange,
+      GpuProfiler* profiler);
+
+  // The format of the textures used by the precomputations, and their
+  // current format.
+  LutEntry precomputedLutEntry(LutId id) const;
+  LutEntry lutEntry(LutId id) const { return lutEntries[id]; }
+  bool IsCompatible(const LutFileHeader& header) const;
+  GLuint lutTexture(LutId id) const;
+  // Reallocates a texture in the given format, with the given texels (or
+  // uninitialized if null).
+  void SetLutStorage(LutId id, const LutEntry& entry, const void* texels);
+  void RestorePrecomputedLutStorage();
 
   unsigned int numPrecomputedWavelengths;
   bool halfPrecision;
+  LutResolution lutResolution;
+  SampleCounts integrationSampleCounts;
+  std::unique_ptr<TexturePool> ownedTexturePool;
+  TexturePool* texturePool;
   bool rgbFormatSupported;
   std::function<std::string(const vec3&)> glsl_header_factory_;
   GLuint transmittanceTexture;
   GLuint scatteringTexture;
   GLuint optionalSingleMieScatteringTexture;
   GLuint irradianceTexture;
+  LutEntry lutEntries[LUT_COUNT];
   GLuint atmosphereShader;
   GLuint fullScreenQuadVAO;
   GLuint fullScreenQuadVBO;
@@ -0,0 +1,29 @@
+#include "sample_counts.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+int Scale(int count, double factor, int multiple) {
+  const int scaled = static_cast<int>(std::lround(count * factor / multiple));
+  return std::max(scaled, 1) * multiple;
+}
+
+}  // anonymous namespace
+
+bool SampleCounts::IsValid() const {
+  return transmittance > 0 && single_scattering > 0 &&
+      multiple_scattering > 0 && scattering_density > 0 &&
+      indirect_irradiance > 0 && indirect_irradiance % 2 == 0;
+}
+
+SampleCounts ScaleSampleCounts(const SampleCounts& counts, double factor) {
+  SampleCounts result;
+  result.transmittance = Scale(counts.transmittance, factor, 1);
+  result.single_scattering = Scale(counts.single_scattering, factor, 1);
+  result.multiple_scattering = Scale(counts.multiple_scattering, factor, 1);
+  result.scattering_density = Scale(counts.scattering_density, factor, 1);
+  result.indirect_irradiance = Scale(counts.indirect_irradiance, factor, 2);
+  return result;
+}
@@ -0,0 +1,31 @@
+#ifndef ATMOSPHERE_SAMPLE_COUNTS_H_
+#define ATMOSPHERE_SAMPLE_COUNTS_H_
+
+// The number of samples of the numerical integrations of the precomputations
+// of a Model1 (see functions.glsl). They are compiled into its shaders, like
+// the texture sizes, so that each model can trade precomputation time for
+// accuracy. The default values are those of the original implementation.
+struct SampleCounts {
+  // Along the view ray, for the optical length to the top of the atmosphere.
+  int transmittance = 500;
+  // Along the view ray, for the single and multiple scattering.
+  int single_scattering = 50;
+  int multiple_scattering = 50;
+  // For the scattering density, the number of zenith angles (the number of
+  // azimuth angles is twice this number).
+  int scattering_density = 16;
+  // For the indirect irradiance, twice the number of zenith angles of the
+  // upper hemisphere (the number of azimuth angles is twice this number).
+  // Must be even.
+  int indirect_irradiance = 32;
+
+  // Whether all the counts are positive, and the indirect irradiance count is
+  // even.
+  bool IsValid() const;
+};
+
+// Returns 'counts' with each count multiplied by 'factor' (rounded, and kept
+// valid).
+SampleCounts ScaleSampleCounts(const SampleCounts& counts, double factor);
+
+#endif  // ATMOSPHERE_SAMPLE_COUNTS_H_
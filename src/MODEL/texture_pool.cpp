@@ -0,0 +1,85 @@
+#include "texture_pool.h"
+
+#include <cassert>
+
+TexturePool::TexturePool()
+    : immutable_storage_(GLAD_GL_VERSION_4_2 != 0 && glTexStorage2D != nullptr &&
+                         glTexStorage3D != nullptr),
+      allocation_count_(0),
+      reuse_count_(0) {}
+
+TexturePool::~TexturePool() {
+  // The borrowers must release their textures before the pool is deleted.
+  assert(acquired_textures_.empty());
+  Clear();
+}
+
+GLuint TexturePool::Acquire(GpuMemoryCategory category,
+                            GLenum internal_format, int width, int height,
+                            int depth) {
+  const Key key(internal_format, width, height, depth);
+  auto it = free_textures_.find(key);
+  if (it != free_textures_.end()) {
+    const GLuint texture = it->second;
+    free_textures_.erase(it);
+    acquired_textures_[texture] = key;
+    SetGpuTextureCategory(texture, category);
+    ++reuse_count_;
+    return texture;
+  }
+
+  const GLenum target = depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(target, texture);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+  if (immutable_storage_) {
+    if (depth > 1) {
+      glTexStorage3D(target, 1, internal_format, width, height, depth);
+    } else {
+      glTexStorage2D(target, 1, internal_format, width, height);
+    }
+  } else {
+    // The format and type of the (null) source texels only need to be valid
+    // for the internal format.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (depth > 1) {
+      glTexImage3D(target, 0, internal_format, width, height, depth, 0,
+                   GL_RGBA, GL_FLOAT, nullptr);
+    } else {
+      glTexImage2D(target, 0, internal_format, width, height, 0, GL_RGBA,
+                   GL_FLOAT, nullptr);
+    }
+  }
+  if (depth > 1) {
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  }
+  acquired_textures_[texture] = key;
+  TrackGpuTexture(texture, category,
+                  GlTextureBytes(internal_format, width, height, depth));
+  ++allocation_count_;
+  return texture;
+}
+
+void TexturePool::Release(GLuint texture) {
+  auto it = acquired_textures_.find(texture);
+  assert(it != acquired_textures_.end());
+  if (it == acquired_textures_.end()) {
+    return;
+  }
+  free_textures_.emplace(it->second, texture);
+  acquired_textures_.erase(it);
+  SetGpuTextureCategory(texture, GPU_MEMORY_POOLED);
+}
+
+void TexturePool::Clear() {
+  for (const auto& entry : free_textures_) {
+    DeleteGpuTextures(1, &entry.second);
+  }
+  free_textures_.clear();
+}
@@ -0,0 +1,60 @@
+#ifndef ATMOSPHERE_TEXTURE_POOL_H_
+#define ATMOSPHERE_TEXTURE_POOL_H_
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+#include "RENDER/gpu_memory_tracker.h"
+
+// A pool of 2D and 3D textures, keyed by format and size, from which Model1
+// borrows its precomputed and temporary textures. A texture returned to the
+// pool is reused by the next request with the same format and size, instead
+// of being deleted, so that rebuilding a model with the same texture sizes
+// allocates no GPU memory (provided the old model is deleted first).
+//
+// The textures have a single mipmap level, linear filtering, and clamp to
+// edge wrapping. They use immutable storage (glTexStorage) when the context
+// supports OpenGL 4.2, and glTexImage otherwise. In both cases their format
+// and size must not be changed by the borrowers: a texture in another format
+// must be acquired instead.
+//
+// The textures are accounted in the GPU memory tracker (see
+// gpu_memory_tracker.h), in the category given by their borrower while they
+// are acquired, and in GPU_MEMORY_POOLED while they are in the pool.
+class TexturePool {
+ public:
+  TexturePool();
+  TexturePool(TexturePool const&) = delete;
+  ~TexturePool();
+
+  // Returns a texture with uninitialized texels, for the GL_TEXTURE_2D (if
+  // 'depth' is 1) or GL_TEXTURE_3D target, accounted in 'category'.
+  GLuint Acquire(GpuMemoryCategory category, GLenum internal_format, int width,
+                 int height, int depth = 1);
+  // Returns a texture obtained with Acquire to the pool.
+  void Release(GLuint texture);
+  // Deletes the textures which are in the pool (e.g. after the texture sizes
+  // changed, since they won't be reused).
+  void Clear();
+
+  // The number of Acquire calls which allocated a new texture, and which
+  // reused a texture from the pool.
+  uint64_t allocation_count() const { return allocation_count_; }
+  uint64_t reuse_count() const { return reuse_count_; }
+
+ private:
+  // The internal format, width, height and depth of a texture.
+  typedef std::tuple<GLenum, int, int, int> Key;
+
+  bool immutable_storage_;
+  // The textures in the pool, and the textures lent out.
+  std::multimap<Key, GLuint> free_textures_;
+  std::map<GLuint, Key> acquired_textures_;
+  uint64_t allocation_count_;
+  uint64_t reuse_count_;
+};
+
+#endif  // ATMOSPHERE_TEXTURE_POOL_H_
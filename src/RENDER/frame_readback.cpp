@@ -0,0 +1,129 @@
+#include "frame_readback.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "CORE/job_pool.h"
+#include "CORE/trace.h"
+#include "RENDER/gpu_memory_tracker.h"
+
+namespace {
+
+// Timeout of each glClientWaitSync call when a transfer must complete (the
+// wait is retried until it does).
+constexpr GLuint64 kFenceTimeoutNanoseconds = 100000000;
+
+}  // anonymous namespace
+
+FrameReadback::FrameReadback(int buffer_count, JobPool* encoder_pool,
+                             int max_pending_encodings)
+    : buffers_(buffer_count), oldest_(0), pending_(0),
+      encoder_pool_(encoder_pool),
+      max_pending_encodings_(std::max(max_pending_encodings, 1)),
+      success_(true) {
+  for (Buffer& buffer : buffers_) {
+    glGenBuffers(1, &buffer.buffer);
+    buffer.capacity = 0;
+    buffer.size = 0;
+    buffer.fence = 0;
+  }
+}
+
+FrameReadback::~FrameReadback() {
+  Finish();
+  for (Buffer& buffer : buffers_) {
+    DeleteGpuBuffers(1, &buffer.buffer);
+  }
+}
+
+void FrameReadback::Read(GLuint framebuffer, int width, int height,
+                         GLenum format, GLenum type, int pixel_size,
+                         Encoder encode) {
+  // Recycle the oldest buffer if all of them are in use.
+  if (pending_ == static_cast<int>(buffers_.size())) {
+    CompleteOldest(true /* wait */);
+  }
+  Buffer& buffer = buffers_[(oldest_ + pending_) % buffers_.size()];
+  buffer.size = static_cast<size_t>(width) * height * pixel_size;
+  buffer.encode = std::move(encode);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer);
+  if (buffer.capacity < buffer.size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, buffer.size, nullptr, GL_STREAM_READ);
+    TrackGpuBuffer(buffer.buffer, GPU_MEMORY_SCENE, buffer.size);
+    buffer.capacity = buffer.size;
+  }
+  GLint previous_framebuffer;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, format, type, nullptr);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  ++pending_;
+
+  // Hand over the frames whose transfer already completed.
+  while (pending_ > 0 && CompleteOldest(false /* wait */)) {
+  }
+}
+
+bool FrameReadback::Finish() {
+  while (pending_ > 0) {
+    CompleteOldest(true /* wait */);
+  }
+  WaitForEncodings(0);
+  const bool success = success_;
+  success_ = true;
+  return success;
+}
+
+bool FrameReadback::CompleteOldest(bool wait) {
+  Buffer& buffer = buffers_[oldest_];
+  GLenum status = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   wait ? kFenceTimeoutNanoseconds : 0);
+  while (wait && status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(buffer.fence, 0, kFenceTimeoutNanoseconds);
+  }
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+  glDeleteSync(buffer.fence);
+  buffer.fence = 0;
+
+  std::shared_ptr<std::vector<unsigned char>> pixels =
+      std::make_shared<std::vector<unsigned char>>(buffer.size);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer);
+  const void* data = status == GL_WAIT_FAILED ? nullptr :
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, buffer.size, GL_MAP_READ_BIT);
+  if (data != nullptr) {
+    std::memcpy(pixels->data(), data, buffer.size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  Encoder encode = std::move(buffer.encode);
+  oldest_ = (oldest_ + 1) % buffers_.size();
+  --pending_;
+  if (data == nullptr) {
+    success_ = false;
+    return true;
+  }
+
+  WaitForEncodings(max_pending_encodings_ - 1);
+  encodings_.push_back(encoder_pool_->Submit<bool>([pixels, encode]() {
+    TRACE_SCOPE("encode frame");
+    return encode(*pixels);
+  }));
+  return true;
+}
+
+void FrameReadback::WaitForEncodings(size_t max_pending) {
+  while (encodings_.size() > max_pending) {
+    if (!encodings_.front().get()) {
+      success_ = false;
+    }
+    encodings_.pop_front();
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef RENDER_FRAME_READBACK_H_
+#define RENDER_FRAME_READBACK_H_
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
+
+class JobPool;
+
+// Reads back rendered frames without stalling the rendering, through a ring of
+// pixel pack buffers. glReadPixels into a buffer only queues the transfer, and
+// a fence marks its completion; the buffer is mapped once the fence is
+// signaled (checked after each read, without waiting), or when the buffer is
+// needed again, typically a few frames later. The mapped pixels are copied
+// and handed to an encoder running on a JobPool, so that the rendering, the
+// transfers and the encoding of successive frames all overlap.
+class FrameReadback {
+ public:
+  // Encodes the pixels of a frame (e.g. into a file), on a JobPool thread.
+  // Returns false on failure.
+  typedef std::function<bool(const std::vector<unsigned char>& pixels)>
+      Encoder;
+
+  // 'max_pending_encodings' bounds the memory used by the frames waiting
+  // for an encoder (the rendering waits for the encoders beyond this).
+  FrameReadback(int buffer_count, JobPool* encoder_pool,
+                int max_pending_encodings);
+  FrameReadback(FrameReadback const&) = delete;
+  FrameReadback(FrameReadback&&) = delete;
+  // Waits for the pending readbacks and encodings (see Finish).
+  ~FrameReadback();
+
+  // Starts reading the color attachment 0 of 'framebuffer', with the given
+  // size, pixel format and type, and 'pixel_size' bytes per pixel. The pixels
+  // are passed to 'encode' once available (rows from bottom to top).
+  void Read(GLuint framebuffer, int width, int height, GLenum format,
+            GLenum type, int pixel_size, Encoder encode);
+
+  // Waits for all the readbacks and encodings. Returns false if an encoder
+  // failed since the last call.
+  bool Finish();
+
+ private:
+  struct Buffer {
+    GLuint buffer;
+    size_t capacity;
+    size_t size;
+    GLsync fence;
+    Encoder encode;
+  };
+
+  // Maps the oldest pending buffer (waiting for its transfer if 'wait'), and
+  // queues its encoding. Returns false if the transfer is not complete.
+  bool CompleteOldest(bool wait);
+  void WaitForEncodings(size_t max_pending);
+
+  std::vector<Buffer> buffers_;
+  // Index of the oldest pending buffer, and number of pending buffers.
+  int oldest_;
+  int pending_;
+  JobPool* encoder_pool_;
+  size_t max_pending_encodings_;
+  std::deque<std::future<bool>> encodings_;
+  bool success_;
+};
+
+#endif  // RENDER_FRAME_READBACK_H_
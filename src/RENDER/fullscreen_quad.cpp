@@ -0,0 +1,34 @@
+#include "fullscreen_quad.h"
+
+#include "RENDER/gpu_memory_tracker.h"
+
+FullscreenQuad::FullscreenQuad() {
+  glGenVertexArrays(1, &vao_);
+  glBindVertexArray(vao_);
+  glGenBuffers(1, &vbo_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  const GLfloat vertices[] = {
+    -1.0, -1.0,
+    +1.0, -1.0,
+    -1.0, +1.0,
+    +1.0, +1.0,
+  };
+  glBufferData(GL_ARRAY_BUFFER, sizeof vertices, vertices, GL_STATIC_DRAW);
+  TrackGpuBuffer(vbo_, GPU_MEMORY_SCENE, sizeof vertices);
+  constexpr GLuint kAttribIndex = 0;
+  constexpr int kCoordsPerVertex = 2;
+  glVertexAttribPointer(kAttribIndex, kCoordsPerVertex, GL_FLOAT, false, 0, 0);
+  glEnableVertexAttribArray(kAttribIndex);
+  glBindVertexArray(0);
+}
+
+FullscreenQuad::~FullscreenQuad() {
+  DeleteGpuBuffers(1, &vbo_);
+  glDeleteVertexArrays(1, &vao_);
+}
+
+void FullscreenQuad::Draw() const {
+  glBindVertexArray(vao_);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+}
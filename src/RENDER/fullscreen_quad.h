@@ -0,0 +1,23 @@
+#ifndef RENDER_FULLSCREEN_QUAD_H_
+#define RENDER_FULLSCREEN_QUAD_H_
+
+#include <glad/glad.h>
+
+// A quad covering the whole viewport, drawn as a triangle strip whose vertex
+// attribute 0 is the vec2 clip space position of each corner.
+class FullscreenQuad {
+ public:
+  FullscreenQuad();
+  FullscreenQuad(FullscreenQuad const&) = delete;
+  FullscreenQuad(FullscreenQuad&&) = delete;
+  ~FullscreenQuad();
+
+  // Draws the quad with the current program.
+  void Draw() const;
+
+ private:
+  GLuint vao_;
+  GLuint vbo_;
+};
+
+#endif  // RENDER_FULLSCREEN_QUAD_H_
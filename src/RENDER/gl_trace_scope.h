@@ -0,0 +1,46 @@
+#ifndef RENDER_GL_TRACE_SCOPE_H_
+#define RENDER_GL_TRACE_SCOPE_H_
+
+#include <glad/glad.h>
+
+#include "CORE/trace.h"
+
+// Pushes and pops an OpenGL debug group, so that the OpenGL commands issued
+// in a trace zone are grouped under the same name in GPU captures (e.g. in
+// RenderDoc or Nsight). No-ops without OpenGL 4.3 nor KHR_debug.
+inline void PushGlDebugGroup(const char* name) {
+  if (glPushDebugGroup != nullptr) {
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+  }
+}
+
+inline void PopGlDebugGroup() {
+  if (glPopDebugGroup != nullptr) {
+    glPopDebugGroup();
+  }
+}
+
+// A TraceScope which is also an OpenGL debug group.
+class GlTraceScope {
+ public:
+  explicit GlTraceScope(const char* name) : trace_scope_(name) {
+    PushGlDebugGroup(name);
+  }
+  GlTraceScope(GlTraceScope const&) = delete;
+  ~GlTraceScope() { PopGlDebugGroup(); }
+
+ private:
+  TraceScope trace_scope_;
+};
+
+// Same as TRACE_SCOPE, with an OpenGL debug group of the same name.
+#if ATMOSPHERE_TRACING
+#define TRACE_GL_SCOPE(name) \
+  GlTraceScope TRACE_CONCATENATE(gl_trace_scope_, __LINE__)(name)
+#else
+#define TRACE_GL_SCOPE(name) \
+  do {                       \
+  } while (false)
+#endif
+
+#endif  // RENDER_GL_TRACE_SCOPE_H_
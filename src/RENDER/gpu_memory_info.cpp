@@ -0,0 +1,60 @@
+#include "gpu_memory_info.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+namespace {
+
+// The extensions are not in the glad loader, which only has their names.
+constexpr GLenum kGpuMemoryInfoDedicatedVidmemNvx = 0x9047;
+constexpr GLenum kGpuMemoryInfoCurrentAvailableVidmemNvx = 0x9049;
+constexpr GLenum kTextureFreeMemoryAti = 0x87FC;
+
+enum class MemoryInfoExtension { UNKNOWN, NONE, NVX, ATI };
+
+bool HasExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr && std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+bool QueryGpuMemory(uint64_t* total_bytes, uint64_t* available_bytes) {
+  // The extension list is only read once (there is a single context).
+  static MemoryInfoExtension extension = MemoryInfoExtension::UNKNOWN;
+  if (extension == MemoryInfoExtension::UNKNOWN) {
+    extension = HasExtension("GL_NVX_gpu_memory_info") ?
+        MemoryInfoExtension::NVX :
+        HasExtension("GL_ATI_meminfo") ? MemoryInfoExtension::ATI :
+                                         MemoryInfoExtension::NONE;
+  }
+  // The sizes are in kB.
+  if (extension == MemoryInfoExtension::NVX) {
+    GLint total = 0;
+    GLint available = 0;
+    glGetIntegerv(kGpuMemoryInfoDedicatedVidmemNvx, &total);
+    glGetIntegerv(kGpuMemoryInfoCurrentAvailableVidmemNvx, &available);
+    *total_bytes = static_cast<uint64_t>(total) * 1024;
+    *available_bytes = static_cast<uint64_t>(available) * 1024;
+    return true;
+  }
+  if (extension == MemoryInfoExtension::ATI) {
+    // The free memory of the texture pool, followed by the largest free
+    // block, and the same for the auxiliary (system) memory.
+    GLint free_memory[4] = {0, 0, 0, 0};
+    glGetIntegerv(kTextureFreeMemoryAti, free_memory);
+    *total_bytes = 0;
+    *available_bytes = static_cast<uint64_t>(free_memory[0]) * 1024;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,12 @@
+#ifndef RENDER_GPU_MEMORY_INFO_H_
+#define RENDER_GPU_MEMORY_INFO_H_
+
+#include <cstdint>
+
+// Queries the dedicated video memory size and the currently available video
+// memory, in bytes, with the GL_NVX_gpu_memory_info extension or, for the
+// available memory only (with a 0 total), the GL_ATI_meminfo extension.
+// Returns false if the current context supports neither of them.
+bool QueryGpuMemory(uint64_t* total_bytes, uint64_t* available_bytes);
+
+#endif  // RENDER_GPU_MEMORY_INFO_H_
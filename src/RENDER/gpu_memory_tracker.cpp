@@ -0,0 +1,188 @@
+#include "gpu_memory_tracker.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace {
+
+// The texture and buffer names are in different name spaces.
+enum ObjectType { TEXTURE, BUFFER, OBJECT_TYPE_COUNT };
+
+struct Allocation {
+  GpuMemoryCategory category;
+  uint64_t bytes;
+};
+
+class Tracker {
+ public:
+  void Track(ObjectType type, GLuint name, GpuMemoryCategory category,
+             uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<GLuint, Allocation>* allocations = &allocations_[type];
+    auto it = allocations->find(name);
+    if (it != allocations->end()) {
+      Remove(it->second);
+      it->second = {category, bytes};
+    } else {
+      allocations->emplace(name, Allocation{category, bytes});
+    }
+    Add(category, bytes);
+  }
+
+  void SetCategory(ObjectType type, GLuint name, GpuMemoryCategory category) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = allocations_[type].find(name);
+    if (it == allocations_[type].end() || it->second.category == category) {
+      return;
+    }
+    // Removed first, so that the total peak does not count it twice.
+    Remove(it->second);
+    it->second.category = category;
+    Add(category, it->second.bytes);
+  }
+
+  void Untrack(ObjectType type, GLsizei count, const GLuint* names) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (GLsizei i = 0; i < count; ++i) {
+      auto it = allocations_[type].find(names[i]);
+      if (it != allocations_[type].end()) {
+        Remove(it->second);
+        allocations_[type].erase(it);
+      }
+    }
+  }
+
+  GpuMemoryUsage usage(GpuMemoryCategory category) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return usages_[category];
+  }
+
+  GpuMemoryUsage total_usage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_usage_;
+  }
+
+  void ResetPeaks() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (GpuMemoryUsage& usage : usages_) {
+      usage.peak_bytes = usage.current_bytes;
+    }
+    total_usage_.peak_bytes = total_usage_.current_bytes;
+  }
+
+ private:
+  void Add(GpuMemoryCategory category, uint64_t bytes) {
+    GpuMemoryUsage& usage = usages_[category];
+    usage.current_bytes += bytes;
+    usage.peak_bytes = std::max(usage.peak_bytes, usage.current_bytes);
+    total_usage_.current_bytes += bytes;
+    total_usage_.peak_bytes =
+        std::max(total_usage_.peak_bytes, total_usage_.current_bytes);
+  }
+
+  void Remove(const Allocation& allocation) {
+    usages_[allocation.category].current_bytes -= allocation.bytes;
+    total_usage_.current_bytes -= allocation.bytes;
+  }
+
+  std::mutex mutex_;
+  std::map<GLuint, Allocation> allocations_[OBJECT_TYPE_COUNT];
+  GpuMemoryUsage usages_[GPU_MEMORY_CATEGORY_COUNT];
+  GpuMemoryUsage total_usage_;
+};
+
+// Never deleted, so that the OpenGL objects can still be deleted during the
+// static destruction.
+Tracker& GetTracker() {
+  static Tracker* tracker = new Tracker();
+  return *tracker;
+}
+
+uint64_t BytesPerTexel(GLenum internal_format) {
+  switch (internal_format) {
+    case GL_RED:
+    case GL_R8:
+      return 1;
+    case GL_RG:
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGB:
+    case GL_RGB8:
+    case GL_DEPTH_COMPONENT24:
+      return 3;
+    case GL_RGBA:
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_R32F:
+    case GL_RG16F:
+    case GL_RGB9_E5:
+    case GL_R11F_G11F_B10F:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+      return 4;
+    case GL_RGB16:
+    case GL_RGB16F:
+      return 6;
+    case GL_RGBA16:
+    case GL_RGBA16F:
+    case GL_RG32F:
+      return 8;
+    case GL_RGB32F:
+      return 12;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      // Not used by the application, and at most 16 bytes per texel anyway.
+      return 16;
+  }
+}
+
+}  // anonymous namespace
+
+const char* GpuMemoryCategoryName(GpuMemoryCategory category) {
+  static const char* const kNames[GPU_MEMORY_CATEGORY_COUNT] = {
+      "LUT", "temporary", "pooled", "UI", "scene"};
+  return kNames[category];
+}
+
+GpuMemoryUsage GetGpuMemoryUsage(GpuMemoryCategory category) {
+  return GetTracker().usage(category);
+}
+
+GpuMemoryUsage GetTotalGpuMemoryUsage() {
+  return GetTracker().total_usage();
+}
+
+void ResetGpuMemoryPeaks() { GetTracker().ResetPeaks(); }
+
+uint64_t GlTextureBytes(GLenum internal_format, int width, int height,
+                        int depth) {
+  return BytesPerTexel(internal_format) * static_cast<uint64_t>(width) *
+      height * depth;
+}
+
+void TrackGpuTexture(GLuint texture, GpuMemoryCategory category,
+                     uint64_t bytes) {
+  GetTracker().Track(TEXTURE, texture, category, bytes);
+}
+
+void SetGpuTextureCategory(GLuint texture, GpuMemoryCategory category) {
+  GetTracker().SetCategory(TEXTURE, texture, category);
+}
+
+void DeleteGpuTextures(GLsizei count, const GLuint* textures) {
+  GetTracker().Untrack(TEXTURE, count, textures);
+  glDeleteTextures(count, textures);
+}
+
+void TrackGpuBuffer(GLuint buffer, GpuMemoryCategory category, uint64_t bytes) {
+  GetTracker().Track(BUFFER, buffer, category, bytes);
+}
+
+void DeleteGpuBuffers(GLsizei count, const GLuint* buffers) {
+  GetTracker().Untrack(BUFFER, count, buffers);
+  glDeleteBuffers(count, buffers);
+}
@@ -0,0 +1,75 @@
+#ifndef RENDER_GPU_MEMORY_TRACKER_H_
+#define RENDER_GPU_MEMORY_TRACKER_H_
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Accounts for the GPU memory allocated by the application, by category, so
+// that the memory cost of an atmosphere (including the transient one of its
+// precomputations) can be measured, and budgeted. Unlike QueryGpuMemory (see
+// gpu_memory_info.h), this works with all the drivers, but only counts the
+// texels and buffer data sizes: the driver's padding, mipmaps it allocates
+// on its own, and the memory of the OpenGL objects themselves are not known.
+// The framebuffer objects have no storage of their own (their attachments are
+// textures, accounted as such).
+//
+// The texture and buffer objects are tracked by name, from their storage
+// allocation (TrackGpuTexture, TrackGpuBuffer) to their deletion (with
+// DeleteGpuTextures, DeleteGpuBuffers, instead of glDeleteTextures,
+// glDeleteBuffers). Reallocating the storage of a tracked object (e.g. with
+// glTexImage2D after a resize) must be tracked again. The tracker is shared
+// by all the OpenGL contexts, and can be used from any thread.
+
+enum GpuMemoryCategory {
+  // The precomputed textures of the atmosphere models.
+  GPU_MEMORY_LUT,
+  // The textures and buffers only used during the precomputations.
+  GPU_MEMORY_TEMPORARY,
+  // The free textures of the texture pools, kept for reuse.
+  GPU_MEMORY_POOLED,
+  // The text and user interface textures and buffers.
+  GPU_MEMORY_UI,
+  // The render targets, shadow maps, environment maps, vertex buffers, etc of
+  // the scene rendering.
+  GPU_MEMORY_SCENE,
+  GPU_MEMORY_CATEGORY_COUNT
+};
+
+// "LUT", "temporary", "pooled", "UI" or "scene".
+const char* GpuMemoryCategoryName(GpuMemoryCategory category);
+
+// The current and peak allocated sizes, in bytes. The peak is reset with
+// ResetGpuMemoryPeaks.
+struct GpuMemoryUsage {
+  uint64_t current_bytes = 0;
+  uint64_t peak_bytes = 0;
+};
+
+GpuMemoryUsage GetGpuMemoryUsage(GpuMemoryCategory category);
+// For all the categories (the peak is that of the sum, not the sum of the
+// category peaks).
+GpuMemoryUsage GetTotalGpuMemoryUsage();
+// Sets the peaks to the current sizes, e.g. before a precomputation to
+// measure its own peak.
+void ResetGpuMemoryPeaks();
+
+// The size of a texture level in the given sized (or, for GL_RED, GL_RG,
+// GL_RGB and GL_RGBA, unsized 8 bits) internal format.
+uint64_t GlTextureBytes(GLenum internal_format, int width, int height,
+                        int depth = 1);
+
+// Records that 'texture' now has 'bytes' of storage in 'category' (replacing
+// its previous size and category, if already tracked).
+void TrackGpuTexture(GLuint texture, GpuMemoryCategory category,
+                     uint64_t bytes);
+// Moves a tracked texture to another category, without changing its size.
+void SetGpuTextureCategory(GLuint texture, GpuMemoryCategory category);
+// Untracks and deletes textures (tracked or not).
+void DeleteGpuTextures(GLsizei count, const GLuint* textures);
+
+// Same as above, for buffer objects.
+void TrackGpuBuffer(GLuint buffer, GpuMemoryCategory category, uint64_t bytes);
+void DeleteGpuBuffers(GLsizei count, const GLuint* buffers);
+
+#endif  // RENDER_GPU_MEMORY_TRACKER_H_
@@ -0,0 +1,122 @@
+#include "gpu_profiler.h"
+
+#include <cassert>
+
+constexpr int GpuProfiler::kPoolCount;
+
+GpuProfiler::GpuProfiler() : current_pool_(0), recording_(false) {}
+
+GpuProfiler::~GpuProfiler() {
+  for (QueryPool& pool : pools_) {
+    if (!pool.queries.empty()) {
+      glDeleteQueries(static_cast<GLsizei>(pool.queries.size()),
+                      pool.queries.data());
+    }
+  }
+}
+
+void GpuProfiler::BeginFrame() {
+  assert(!recording_);
+  Poll();
+  const int next_pool = (current_pool_ + 1) % kPoolCount;
+  if (pools_[next_pool].pending) {
+    return;
+  }
+  current_pool_ = next_pool;
+  QueryPool& pool = pools_[current_pool_];
+  pool.used_queries = 0;
+  pool.scopes.clear();
+  open_scopes_.clear();
+  recording_ = true;
+#if ATMOSPHERE_TRACING
+  GLint64 gpu_time_ns = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_time_ns);
+  pool.trace_offset_ns = TraceNanoseconds() - gpu_time_ns;
+#endif
+}
+
+void GpuProfiler::EndFrame() {
+  if (!recording_) {
+    return;
+  }
+  assert(open_scopes_.empty());
+  QueryPool& pool = pools_[current_pool_];
+  pool.pending = !pool.scopes.empty();
+  recording_ = false;
+}
+
+void GpuProfiler::BeginScope(const std::string& name) {
+  if (!recording_) {
+    return;
+  }
+  QueryPool& pool = pools_[current_pool_];
+  Scope scope;
+  scope.name = name;
+  scope.depth = static_cast<int>(open_scopes_.size());
+  scope.begin_query = IssueTimestamp();
+  scope.end_query = scope.begin_query;
+  open_scopes_.push_back(pool.scopes.size());
+  pool.scopes.push_back(scope);
+}
+
+void GpuProfiler::EndScope() {
+  if (!recording_ || open_scopes_.empty()) {
+    return;
+  }
+  QueryPool& pool = pools_[current_pool_];
+  pool.scopes[open_scopes_.back()].end_query = IssueTimestamp();
+  open_scopes_.pop_back();
+}
+
+size_t GpuProfiler::IssueTimestamp() {
+  QueryPool& pool = pools_[current_pool_];
+  if (pool.used_queries == pool.queries.size()) {
+    GLuint query;
+    glGenQueries(1, &query);
+    pool.queries.push_back(query);
+  }
+  glQueryCounter(pool.queries[pool.used_queries], GL_TIMESTAMP);
+  return pool.used_queries++;
+}
+
+bool GpuProfiler::Poll() {
+  bool updated = false;
+  // Oldest pool first. The queries complete in order, so a pool is available
+  // when its last query is.
+  for (int i = 1; i <= kPoolCount; ++i) {
+    QueryPool& pool = pools_[(current_pool_ + i) % kPoolCount];
+    if (!pool.pending) {
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(pool.queries[pool.used_queries - 1],
+                       GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      break;
+    }
+    std::vector<GLuint64> timestamps(pool.used_queries);
+    for (size_t q = 0; q < pool.used_queries; ++q) {
+      glGetQueryObjectui64v(pool.queries[q], GL_QUERY_RESULT, &timestamps[q]);
+    }
+    timings_.clear();
+    for (const Scope& scope : pool.scopes) {
+      GpuTiming timing;
+      timing.name = scope.name;
+      timing.depth = scope.depth;
+      timing.milliseconds =
+          (timestamps[scope.end_query] - timestamps[scope.begin_query]) * 1e-6;
+      timings_.push_back(timing);
+#if ATMOSPHERE_TRACING
+      RecordGpuTraceZone(
+          InternTraceName(scope.name),
+          static_cast<int64_t>(timestamps[scope.begin_query]) +
+              pool.trace_offset_ns,
+          static_cast<int64_t>(timestamps[scope.end_query]) +
+              pool.trace_offset_ns);
+#endif
+    }
+    pool.pending = false;
+    updated = true;
+  }
+  return updated;
+}
@@ -0,0 +1,125 @@
+#ifndef RENDER_GPU_PROFILER_H_
+#define RENDER_GPU_PROFILER_H_
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "RENDER/gl_trace_scope.h"
+
+// The GPU time of a profiled scope.
+struct GpuTiming {
+  std::string name;
+  // 0 for the outermost scopes, 1 for the scopes directly inside them, etc.
+  int depth;
+  double milliseconds;
+};
+
+// Measures the GPU time of nested scopes, with a GL_TIMESTAMP query at the
+// beginning and at the end of each scope (GL_TIME_ELAPSED queries can't be
+// nested). The queries of a frame are read once available, a frame or two
+// later, without waiting for them: the frames alternate between two query
+// pools, and a frame whose pool is still pending is not profiled, instead of
+// stalling the pipeline. A "frame" can be anything with a beginning and an
+// end, e.g. a rendered frame or a precomputation. With ATMOSPHERE_TRACING, the
+// scopes are also recorded as GPU trace zones (see trace.h).
+class GpuProfiler {
+ public:
+  GpuProfiler();
+  GpuProfiler(GpuProfiler const&) = delete;
+  ~GpuProfiler();
+
+  // Starts profiling a new frame (after reading the available results).
+  void BeginFrame();
+  void EndFrame();
+  // The scopes outside BeginFrame and EndFrame, or in a frame which is not
+  // profiled, are ignored.
+  void BeginScope(const std::string& name);
+  void EndScope();
+
+  // Reads the results of the finished frames, if any, without waiting.
+  // Returns true if timings() changed.
+  bool Poll();
+  // The scopes of the last frame with available results, in the order in
+  // which they started.
+  const std::vector<GpuTiming>& timings() const { return timings_; }
+
+ private:
+  struct Scope {
+    std::string name;
+    int depth;
+    size_t begin_query;
+    size_t end_query;
+  };
+  struct QueryPool {
+    std::vector<GLuint> queries;
+    size_t used_queries = 0;
+    std::vector<Scope> scopes;
+    bool pending = false;
+    // The trace clock minus the GPU clock, at the beginning of the frame.
+    int64_t trace_offset_ns = 0;
+  };
+  static constexpr int kPoolCount = 2;
+
+  // Returns the next query of the current pool (allocated if needed), with a
+  // timestamp issued.
+  size_t IssueTimestamp();
+
+  QueryPool pools_[kPoolCount];
+  int current_pool_;
+  bool recording_;
+  // The indices, in the current pool, of the scopes begun but not ended.
+  std::vector<size_t> open_scopes_;
+  std::vector<GpuTiming> timings_;
+};
+
+// Profiles the enclosing C++ scope, if 'profiler' is not null. With
+// ATMOSPHERE_TRACING, also records it as a trace zone and as an OpenGL debug
+// group, even if 'profiler' is null.
+class GpuProfilerScope {
+ public:
+  GpuProfilerScope(GpuProfiler* profiler, const std::string& name)
+      : profiler_(profiler) {
+    Begin(name);
+  }
+  GpuProfilerScope(GpuProfilerScope const&) = delete;
+  ~GpuProfilerScope() { End(); }
+
+  // Ends the current scope and begins a new one, at the same depth (for
+  // sequential stages).
+  void Next(const std::string& name) {
+    End();
+    Begin(name);
+  }
+
+ private:
+  void Begin(const std::string& name) {
+#if ATMOSPHERE_TRACING
+    trace_name_ = InternTraceName(name);
+    trace_begin_ns_ = TraceNanoseconds();
+    PushGlDebugGroup(trace_name_);
+#endif
+    if (profiler_ != nullptr) {
+      profiler_->BeginScope(name);
+    }
+  }
+
+  void End() {
+    if (profiler_ != nullptr) {
+      profiler_->EndScope();
+    }
+#if ATMOSPHERE_TRACING
+    PopGlDebugGroup();
+    RecordTraceZone(trace_name_, trace_begin_ns_, TraceNanoseconds());
+#endif
+  }
+
+  GpuProfiler* profiler_;
+#if ATMOSPHERE_TRACING
+  const char* trace_name_;
+  int64_t trace_begin_ns_;
+#endif
+};
+
+#endif  // RENDER_GPU_PROFILER_H_
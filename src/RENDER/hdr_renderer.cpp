@@ -0,0 +1,318 @@
+#include "hdr_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "RENDER/gpu_memory_tracker.h"
+#include "RENDER/shader_compile.h"
+
+namespace {
+
+// Number of histogram bins, and the log2 luminance range they cover. This
+// range is wide enough for both the radiance and the luminance modes; values
+// outside of it land in the first or last bin.
+constexpr int kHistogramBinCount = 64;
+constexpr float kMinLogLuminance = -16.0f;
+constexpr float kMaxLogLuminance = 20.0f;
+// The scene is sampled on a grid of this size to build the histogram.
+constexpr int kHistogramGridWidth = 128;
+constexpr int kHistogramGridHeight = 72;
+// The darkest and brightest fractions of the samples (e.g. the ground and the
+// sun disc) are ignored when averaging the luminance.
+constexpr float kLowPercentile = 0.1f;
+constexpr float kHighPercentile = 0.95f;
+// The exposed average luminance targeted by the adaptation.
+constexpr float kKeyValue = 0.5f;
+// Speed of the exponential adaptation, in 1/s.
+constexpr float kAdaptationRate = 1.5f;
+
+const char kQuadVertexShader[] = R"(
+    #version 330
+    layout(location = 0) in vec2 vertex;
+    out vec2 texture_coord;
+    void main() {
+      texture_coord = vertex * 0.5 + 0.5;
+      gl_Position = vec4(vertex, 0.0, 1.0);
+    })";
+
+// One point per grid sample, sent to the bin of its luminance.
+const char kHistogramVertexShader[] = R"(
+    #version 330
+    uniform sampler2D hdr_texture;
+    uniform ivec2 grid_size;
+    uniform vec2 log_luminance_range;
+    uniform int bin_count;
+    void main() {
+      ivec2 cell = ivec2(gl_VertexID % grid_size.x, gl_VertexID / grid_size.x);
+      vec3 radiance = textureLod(
+          hdr_texture, (vec2(cell) + 0.5) / vec2(grid_size), 0.0).rgb;
+      float luminance = dot(radiance, vec3(0.2126, 0.7152, 0.0722));
+      float t = (log2(max(luminance, 1e-9)) - log_luminance_range.x) /
+          (log_luminance_range.y - log_luminance_range.x);
+      float bin = clamp(floor(t * float(bin_count)), 0.0, float(bin_count - 1));
+      gl_Position = vec4((bin + 0.5) / float(bin_count) * 2.0 - 1.0, 0.0, 0.0,
+          1.0);
+    })";
+
+const char kHistogramFragmentShader[] = R"(
+    #version 330
+    layout(location = 0) out vec4 count;
+    void main() {
+      count = vec4(1.0);
+    })";
+
+// Computes the (log2) exposure from the histogram, and blends it with the
+// exposure of the previous frame.
+const char kExposureFragmentShader[] = R"(
+    #version 330
+    uniform sampler2D histogram_texture;
+    uniform sampler2D previous_exposure_texture;
+    uniform int bin_count;
+    uniform vec2 log_luminance_range;
+    uniform vec2 percentiles;
+    uniform float key_value;
+    uniform float adaptation;
+    layout(location = 0) out vec4 log_exposure;
+    void main() {
+      float total = 0.0;
+      for (int i = 0; i < bin_count; ++i) {
+        total += texelFetch(histogram_texture, ivec2(i, 0), 0).r;
+      }
+      float low = total * percentiles.x;
+      float high = total * percentiles.y;
+      float seen = 0.0;
+      float sum = 0.0;
+      float weight = 0.0;
+      for (int i = 0; i < bin_count; ++i) {
+        float count = texelFetch(histogram_texture, ivec2(i, 0), 0).r;
+        float inside = clamp(seen + count, low, high) - clamp(seen, low, high);
+        seen += count;
+        sum += inside * mix(log_luminance_range.x, log_luminance_range.y,
+            (float(i) + 0.5) / float(bin_count));
+        weight += inside;
+      }
+      float target = log2(key_value) - (weight > 0.0 ? sum / weight : 0.0);
+      // The previous exposure is ignored when resetting, so that an invalid
+      // value can't propagate.
+      float previous = texelFetch(previous_exposure_texture, ivec2(0), 0).r;
+      log_exposure = vec4(adaptation >= 1.0 ? target :
+          mix(previous, target, adaptation));
+    })";
+
+const char kTonemapFragmentShader[] = R"(
+    #version 330
+    uniform sampler2D hdr_texture;
+    uniform sampler2D exposure_texture;
+    uniform bool use_auto_exposure;
+    uniform float manual_exposure;
+    in vec2 texture_coord;
+    layout(location = 0) out vec4 color;
+    void main() {
+      vec3 radiance = texture(hdr_texture, texture_coord).rgb;
+      float exposure = use_auto_exposure ?
+          exp2(texelFetch(exposure_texture, ivec2(0), 0).r) : manual_exposure;
+      color.rgb = pow(vec3(1.0) - exp(-radiance * exposure), vec3(1.0 / 2.2));
+      color.a = 1.0;
+    })";
+
+GLuint NewFloatTexture(GLenum internal_format, int width, int height,
+                       GLenum filter) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGBA,
+               GL_FLOAT, NULL);
+  TrackGpuTexture(texture, GPU_MEMORY_SCENE,
+                  GlTextureBytes(internal_format, width, height));
+  return texture;
+}
+
+GLuint NewFramebuffer(GLuint texture) {
+  GLuint fbo;
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return fbo;
+}
+
+}  // anonymous namespace
+
+HdrRenderer::HdrRenderer()
+    : width_(0), height_(0), hdr_texture_(0), hdr_fbo_(0),
+      current_exposure_(0), reset_exposure_(true), auto_exposure_(true),
+      manual_exposure_(10.0f), output_framebuffer_(0) {
+  SetupBuffers();
+  SetupPrograms();
+}
+
+HdrRenderer::~HdrRenderer() {
+  glDeleteProgram(tonemap_program_);
+  glDeleteProgram(exposure_program_);
+  glDeleteProgram(histogram_program_);
+  glDeleteVertexArrays(1, &empty_vao_);
+  glDeleteFramebuffers(2, exposure_fbos_);
+  DeleteGpuTextures(2, exposure_textures_);
+  glDeleteFramebuffers(1, &histogram_fbo_);
+  DeleteGpuTextures(1, &histogram_texture_);
+  if (hdr_fbo_ != 0) {
+    glDeleteFramebuffers(1, &hdr_fbo_);
+    DeleteGpuTextures(1, &hdr_texture_);
+  }
+}
+
+void HdrRenderer::SetupBuffers() {
+  histogram_texture_ =
+      NewFloatTexture(GL_R32F, kHistogramBinCount, 1, GL_NEAREST);
+  histogram_fbo_ = NewFramebuffer(histogram_texture_);
+  for (int i = 0; i < 2; ++i) {
+    exposure_textures_[i] = NewFloatTexture(GL_R32F, 1, 1, GL_NEAREST);
+    exposure_fbos_[i] = NewFramebuffer(exposure_textures_[i]);
+    // A log2 exposure of 0 until the first adaptation.
+    glBindFramebuffer(GL_FRAMEBUFFER, exposure_fbos_[i]);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  // The histogram points have no attributes, but the core profile still
+  // requires a vertex array object to draw them.
+  glGenVertexArrays(1, &empty_vao_);
+}
+
+void HdrRenderer::SetupPrograms() {
+  PendingProgram histogram_program = SubmitProgram("histogram program",
+      kHistogramVertexShader, kHistogramFragmentShader);
+  PendingProgram exposure_program = SubmitProgram("exposure program",
+      kQuadVertexShader, kExposureFragmentShader);
+  PendingProgram tonemap_program = SubmitProgram("tonemap program",
+      kQuadVertexShader, kTonemapFragmentShader);
+  histogram_program_ = FinishProgram(&histogram_program);
+  exposure_program_ = FinishProgram(&exposure_program);
+  tonemap_program_ = FinishProgram(&tonemap_program);
+
+  glUseProgram(histogram_program_);
+  glUniform1i(glGetUniformLocation(histogram_program_, "hdr_texture"), 0);
+  glUniform2i(glGetUniformLocation(histogram_program_, "grid_size"),
+              kHistogramGridWidth, kHistogramGridHeight);
+  glUniform2f(glGetUniformLocation(histogram_program_, "log_luminance_range"),
+              kMinLogLuminance, kMaxLogLuminance);
+  glUniform1i(glGetUniformLocation(histogram_program_, "bin_count"),
+              kHistogramBinCount);
+
+  glUseProgram(exposure_program_);
+  glUniform1i(glGetUniformLocation(exposure_program_, "histogram_texture"), 0);
+  glUniform1i(
+      glGetUniformLocation(exposure_program_, "previous_exposure_texture"), 1);
+  glUniform1i(glGetUniformLocation(exposure_program_, "bin_count"),
+              kHistogramBinCount);
+  glUniform2f(glGetUniformLocation(exposure_program_, "log_luminance_range"),
+              kMinLogLuminance, kMaxLogLuminance);
+  glUniform2f(glGetUniformLocation(exposure_program_, "percentiles"),
+              kLowPercentile, kHighPercentile);
+  glUniform1f(glGetUniformLocation(exposure_program_, "key_value"), kKeyValue);
+
+  glUseProgram(tonemap_program_);
+  glUniform1i(glGetUniformLocation(tonemap_program_, "hdr_texture"), 0);
+  glUniform1i(glGetUniformLocation(tonemap_program_, "exposure_texture"), 1);
+  glUseProgram(0);
+}
+
+void HdrRenderer::Resize(int width, int height) {
+  if (width == width_ && height == height_) {
+    return;
+  }
+  width_ = width;
+  height_ = height;
+  if (hdr_fbo_ != 0) {
+    glDeleteFramebuffers(1, &hdr_fbo_);
+    DeleteGpuTextures(1, &hdr_texture_);
+  }
+  hdr_texture_ = NewFloatTexture(GL_RGBA16F, width, height, GL_LINEAR);
+  hdr_fbo_ = NewFramebuffer(hdr_texture_);
+}
+
+void HdrRenderer::SetAutoExposure(bool enabled) {
+  if (enabled && !auto_exposure_) {
+    reset_exposure_ = true;
+  }
+  auto_exposure_ = enabled;
+}
+
+double HdrRenderer::AdaptationSeconds() const {
+  // exp(-5) < 1%.
+  return auto_exposure_ ? 5.0 / kAdaptationRate : 0.0;
+}
+
+void HdrRenderer::BeginScene() {
+  glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo_);
+  glViewport(0, 0, width_, height_);
+}
+
+void HdrRenderer::EndScene(double delta_seconds) {
+  if (auto_exposure_) {
+    BuildHistogram();
+    AdaptExposure(delta_seconds);
+  }
+  Tonemap();
+}
+
+void HdrRenderer::BuildHistogram() {
+  glBindFramebuffer(GL_FRAMEBUFFER, histogram_fbo_);
+  glViewport(0, 0, kHistogramBinCount, 1);
+  glClearColor(0.0, 0.0, 0.0, 0.0);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  glUseProgram(histogram_program_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, hdr_texture_);
+  glEnable(GL_BLEND);
+  glBlendEquation(GL_FUNC_ADD);
+  glBlendFunc(GL_ONE, GL_ONE);
+  glBindVertexArray(empty_vao_);
+  glDrawArrays(GL_POINTS, 0, kHistogramGridWidth * kHistogramGridHeight);
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+}
+
+void HdrRenderer::AdaptExposure(double delta_seconds) {
+  const int previous = current_exposure_;
+  current_exposure_ = 1 - current_exposure_;
+  const float adaptation = reset_exposure_ ? 1.0f :
+      1.0f - std::exp(-static_cast<float>(delta_seconds) * kAdaptationRate);
+  reset_exposure_ = false;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, exposure_fbos_[current_exposure_]);
+  glViewport(0, 0, 1, 1);
+  glUseProgram(exposure_program_);
+  glUniform1f(glGetUniformLocation(exposure_program_, "adaptation"),
+              adaptation);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, histogram_texture_);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, exposure_textures_[previous]);
+  quad_.Draw();
+}
+
+void HdrRenderer::Tonemap() {
+  glBindFramebuffer(GL_FRAMEBUFFER, output_framebuffer_);
+  glViewport(0, 0, width_, height_);
+  glUseProgram(tonemap_program_);
+  glUniform1i(glGetUniformLocation(tonemap_program_, "use_auto_exposure"),
+              auto_exposure_);
+  glUniform1f(glGetUniformLocation(tonemap_program_, "manual_exposure"),
+              manual_exposure_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, hdr_texture_);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, exposure_textures_[current_exposure_]);
+  quad_.Draw();
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,75 @@
+#ifndef RENDER_HDR_RENDERER_H_
+#define RENDER_HDR_RENDERER_H_
+
+#include <glad/glad.h>
+
+#include "RENDER/fullscreen_quad.h"
+
+// Renders the scene into a floating point framebuffer and tonemaps it into
+// the default framebuffer (or another one), with an exposure adapted
+// automatically from a luminance histogram of the scene. Everything stays on
+// the GPU: the histogram is accumulated by scattering points into a 1D float
+// texture with additive blending, reduced into a 1x1 exposure texture
+// (smoothed over time by ping-ponging between two of them), which the
+// tonemapping pass reads directly.
+//
+// Usage, at each frame:
+//   Resize(framebuffer width, framebuffer height);
+//   BeginScene();
+//   ... draw the scene, writing linear radiance ...
+//   EndScene(seconds since the previous frame);
+class HdrRenderer {
+ public:
+  HdrRenderer();
+  HdrRenderer(HdrRenderer const&) = delete;
+  HdrRenderer(HdrRenderer&&) = delete;
+  ~HdrRenderer();
+
+  // Reallocates the HDR color buffer if the size changed.
+  void Resize(int width, int height);
+  void BeginScene();
+  void EndScene(double delta_seconds);
+
+  void SetAutoExposure(bool enabled);
+  void SetManualExposure(float exposure) { manual_exposure_ = exposure; }
+  bool auto_exposure() const { return auto_exposure_; }
+  // The framebuffer receiving the tonemapped scene (0 for the default one).
+  void SetOutputFramebuffer(GLuint framebuffer) {
+    output_framebuffer_ = framebuffer;
+  }
+  // The framebuffer containing the linear radiance of the last scene.
+  GLuint hdr_framebuffer() const { return hdr_fbo_; }
+
+  // The rendering time needed for the adapted exposure to converge after a
+  // change of the scene (the caller must keep drawing frames meanwhile).
+  double AdaptationSeconds() const;
+
+ private:
+  void SetupBuffers();
+  void SetupPrograms();
+  void BuildHistogram();
+  void AdaptExposure(double delta_seconds);
+  void Tonemap();
+
+  int width_;
+  int height_;
+  GLuint hdr_texture_;
+  GLuint hdr_fbo_;
+  GLuint histogram_texture_;
+  GLuint histogram_fbo_;
+  GLuint exposure_textures_[2];
+  GLuint exposure_fbos_[2];
+  int current_exposure_;
+  bool reset_exposure_;
+  bool auto_exposure_;
+  float manual_exposure_;
+  GLuint output_framebuffer_;
+
+  FullscreenQuad quad_;
+  GLuint empty_vao_;
+  GLuint histogram_program_;
+  GLuint exposure_program_;
+  GLuint tonemap_program_;
+};
+
+#endif  // RENDER_HDR_RENDERER_H_
@@ -0,0 +1,121 @@
+#include "image_file.h"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Favors the encoding speed: the image sequences are large, and the PNG files
+// are mostly intermediate results.
+constexpr int kPngCompressionLevel = 3;
+
+void AppendUint32(uint32_t value, std::vector<unsigned char>* output) {
+  output->push_back(static_cast<unsigned char>(value >> 24));
+  output->push_back(static_cast<unsigned char>(value >> 16));
+  output->push_back(static_cast<unsigned char>(value >> 8));
+  output->push_back(static_cast<unsigned char>(value));
+}
+
+void AppendChunk(const char type[4], const std::vector<unsigned char>& data,
+                 std::vector<unsigned char>* output) {
+  AppendUint32(static_cast<uint32_t>(data.size()), output);
+  const size_t type_offset = output->size();
+  output->insert(output->end(), type, type + 4);
+  output->insert(output->end(), data.begin(), data.end());
+  const uLong crc = crc32(0, output->data() + type_offset,
+                          static_cast<uInt>(data.size() + 4));
+  AppendUint32(static_cast<uint32_t>(crc), output);
+}
+
+}  // anonymous namespace
+
+bool WritePng(const std::string& path, int width, int height,
+              const unsigned char* rgba) {
+  // Each row starts with its filter type (0, none), and the rows are flipped
+  // to be stored from top to bottom.
+  const size_t row_size = static_cast<size_t>(width) * 4;
+  std::vector<unsigned char> rows((row_size + 1) * height);
+  for (int y = 0; y < height; ++y) {
+    unsigned char* row = rows.data() + (row_size + 1) * y;
+    row[0] = 0;
+    std::memcpy(row + 1, rgba + row_size * (height - 1 - y), row_size);
+  }
+  uLongf compressed_size = compressBound(static_cast<uLong>(rows.size()));
+  std::vector<unsigned char> compressed(compressed_size);
+  if (compress2(compressed.data(), &compressed_size, rows.data(),
+                static_cast<uLong>(rows.size()),
+                kPngCompressionLevel) != Z_OK) {
+    return false;
+  }
+  compressed.resize(compressed_size);
+
+  std::vector<unsigned char> header;
+  AppendUint32(static_cast<uint32_t>(width), &header);
+  AppendUint32(static_cast<uint32_t>(height), &header);
+  header.push_back(8);  // Bits per component.
+  header.push_back(6);  // RGBA.
+  header.push_back(0);  // Deflate compression.
+  header.push_back(0);  // Adaptive filtering.
+  header.push_back(0);  // No interlacing.
+
+  static const unsigned char kSignature[8] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+  };
+  std::vector<unsigned char> png(kSignature, kSignature + 8);
+  AppendChunk("IHDR", header, &png);
+  AppendChunk("IDAT", compressed, &png);
+  AppendChunk("IEND", std::vector<unsigned char>(), &png);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(png.data()), png.size());
+  return static_cast<bool>(file);
+}
+
+bool WritePfm(const std::string& path, int width, int height,
+              const float* rgb) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  // A negative scale means little endian floats.
+  const uint16_t endianness_test = 1;
+  const bool little_endian =
+      *reinterpret_cast<const unsigned char*>(&endianness_test) == 1;
+  file << "PF\n" << width << " " << height << "\n"
+       << (little_endian ? "-1.0" : "1.0") << "\n";
+  file.write(reinterpret_cast<const char*>(rgb),
+             static_cast<std::streamsize>(width) * height * 3 * sizeof(float));
+  return static_cast<bool>(file);
+}
+
+bool ReadPfm(const std::string& path, int* width, int* height,
+             std::vector<float>* rgb) {
+  std::ifstream file(path, std::ios::binary);
+  std::string format;
+  double scale;
+  if (!(file >> format >> *width >> *height >> scale) || format != "PF" ||
+      *width <= 0 || *height <= 0 || scale == 0.0) {
+    return false;
+  }
+  // A single whitespace character separates the header from the pixels.
+  file.get();
+  rgb->resize(static_cast<size_t>(*width) * *height * 3);
+  file.read(reinterpret_cast<char*>(rgb->data()),
+            static_cast<std::streamsize>(rgb->size() * sizeof(float)));
+  if (!file) {
+    return false;
+  }
+  const uint16_t endianness_test = 1;
+  const bool little_endian =
+      *reinterpret_cast<const unsigned char*>(&endianness_test) == 1;
+  if ((scale < 0.0) != little_endian) {
+    for (float& value : *rgb) {
+      unsigned char* bytes = reinterpret_cast<unsigned char*>(&value);
+      std::swap(bytes[0], bytes[3]);
+      std::swap(bytes[1], bytes[2]);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,26 @@
+#ifndef RENDER_IMAGE_FILE_H_
+#define RENDER_IMAGE_FILE_H_
+
+#include <string>
+#include <vector>
+
+// Writers for the images read back from OpenGL, whose rows are stored from
+// bottom to top. They can be called from any thread.
+
+// Writes 'width' x 'height' RGBA pixels, with 8 bits per component, in a PNG
+// file. Returns false on failure.
+bool WritePng(const std::string& path, int width, int height,
+              const unsigned char* rgba);
+
+// Writes 'width' x 'height' RGB float pixels in a PFM file (the raw floating
+// point format, which also stores its rows from bottom to top). Returns false
+// on failure.
+bool WritePfm(const std::string& path, int width, int height,
+              const float* rgb);
+
+// Reads a PFM file with 3 channels, written by WritePfm or by another tool,
+// into 'rgb' (with rows from bottom to top). Returns false on failure.
+bool ReadPfm(const std::string& path, int* width, int* height,
+             std::vector<float>* rgb);
+
+#endif  // RENDER_IMAGE_FILE_H_
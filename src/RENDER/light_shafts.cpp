@@ -0,0 +1,399 @@
+#include "light_shafts.h"
+
+#include <cmath>
+#include <string>
+
+#include "RENDER/gpu_memory_tracker.h"
+#include "RENDER/shader_compile.h"
+
+namespace {
+
+constexpr int kShadowMapSize = 2048;
+// The epipolar texture has one row per epipolar line, and one column per
+// sample along each line.
+constexpr int kEpipolarLineCount = 512;
+constexpr int kEpipolarSampleCount = 256;
+// The number of shadow map lookups per view ray sample.
+constexpr int kRayMarchStepCount = 64;
+// Default half size of the shadow map box, and max view ray marching distance,
+// in the model length unit (km in this application).
+constexpr float kDefaultMaxDistance = 32.0f;
+
+// Texture unit used while computing the samples (the Model1 textures use 0 to
+// 3, and the SkyEnvironment update uses 4).
+constexpr GLuint kShadowMapTextureUnit = 5;
+
+const char kLightSpaceGlsl[] = R"(
+    uniform vec3 light_origin;
+    uniform vec3 light_x;
+    uniform vec3 light_y;
+    uniform vec3 light_z;
+    uniform float light_extent;
+    // Coordinates of 'p' in the shadow map box, in [-1,1]^3. z increases
+    // towards the sun.
+    vec3 LightSpacePosition(vec3 p) {
+      vec3 q = p - light_origin;
+      return vec3(dot(q, light_x), dot(q, light_y), dot(q, light_z)) /
+          light_extent;
+    }
+    vec4 LightClipPosition(vec3 p) {
+      return vec4(LightSpacePosition(p), 1.0);
+    }
+)";
+
+// The epipolar lines go from the sun position on screen (or from where they
+// enter the screen if the sun is outside) to a point on the screen border.
+// The lines are indexed with the perimeter parameter of this exit point, in
+// [0,1), counterclockwise from the bottom left corner. All positions are in
+// [-1,1]^2 normalized device coordinates.
+const char kEpipolarGlsl[] = R"(
+    uniform vec2 epipolar_sun_position;
+    vec2 SafeDirection(vec2 d) {
+      return vec2(abs(d.x) < 1e-6 ? 1e-6 : d.x, abs(d.y) < 1e-6 ? 1e-6 : d.y);
+    }
+    vec2 EpipolarExitPoint(float u) {
+      float t = fract(u) * 4.0;
+      if (t < 1.0) return vec2(-1.0 + 2.0 * t, -1.0);
+      if (t < 2.0) return vec2(1.0, -1.0 + 2.0 * (t - 1.0));
+      if (t < 3.0) return vec2(1.0 - 2.0 * (t - 2.0), 1.0);
+      return vec2(-1.0, 1.0 - 2.0 * (t - 3.0));
+    }
+    float EpipolarLineParameter(vec2 exit_point) {
+      vec2 p = exit_point;
+      if (p.y <= -1.0 + 1e-4) return (p.x + 1.0) / 8.0;
+      if (p.x >= 1.0 - 1e-4) return (1.0 + (p.y + 1.0) / 2.0) / 4.0;
+      if (p.y >= 1.0 - 1e-4) return (2.0 + (1.0 - p.x) / 2.0) / 4.0;
+      return (3.0 + (1.0 - p.y) / 2.0) / 4.0;
+    }
+    vec2 EpipolarLineStart(vec2 exit_point) {
+      vec2 d = SafeDirection(exit_point - epipolar_sun_position);
+      vec2 t_min = min((vec2(-1.0) - epipolar_sun_position) / d,
+          (vec2(1.0) - epipolar_sun_position) / d);
+      return epipolar_sun_position +
+          d * clamp(max(t_min.x, t_min.y), 0.0, 1.0);
+    }
+)";
+
+const char kQuadVertexShader[] = R"(
+    #version 330
+    layout(location = 0) in vec2 vertex;
+    out vec2 position;
+    void main() {
+      position = vertex;
+      gl_Position = vec4(vertex, 0.0, 1.0);
+    })";
+
+// Draws a sphere with a full screen quad in light space, by computing the
+// depth of its top surface (as seen from the sun) analytically.
+const char kSphereOccluderFragmentShader[] = R"(
+    uniform vec3 sphere_center;
+    uniform float sphere_radius;
+    in vec2 position;
+    void main() {
+      vec3 c = LightSpacePosition(sphere_center);
+      float r = sphere_radius / light_extent;
+      vec2 d = position - c.xy;
+      float h2 = r * r - dot(d, d);
+      if (h2 <= 0.0) {
+        discard;
+      }
+      gl_FragDepth = (c.z + sqrt(h2)) * 0.5 + 0.5;
+    })";
+
+// Marches the view ray of each epipolar sample through the shadow map, up to
+// the ground or the max distance, and records the distances where it first
+// enters and last leaves the shadow.
+const char kSamplingFragmentShader[] = R"(
+    uniform sampler2D shadow_map;
+    uniform mat4 model_from_view;
+    uniform mat4 view_from_clip;
+    uniform vec3 camera;
+    uniform vec3 earth_center;
+    uniform int line_count;
+    uniform int sample_count;
+    uniform int step_count;
+    layout(location = 0) out vec4 shadow_in_out;
+    bool IsInShadow(vec3 p) {
+      vec3 l = LightSpacePosition(p);
+      if (any(greaterThan(abs(l.xy), vec2(1.0)))) {
+        return false;
+      }
+      float occluder_depth = texture(shadow_map, l.xy * 0.5 + 0.5).r;
+      return l.z * 0.5 + 0.5 < occluder_depth - 1e-4;
+    }
+    void main() {
+      float u = (gl_FragCoord.y - 0.5) / float(line_count);
+      float v = (gl_FragCoord.x - 0.5) / float(sample_count - 1);
+      vec2 exit_point = EpipolarExitPoint(u);
+      vec2 p = mix(EpipolarLineStart(exit_point), exit_point, v);
+      vec3 view_direction = normalize((model_from_view *
+          vec4((view_from_clip * vec4(p, 0.0, 1.0)).xyz, 0.0)).xyz);
+
+      float max_distance = light_extent;
+      vec3 c = camera - earth_center;
+      float r = length(earth_center);
+      float b = dot(c, view_direction);
+      float discriminant = b * b - dot(c, c) + r * r;
+      if (b < 0.0 && discriminant > 0.0) {
+        max_distance = min(max_distance, -b - sqrt(discriminant));
+      }
+
+      float dt = max_distance / float(step_count);
+      float shadow_in = -1.0;
+      float shadow_out = 0.0;
+      for (int i = 0; i < step_count; ++i) {
+        float t = (float(i) + 0.5) * dt;
+        if (IsInShadow(camera + t * view_direction)) {
+          if (shadow_in < 0.0) {
+            shadow_in = t - 0.5 * dt;
+          }
+          shadow_out = t + 0.5 * dt;
+        }
+      }
+      shadow_in_out = shadow_in < 0.0 ?
+          vec4(0.0) : vec4(shadow_in, shadow_out, 0.0, 0.0);
+    })";
+
+const char kShader[] = R"(
+    uniform sampler2D epipolar_texture;
+    uniform vec2 epipolar_viewport_size;
+    uniform vec2 epipolar_texture_size;
+    vec2 GetLightShaftShadowInOut(vec2 frag_coord) {
+      vec2 p = frag_coord / epipolar_viewport_size * 2.0 - 1.0;
+      vec2 d = SafeDirection(p - epipolar_sun_position);
+      vec2 t_max = max((vec2(-1.0) - epipolar_sun_position) / d,
+          (vec2(1.0) - epipolar_sun_position) / d);
+      vec2 exit_point = clamp(
+          epipolar_sun_position + d * min(t_max.x, t_max.y), -1.0, 1.0);
+      vec2 start = EpipolarLineStart(exit_point);
+      float v = clamp(length(p - start) /
+          max(length(exit_point - start), 1e-6), 0.0, 1.0);
+      float u = EpipolarLineParameter(exit_point);
+      vec2 uv = vec2(
+          (v * (epipolar_texture_size.x - 1.0) + 0.5) / epipolar_texture_size.x,
+          u + 0.5 / epipolar_texture_size.y);
+      return texture(epipolar_texture, uv).xy;
+    })";
+
+std::array<float, 3> Normalize(const std::array<float, 3>& v) {
+  const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  return {{v[0] / length, v[1] / length, v[2] / length}};
+}
+
+std::array<float, 3> Cross(const std::array<float, 3>& a,
+                           const std::array<float, 3>& b) {
+  return {{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2],
+           a[0] * b[1] - a[1] * b[0]}};
+}
+
+}  // anonymous namespace
+
+LightShafts::LightShafts()
+    : max_distance_(kDefaultMaxDistance), camera_{{0.0f, 0.0f, 0.0f}},
+      light_x_{{1.0f, 0.0f, 0.0f}}, light_y_{{0.0f, 1.0f, 0.0f}},
+      light_z_{{0.0f, 0.0f, 1.0f}}, sun_position_{{0.0f, 0.0f}},
+      viewport_width_(1), viewport_height_(1), old_fbo_(0),
+      old_viewport_{0, 0, 0, 0} {
+  glGenTextures(1, &shadow_map_texture_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, shadow_map_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, kShadowMapSize,
+               kShadowMapSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+  TrackGpuTexture(shadow_map_texture_, GPU_MEMORY_SCENE,
+                  GlTextureBytes(GL_DEPTH_COMPONENT32F, kShadowMapSize,
+                                 kShadowMapSize));
+  glGenFramebuffers(1, &shadow_map_fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, shadow_map_fbo_);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                       shadow_map_texture_, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+
+  // The lines wrap around the screen, hence the GL_REPEAT along the lines.
+  glGenTextures(1, &epipolar_texture_);
+  glBindTexture(GL_TEXTURE_2D, epipolar_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, kEpipolarSampleCount,
+               kEpipolarLineCount, 0, GL_RG, GL_FLOAT, NULL);
+  TrackGpuTexture(epipolar_texture_, GPU_MEMORY_SCENE,
+                  GlTextureBytes(GL_RG32F, kEpipolarSampleCount,
+                                 kEpipolarLineCount));
+  glGenFramebuffers(1, &epipolar_fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, epipolar_fbo_);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                       epipolar_texture_, 0);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  PendingProgram sphere_occluder_program = SubmitProgram(
+      "light shafts sphere occluder program", kQuadVertexShader,
+      std::string("#version 330\n") + kLightSpaceGlsl +
+          kSphereOccluderFragmentShader);
+  PendingProgram sampling_program = SubmitProgram(
+      "light shafts sampling program", kQuadVertexShader,
+      std::string("#version 330\n") + kLightSpaceGlsl + kEpipolarGlsl +
+          kSamplingFragmentShader);
+  shader_ = SubmitShader(GL_FRAGMENT_SHADER,
+      std::string("#version 330\n") + kEpipolarGlsl + kShader);
+  sphere_occluder_program_ = FinishProgram(&sphere_occluder_program);
+  sampling_program_ = FinishProgram(&sampling_program);
+
+  glUseProgram(sampling_program_);
+  glUniform1i(glGetUniformLocation(sampling_program_, "shadow_map"),
+              kShadowMapTextureUnit);
+  glUniform1i(glGetUniformLocation(sampling_program_, "line_count"),
+              kEpipolarLineCount);
+  glUniform1i(glGetUniformLocation(sampling_program_, "sample_count"),
+              kEpipolarSampleCount);
+  glUniform1i(glGetUniformLocation(sampling_program_, "step_count"),
+              kRayMarchStepCount);
+  glUseProgram(0);
+}
+
+LightShafts::~LightShafts() {
+  glDeleteShader(shader_);
+  glDeleteProgram(sampling_program_);
+  glDeleteProgram(sphere_occluder_program_);
+  glDeleteFramebuffers(1, &epipolar_fbo_);
+  DeleteGpuTextures(1, &epipolar_texture_);
+  glDeleteFramebuffers(1, &shadow_map_fbo_);
+  DeleteGpuTextures(1, &shadow_map_texture_);
+}
+
+void LightShafts::BeginShadowPass(const std::array<float, 3>& camera,
+                                  const std::array<float, 3>& sun_direction) {
+  camera_ = camera;
+  light_z_ = Normalize(sun_direction);
+  const std::array<float, 3> up = std::abs(light_z_[2]) < 0.999f ?
+      std::array<float, 3>{{0.0f, 0.0f, 1.0f}} :
+      std::array<float, 3>{{1.0f, 0.0f, 0.0f}};
+  light_x_ = Normalize(Cross(up, light_z_));
+  light_y_ = Cross(light_z_, light_x_);
+
+  glGetIntegerv(GL_VIEWPORT, old_viewport_);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, shadow_map_fbo_);
+  glViewport(0, 0, kShadowMapSize, kShadowMapSize);
+  // The shadow map keeps the occluders closest to the sun, i.e. with the
+  // largest light space z.
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_GREATER);
+  glClearDepth(0.0);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void LightShafts::DrawSphereOccluder(const std::array<float, 3>& center,
+                                     float radius) {
+  glUseProgram(sphere_occluder_program_);
+  setShadowPassUniforms(sphere_occluder_program_);
+  glUniform3f(glGetUniformLocation(sphere_occluder_program_, "sphere_center"),
+              center[0], center[1], center[2]);
+  glUniform1f(glGetUniformLocation(sphere_occluder_program_, "sphere_radius"),
+              radius);
+  quad_.Draw();
+}
+
+void LightShafts::EndShadowPass() {
+  glClearDepth(1.0);
+  glDepthFunc(GL_LESS);
+  glDisable(GL_DEPTH_TEST);
+  glBindFramebuffer(GL_FRAMEBUFFER, old_fbo_);
+  glViewport(old_viewport_[0], old_viewport_[1], old_viewport_[2],
+             old_viewport_[3]);
+}
+
+void LightShafts::setShadowPassUniforms(GLuint program) const {
+  glUniform3f(glGetUniformLocation(program, "light_origin"),
+              camera_[0], camera_[1], camera_[2]);
+  glUniform3f(glGetUniformLocation(program, "light_x"),
+              light_x_[0], light_x_[1], light_x_[2]);
+  glUniform3f(glGetUniformLocation(program, "light_y"),
+              light_y_[0], light_y_[1], light_y_[2]);
+  glUniform3f(glGetUniformLocation(program, "light_z"),
+              light_z_[0], light_z_[1], light_z_[2]);
+  glUniform1f(glGetUniformLocation(program, "light_extent"), max_distance_);
+}
+
+const char* LightShafts::LightSpaceGlsl() {
+  return kLightSpaceGlsl;
+}
+
+void LightShafts::ComputeSamples(const float model_from_view[16],
+                                 const float view_from_clip[16],
+                                 const std::array<float, 3>& earth_center,
+                                 int viewport_width, int viewport_height) {
+  viewport_width_ = viewport_width;
+  viewport_height_ = viewport_height;
+
+  // The sun position on screen, i.e. the vanishing point of the sun direction
+  // (this is also valid when the sun is behind the camera: the epipolar lines
+  // then converge towards the anti-sun point, but they are the same lines).
+  // The view_from_clip matrix only scales x and y, and maps z to -1.
+  float view_sun[3];
+  for (int i = 0; i < 3; ++i) {
+    view_sun[i] = model_from_view[i] * light_z_[0] +
+        model_from_view[4 + i] * light_z_[1] +
+        model_from_view[8 + i] * light_z_[2];
+  }
+  float depth = -view_sun[2];
+  if (std::abs(depth) < 1e-4f) {
+    depth = depth < 0.0f ? -1e-4f : 1e-4f;
+  }
+  sun_position_[0] = view_sun[0] / (depth * view_from_clip[0]);
+  sun_position_[1] = view_sun[1] / (depth * view_from_clip[5]);
+
+  GLint old_viewport[4];
+  glGetIntegerv(GL_VIEWPORT, old_viewport);
+  GLint old_fbo;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, epipolar_fbo_);
+  glViewport(0, 0, kEpipolarSampleCount, kEpipolarLineCount);
+
+  glActiveTexture(GL_TEXTURE0 + kShadowMapTextureUnit);
+  glBindTexture(GL_TEXTURE_2D, shadow_map_texture_);
+  glUseProgram(sampling_program_);
+  setShadowPassUniforms(sampling_program_);
+  SetEpipolarUniforms(sampling_program_);
+  glUniformMatrix4fv(glGetUniformLocation(sampling_program_, "model_from_view"),
+      1, true, model_from_view);
+  glUniformMatrix4fv(glGetUniformLocation(sampling_program_, "view_from_clip"),
+      1, true, view_from_clip);
+  glUniform3f(glGetUniformLocation(sampling_program_, "camera"),
+              camera_[0], camera_[1], camera_[2]);
+  glUniform3f(glGetUniformLocation(sampling_program_, "earth_center"),
+              earth_center[0], earth_center[1], earth_center[2]);
+  quad_.Draw();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, old_fbo);
+  glViewport(old_viewport[0], old_viewport[1], old_viewport[2],
+             old_viewport[3]);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void LightShafts::SetEpipolarUniforms(GLuint program) const {
+  glUniform2f(glGetUniformLocation(program, "epipolar_sun_position"),
+              sun_position_[0], sun_position_[1]);
+}
+
+void LightShafts::setProgramUniforms(GLuint program,
+                                     GLuint epipolar_texture_unit) const {
+  glActiveTexture(GL_TEXTURE0 + epipolar_texture_unit);
+  glBindTexture(GL_TEXTURE_2D, epipolar_texture_);
+  glUniform1i(glGetUniformLocation(program, "epipolar_texture"),
+      epipolar_texture_unit);
+  SetEpipolarUniforms(program);
+  glUniform2f(glGetUniformLocation(program, "epipolar_viewport_size"),
+      static_cast<float>(viewport_width_),
+      static_cast<float>(viewport_height_));
+  glUniform2f(glGetUniformLocation(program, "epipolar_texture_size"),
+      static_cast<float>(kEpipolarSampleCount),
+      static_cast<float>(kEpipolarLineCount));
+}
@@ -0,0 +1,99 @@
+#ifndef RENDER_LIGHT_SHAFTS_H_
+#define RENDER_LIGHT_SHAFTS_H_
+
+#include <glad/glad.h>
+
+#include <array>
+
+#include "RENDER/fullscreen_quad.h"
+
+// Light shafts from arbitrary occluders, for the 'shadow_length' argument of
+// the GetSkyRadiance and GetSkyRadianceToPoint functions of Model1.
+//
+// The occluders are first rendered into an orthographic shadow map looking
+// down the sun direction. Then, instead of ray marching this shadow map for
+// each pixel, the view rays are marched only at sparse samples along
+// epipolar lines, i.e. along the lines going from the sun position on screen
+// to the screen borders (in screen space, the light shafts are radial from
+// the sun, so they vary slowly along these lines). For each sample the
+// distances along the view ray where the ray enters and leaves the shadow are
+// stored in a texture, whose rows are the epipolar lines. Pixels then
+// interpolate this texture at their epipolar coordinates.
+//
+// Usage, at each frame:
+//   BeginShadowPass(camera, sun_direction);
+//   ... draw the occluders (see setShadowPassUniforms), or DrawSphereOccluder
+//   EndShadowPass();
+//   ComputeSamples(...);
+//   // For each program linked with shader():
+//   setProgramUniforms(program, unit);
+//
+// The shader returned by shader() provides the following function (to forward
+// declare in the shaders using it):
+//
+//   // The distances along the view ray of the given fragment where the ray
+//   // enters and leaves the shadow (both 0 if the ray is not shadowed).
+//   vec2 GetLightShaftShadowInOut(vec2 frag_coord);
+class LightShafts {
+ public:
+  LightShafts();
+  LightShafts(LightShafts const&) = delete;
+  LightShafts(LightShafts&&) = delete;
+  ~LightShafts();
+
+  // 'camera' and 'sun_direction' are expressed in the frame of the view rays,
+  // in the model length unit. The shadow map covers a box of half size
+  // max_distance() around the camera.
+  void BeginShadowPass(const std::array<float, 3>& camera,
+                       const std::array<float, 3>& sun_direction);
+  // Draws an opaque sphere into the shadow map.
+  void DrawSphereOccluder(const std::array<float, 3>& center, float radius);
+  void EndShadowPass();
+
+  // Sets the uniforms used by the LightSpaceGlsl() functions, for programs
+  // drawing occluders during the shadow pass.
+  void setShadowPassUniforms(GLuint program) const;
+  // GLSL code providing 'vec4 LightClipPosition(vec3 p)', which returns the
+  // gl_Position of a point 'p' to draw into the shadow map.
+  static const char* LightSpaceGlsl();
+
+  // 'model_from_view' and 'view_from_clip' are row major matrices, as given
+  // to the view ray vertex shader of the scene. 'earth_center' is used to
+  // stop the view rays at the ground.
+  void ComputeSamples(const float model_from_view[16],
+                      const float view_from_clip[16],
+                      const std::array<float, 3>& earth_center,
+                      int viewport_width, int viewport_height);
+
+  GLuint shader() const { return shader_; }
+  void setProgramUniforms(GLuint program, GLuint epipolar_texture_unit) const;
+
+  float max_distance() const { return max_distance_; }
+  void set_max_distance(float max_distance) { max_distance_ = max_distance; }
+
+ private:
+  void SetEpipolarUniforms(GLuint program) const;
+
+  GLuint shadow_map_texture_;
+  GLuint shadow_map_fbo_;
+  GLuint epipolar_texture_;
+  GLuint epipolar_fbo_;
+  FullscreenQuad quad_;
+  GLuint sphere_occluder_program_;
+  GLuint sampling_program_;
+  GLuint shader_;
+
+  float max_distance_;
+  std::array<float, 3> camera_;
+  std::array<float, 3> light_x_;
+  std::array<float, 3> light_y_;
+  std::array<float, 3> light_z_;
+  std::array<float, 2> sun_position_;
+  int viewport_width_;
+  int viewport_height_;
+
+  GLint old_fbo_;
+  GLint old_viewport_[4];
+};
+
+#endif  // RENDER_LIGHT_SHAFTS_H_
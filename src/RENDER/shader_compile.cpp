@@ -0,0 +1,183 @@
+#include "shader_compile.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "CORE/trace.h"
+
+namespace {
+
+// The extension is not in the glad loader, which only has its name.
+constexpr GLenum kCompletionStatusKhr = 0x91B1;
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+bool parallel_shader_compile = false;
+std::ostream* compile_log = nullptr;
+
+bool HasExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr && std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PrintShaderLog(GLuint shader) {
+  GLint log_length = 0;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
+  if (log_length > 0) {
+    std::unique_ptr<char[]> log_data(new char[log_length]);
+    glGetShaderInfoLog(shader, log_length, &log_length, log_data.get());
+    std::cerr << "compile log = "
+              << std::string(log_data.get(), log_length) << std::endl;
+  }
+}
+
+void PrintProgramLog(GLuint program) {
+  GLint log_length = 0;
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+  if (log_length > 0) {
+    std::unique_ptr<char[]> log_data(new char[log_length]);
+    glGetProgramInfoLog(program, log_length, &log_length, log_data.get());
+    std::cerr << "link log = "
+              << std::string(log_data.get(), log_length) << std::endl;
+  }
+}
+
+double Milliseconds(int64_t begin_ns, int64_t end_ns) {
+  return (end_ns - begin_ns) * 1e-6;
+}
+
+}  // anonymous namespace
+
+bool EnableParallelShaderCompile(GLADloadproc get_proc_address) {
+  const char* function_name =
+      HasExtension("GL_KHR_parallel_shader_compile") ?
+          "glMaxShaderCompilerThreadsKHR" :
+      HasExtension("GL_ARB_parallel_shader_compile") ?
+          "glMaxShaderCompilerThreadsARB" : nullptr;
+  MaxShaderCompilerThreadsProc max_shader_compiler_threads =
+      function_name != nullptr ? reinterpret_cast<MaxShaderCompilerThreadsProc>(
+                                     get_proc_address(function_name))
+                               : nullptr;
+  parallel_shader_compile = max_shader_compiler_threads != nullptr;
+  if (parallel_shader_compile) {
+    // 0xFFFFFFFF means an implementation-specific maximum.
+    max_shader_compiler_threads(0xFFFFFFFFu);
+  }
+  return parallel_shader_compile;
+}
+
+bool IsParallelShaderCompileEnabled() { return parallel_shader_compile; }
+
+bool IsProgramLinkComplete(GLuint program) {
+  if (!parallel_shader_compile) {
+    return true;
+  }
+  GLint complete = GL_FALSE;
+  glGetProgramiv(program, kCompletionStatusKhr, &complete);
+  return complete == GL_TRUE;
+}
+
+void SetShaderCompileLog(std::ostream* log) { compile_log = log; }
+
+bool FinishProgramLink(GLuint program, const std::vector<GLuint>& shaders,
+                       const std::string& name, int64_t submit_begin_ns,
+                       int64_t submit_end_ns) {
+  // With the extension, poll the completion status to get the time at which
+  // the program became ready. Otherwise the link status query below blocks
+  // until then.
+  const int64_t wait_begin_ns = TraceNanoseconds();
+  while (!IsProgramLinkComplete(program)) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  GLint link_status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  const int64_t ready_ns = TraceNanoseconds();
+#if ATMOSPHERE_TRACING
+  RecordTraceZone(InternTraceName("wait for " + name), wait_begin_ns,
+                  ready_ns);
+#endif
+
+  if (link_status == GL_FALSE) {
+    for (GLuint shader : shaders) {
+      GLint compile_status = GL_FALSE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+      if (compile_status == GL_FALSE) {
+        PrintShaderLog(shader);
+      }
+    }
+    PrintProgramLog(program);
+  }
+  if (compile_log != nullptr) {
+    *compile_log << name << ": submitted in "
+                 << Milliseconds(submit_begin_ns, submit_end_ns)
+                 << " ms, finished "
+                 << Milliseconds(submit_end_ns, ready_ns)
+                 << " ms later (waited "
+                 << Milliseconds(wait_begin_ns, ready_ns) << " ms)"
+                 << (link_status == GL_FALSE ? ", link failed" : "")
+                 << std::endl;
+  }
+  return link_status == GL_TRUE;
+}
+
+GLuint SubmitShader(GLenum type, const std::string& source) {
+  const char* source_data = source.c_str();
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source_data, nullptr);
+  glCompileShader(shader);
+  return shader;
+}
+
+PendingProgram SubmitProgram(const std::string& name,
+                             const std::string& vertex_shader_source,
+                             const std::string& fragment_shader_source,
+                             const std::vector<GLuint>& extra_shaders) {
+  PendingProgram pending;
+  pending.name = name;
+  pending.extra_shaders = extra_shaders;
+  pending.submit_begin_ns = TraceNanoseconds();
+  pending.program = glCreateProgram();
+  pending.shaders.push_back(
+      SubmitShader(GL_VERTEX_SHADER, vertex_shader_source));
+  pending.shaders.push_back(
+      SubmitShader(GL_FRAGMENT_SHADER, fragment_shader_source));
+  for (GLuint shader : pending.shaders) {
+    glAttachShader(pending.program, shader);
+  }
+  for (GLuint shader : extra_shaders) {
+    glAttachShader(pending.program, shader);
+  }
+  glLinkProgram(pending.program);
+  pending.submit_end_ns = TraceNanoseconds();
+  return pending;
+}
+
+GLuint FinishProgram(PendingProgram* pending) {
+  std::vector<GLuint> shaders = pending->shaders;
+  shaders.insert(shaders.end(), pending->extra_shaders.begin(),
+                 pending->extra_shaders.end());
+  const bool link_status =
+      FinishProgramLink(pending->program, shaders, pending->name,
+                        pending->submit_begin_ns, pending->submit_end_ns);
+  assert(link_status);
+  (void) link_status;
+  for (GLuint shader : shaders) {
+    glDetachShader(pending->program, shader);
+  }
+  for (GLuint shader : pending->shaders) {
+    glDeleteShader(shader);
+  }
+  pending->shaders.clear();
+  return pending->program;
+}
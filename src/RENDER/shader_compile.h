@@ -0,0 +1,78 @@
+#ifndef RENDER_SHADER_COMPILE_H_
+#define RENDER_SHADER_COMPILE_H_
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Deferred shader status checks. Querying the compile or link status of a
+// shader or program right after glCompileShader or glLinkProgram waits for the
+// driver to finish it, which serializes the compilations even if the driver
+// can run them on its own threads. Instead, all the programs should be
+// submitted first (glCompileShader, glAttachShader and glLinkProgram, without
+// any status query), and finished with FinishProgramLink just before their
+// first use. With KHR_parallel_shader_compile (or its ARB version) this lets
+// the driver compile them concurrently, so that the total startup time
+// approaches the one of the longest compilation instead of their sum.
+
+// Enables the parallel shader compile extension of the current context, if
+// supported, with as many compiler threads as the driver wants.
+// 'get_proc_address' must return the OpenGL functions of this context (e.g.
+// glfwGetProcAddress), since the extension is not in the glad loader. Returns
+// whether the extension is supported.
+bool EnableParallelShaderCompile(GLADloadproc get_proc_address);
+
+// Whether EnableParallelShaderCompile found the extension.
+bool IsParallelShaderCompileEnabled();
+
+// Returns whether the link of 'program' (and thus the compilation of its
+// shaders) is complete, without blocking. Always true without the parallel
+// shader compile extension, since the status query blocks anyway.
+bool IsProgramLinkComplete(GLuint program);
+
+// Sets where FinishProgramLink logs the compile and link times (nowhere by
+// default). 'log' must outlive all the following FinishProgramLink calls.
+void SetShaderCompileLog(std::ostream* log);
+
+// Waits until the link of 'program' is complete and returns its status, after
+// printing the info logs of 'program' and of its failed 'shaders' to std::cerr
+// if it failed. 'submit_begin_ns' and 'submit_end_ns' are the TraceNanoseconds
+// times before the first glCompileShader call of the program and after its
+// glLinkProgram call, used to log and trace its compile and link time under
+// 'name'.
+bool FinishProgramLink(GLuint program, const std::vector<GLuint>& shaders,
+                       const std::string& name, int64_t submit_begin_ns,
+                       int64_t submit_end_ns);
+
+// A program submitted with SubmitProgram, to finish with FinishProgram.
+struct PendingProgram {
+  GLuint program;
+  // The shaders compiled for this program, deleted by FinishProgram.
+  std::vector<GLuint> shaders;
+  // The already compiled shaders linked with them (e.g. Model1::shader()).
+  std::vector<GLuint> extra_shaders;
+  std::string name;
+  int64_t submit_begin_ns;
+  int64_t submit_end_ns;
+};
+
+// Submits the compilation of a shader, without any status query. Its status
+// is checked by the FinishProgram or FinishProgramLink call of the programs
+// it is linked into.
+GLuint SubmitShader(GLenum type, const std::string& source);
+
+// Submits the compilation and link of a program, from the given sources and
+// 'extra_shaders', without any status query.
+PendingProgram SubmitProgram(const std::string& name,
+                             const std::string& vertex_shader_source,
+                             const std::string& fragment_shader_source,
+                             const std::vector<GLuint>& extra_shaders = {});
+
+// Finishes the link of 'pending' with FinishProgramLink, which prints the
+// info logs if it failed, deletes its shaders, and returns its program.
+GLuint FinishProgram(PendingProgram* pending);
+
+#endif  // RENDER_SHADER_COMPILE_H_
@@ -0,0 +1,431 @@
+#include "sky_environment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "MODEL/model1.h"
+#include "RENDER/gpu_memory_tracker.h"
+#include "RENDER/shader_compile.h"
+
+namespace {
+
+constexpr int kCubemapSize = 128;
+// Levels 0 to kLevelCount - 1 are prefiltered for roughness 0 to 1.
+constexpr int kLevelCount = 6;
+// The sun must move by more than this angle for the map to be updated.
+constexpr float kSunDirectionThresholdRadians = 0.25f / 180.0f * 3.1415926f;
+// Same for the camera, in the model length unit (km in this application).
+constexpr float kCameraDistanceThreshold = 1.0f;
+constexpr int kPrefilterSampleCount = 64;
+
+// A cycle is 6 capture steps, 6 prefilter steps and 1 projection step.
+constexpr int kFirstPrefilterStep = 6;
+constexpr int kProjectionStep = 12;
+
+// Texture units used while updating (the Model1 textures use 0 to 3).
+constexpr GLuint kCaptureTextureUnit = 4;
+
+// The direction, in the Model1 frame, of the point at 'p' (in [-1,1]^2 clip
+// coordinates) on the given cube face (with the usual GL face order and
+// orientations).
+const char kCubeFaceDirectionGlsl[] = R"(
+    vec3 CubeFaceDirection(int face, vec2 p) {
+      if (face == 0) return vec3(1.0, -p.y, -p.x);
+      if (face == 1) return vec3(-1.0, -p.y, p.x);
+      if (face == 2) return vec3(p.x, 1.0, p.y);
+      if (face == 3) return vec3(p.x, -1.0, -p.y);
+      if (face == 4) return vec3(p.x, -p.y, 1.0);
+      return vec3(-p.x, -p.y, -1.0);
+    }
+)";
+
+const char kFaceVertexShader[] = R"(
+    uniform int face;
+    layout(location = 0) in vec2 vertex;
+    out vec3 view_ray;
+    void main() {
+      view_ray = CubeFaceDirection(face, vertex);
+      gl_Position = vec4(vertex, 0.0, 1.0);
+    })";
+
+const char kCaptureFragmentShader[] = R"(
+    #ifdef USE_LUMINANCE
+    #define GetSkyRadiance GetSkyLuminance
+    #endif
+    uniform vec3 camera;
+    uniform vec3 sun_direction;
+    in vec3 view_ray;
+    layout(location = 0) out vec4 color;
+    vec3 GetSkyRadiance(vec3 camera, vec3 view_ray, float shadow_length,
+        vec3 sun_direction, out vec3 transmittance);
+    void main() {
+      vec3 transmittance;
+      color = vec4(GetSkyRadiance(camera, normalize(view_ray), 0.0,
+          sun_direction, transmittance), 1.0);
+    })";
+
+// GGX prefiltering with importance sampling, assuming the view direction is
+// the normal (see "Real Shading in Unreal Engine 4", Karis 2013). The source
+// mip level is chosen from the sample pdf to avoid aliasing.
+const char kPrefilterFragmentShader[] = R"(
+    uniform samplerCube capture_texture;
+    uniform float roughness;
+    uniform float source_size;
+    uniform int sample_count;
+    in vec3 view_ray;
+    layout(location = 0) out vec4 color;
+    const float PI = 3.14159265;
+    vec2 Hammersley(int i, int n) {
+      uint bits = uint(i);
+      bits = (bits << 16u) | (bits >> 16u);
+      bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+      bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+      bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+      bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+      return vec2(float(i) / float(n), float(bits) * 2.3283064365386963e-10);
+    }
+    void main() {
+      vec3 n = normalize(view_ray);
+      if (roughness == 0.0) {
+        color = vec4(textureLod(capture_texture, n, 0.0).rgb, 1.0);
+        return;
+      }
+      vec3 up = abs(n.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+      vec3 tangent_x = normalize(cross(up, n));
+      vec3 tangent_y = cross(n, tangent_x);
+      float a = roughness * roughness;
+      float texel_solid_angle = 4.0 * PI / (6.0 * source_size * source_size);
+      vec3 sum = vec3(0.0);
+      float weight = 0.0;
+      for (int i = 0; i < sample_count; ++i) {
+        vec2 xi = Hammersley(i, sample_count);
+        float phi = 2.0 * PI * xi.x;
+        float cos_theta = sqrt((1.0 - xi.y) / (1.0 + (a * a - 1.0) * xi.y));
+        float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        vec3 h = tangent_x * (sin_theta * cos(phi)) +
+            tangent_y * (sin_theta * sin(phi)) + n * cos_theta;
+        vec3 l = 2.0 * dot(n, h) * h - n;
+        float n_dot_l = dot(n, l);
+        if (n_dot_l > 0.0) {
+          float d = (a * a - 1.0) * cos_theta * cos_theta + 1.0;
+          float pdf = a * a / (PI * d * d) / 4.0;
+          float sample_solid_angle = 1.0 / (float(sample_count) * pdf);
+          float level =
+              max(0.5 * log2(sample_solid_angle / texel_solid_angle), 0.0);
+          sum += textureLod(capture_texture, l, level).rgb * n_dot_l;
+          weight += n_dot_l;
+        }
+      }
+      color = vec4(sum / max(weight, 1e-6), 1.0);
+    })";
+
+// Projects the captured radiance on the first 9 real spherical harmonics
+// (one coefficient per output texel), convolved with the clamped cosine (see
+// "An Efficient Representation for Irradiance Environment Maps", Ramamoorthi
+// and Hanrahan 2001).
+const char kIrradianceVertexShader[] = R"(
+    #version 330
+    layout(location = 0) in vec2 vertex;
+    void main() {
+      gl_Position = vec4(vertex, 0.0, 1.0);
+    })";
+
+const char kIrradianceFragmentShader[] = R"(
+    #version 330
+    uniform samplerCube capture_texture;
+    layout(location = 0) out vec4 coefficient;
+    const float PI = 3.14159265;
+    const int THETA_SAMPLE_COUNT = 32;
+    const int PHI_SAMPLE_COUNT = 64;
+    float Basis(int i, vec3 d) {
+      if (i == 0) return 0.282095;
+      if (i == 1) return 0.488603 * d.y;
+      if (i == 2) return 0.488603 * d.z;
+      if (i == 3) return 0.488603 * d.x;
+      if (i == 4) return 1.092548 * d.x * d.y;
+      if (i == 5) return 1.092548 * d.y * d.z;
+      if (i == 6) return 0.315392 * (3.0 * d.z * d.z - 1.0);
+      if (i == 7) return 1.092548 * d.x * d.z;
+      return 0.546274 * (d.x * d.x - d.y * d.y);
+    }
+    void main() {
+      int index = int(gl_FragCoord.x);
+      float dtheta = PI / float(THETA_SAMPLE_COUNT);
+      float dphi = 2.0 * PI / float(PHI_SAMPLE_COUNT);
+      vec3 sum = vec3(0.0);
+      for (int j = 0; j < THETA_SAMPLE_COUNT; ++j) {
+        float theta = (float(j) + 0.5) * dtheta;
+        float solid_angle = sin(theta) * dtheta * dphi;
+        for (int i = 0; i < PHI_SAMPLE_COUNT; ++i) {
+          float phi = (float(i) + 0.5) * dphi;
+          vec3 d = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi),
+              cos(theta));
+          sum += textureLod(capture_texture, d, 2.0).rgb * Basis(index, d) *
+              solid_angle;
+        }
+      }
+      float band = index == 0 ? PI : (index < 4 ? 2.0 * PI / 3.0 : PI / 4.0);
+      coefficient = vec4(sum * band, 1.0);
+    })";
+
+const char kEnvironmentShader[] = R"(
+    #version 330
+    uniform samplerCube sky_environment_texture;
+    uniform sampler2D sky_irradiance_texture;
+    uniform float sky_environment_max_level;
+    vec3 GetEnvironmentRadiance(vec3 direction, float roughness) {
+      return textureLod(sky_environment_texture, direction,
+          roughness * sky_environment_max_level).rgb;
+    }
+    vec3 GetEnvironmentIrradiance(vec3 n) {
+      vec3 c[9];
+      for (int i = 0; i < 9; ++i) {
+        c[i] = texelFetch(sky_irradiance_texture, ivec2(i, 0), 0).rgb;
+      }
+      return max(vec3(0.0),
+          c[0] * 0.282095 +
+          (c[1] * n.y + c[2] * n.z + c[3] * n.x) * 0.488603 +
+          (c[4] * n.x * n.y + c[5] * n.y * n.z + c[7] * n.x * n.z) * 1.092548 +
+          c[6] * 0.315392 * (3.0 * n.z * n.z - 1.0) +
+          c[8] * 0.546274 * (n.x * n.x - n.y * n.y));
+    })";
+
+GLuint NewCubemap(int size, int levels) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                  levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  uint64_t bytes = 0;
+  for (int level = 0; level < levels; ++level) {
+    const int level_size = std::max(size >> level, 1);
+    for (int face = 0; face < 6; ++face) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA16F,
+                   level_size, level_size, 0, GL_RGBA, GL_FLOAT, NULL);
+    }
+    bytes += 6 * GlTextureBytes(GL_RGBA16F, level_size, level_size);
+  }
+  TrackGpuTexture(texture, GPU_MEMORY_SCENE, bytes);
+  return texture;
+}
+
+GLuint NewIrradianceTexture() {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 9, 1, 0, GL_RGBA, GL_FLOAT, NULL);
+  TrackGpuTexture(texture, GPU_MEMORY_SCENE, GlTextureBytes(GL_RGBA32F, 9, 1));
+  return texture;
+}
+
+}  // anonymous namespace
+
+SkyEnvironment::SkyEnvironment(const Model1& model, bool use_luminance)
+    : model_(model), front_(0), step_(-1), invalidated_(true),
+      published_(false), programs_finished_(false),
+      camera_{{0.0f, 0.0f, 0.0f}}, sun_direction_{{0.0f, 0.0f, 1.0f}},
+      published_camera_{{0.0f, 0.0f, 0.0f}},
+      published_sun_direction_{{0.0f, 0.0f, 1.0f}} {
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+  int capture_levels = 1;
+  while ((kCubemapSize >> capture_levels) > 0) {
+    ++capture_levels;
+  }
+  capture_texture_ = NewCubemap(kCubemapSize, capture_levels);
+  for (int i = 0; i < 2; ++i) {
+    environment_textures_[i] = NewCubemap(kCubemapSize, kLevelCount);
+    irradiance_textures_[i] = NewIrradianceTexture();
+  }
+  glGenFramebuffers(1, &fbo_);
+
+  const std::string face_vertex_shader =
+      std::string("#version 330\n") + kCubeFaceDirectionGlsl +
+      kFaceVertexShader;
+  // The programs are only submitted here, and finished before the first
+  // update (see FinishPrograms).
+  pending_capture_program_ = SubmitProgram("sky environment capture program",
+      face_vertex_shader,
+      std::string("#version 330\n") +
+          (use_luminance ? "#define USE_LUMINANCE\n" : "") +
+          kCaptureFragmentShader,
+      {model.shader()});
+  pending_prefilter_program_ = SubmitProgram(
+      "sky environment prefilter program", face_vertex_shader,
+      std::string("#version 330\n") + kPrefilterFragmentShader);
+  pending_irradiance_program_ = SubmitProgram(
+      "sky environment irradiance program", kIrradianceVertexShader,
+      kIrradianceFragmentShader);
+  capture_program_ = pending_capture_program_.program;
+  prefilter_program_ = pending_prefilter_program_.program;
+  irradiance_program_ = pending_irradiance_program_.program;
+  shader_ = SubmitShader(GL_FRAGMENT_SHADER, kEnvironmentShader);
+}
+
+SkyEnvironment::~SkyEnvironment() {
+  if (!programs_finished_) {
+    FinishPrograms();
+  }
+  glDeleteShader(shader_);
+  glDeleteProgram(irradiance_program_);
+  glDeleteProgram(prefilter_program_);
+  glDeleteProgram(capture_program_);
+  glDeleteFramebuffers(1, &fbo_);
+  DeleteGpuTextures(2, irradiance_textures_);
+  DeleteGpuTextures(2, environment_textures_);
+  DeleteGpuTextures(1, &capture_texture_);
+}
+
+void SkyEnvironment::FinishPrograms() {
+  FinishProgram(&pending_capture_program_);
+  FinishProgram(&pending_prefilter_program_);
+  FinishProgram(&pending_irradiance_program_);
+  programs_finished_ = true;
+
+  glUseProgram(prefilter_program_);
+  glUniform1i(glGetUniformLocation(prefilter_program_, "capture_texture"),
+              kCaptureTextureUnit);
+  glUniform1f(glGetUniformLocation(prefilter_program_, "source_size"),
+              kCubemapSize);
+  glUniform1i(glGetUniformLocation(prefilter_program_, "sample_count"),
+              kPrefilterSampleCount);
+  glUseProgram(irradiance_program_);
+  glUniform1i(glGetUniformLocation(irradiance_program_, "capture_texture"),
+              kCaptureTextureUnit);
+  glUseProgram(0);
+}
+
+void SkyEnvironment::Update(const std::array<float, 3>& camera,
+                            const std::array<float, 3>& sun_direction) {
+  if (step_ < 0) {
+    const float cos_angle = sun_direction[0] * published_sun_direction_[0] +
+        sun_direction[1] * published_sun_direction_[1] +
+        sun_direction[2] * published_sun_direction_[2];
+    const float dx = camera[0] - published_camera_[0];
+    const float dy = camera[1] - published_camera_[1];
+    const float dz = camera[2] - published_camera_[2];
+    if (!invalidated_ && published_ &&
+        cos_angle >= std::cos(kSunDirectionThresholdRadians) &&
+        dx * dx + dy * dy + dz * dz <=
+            kCameraDistanceThreshold * kCameraDistanceThreshold) {
+      return;
+    }
+    if (!programs_finished_) {
+      FinishPrograms();
+    }
+    StartCycle(camera, sun_direction);
+  }
+
+  GLint old_viewport[4];
+  glGetIntegerv(GL_VIEWPORT, old_viewport);
+  GLint old_fbo;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+  if (step_ < kFirstPrefilterStep) {
+    CaptureFace(step_);
+  } else if (step_ < kProjectionStep) {
+    PrefilterFace(step_ - kFirstPrefilterStep);
+  } else {
+    ProjectIrradiance();
+  }
+
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, old_fbo);
+  glViewport(old_viewport[0], old_viewport[1], old_viewport[2],
+             old_viewport[3]);
+  glActiveTexture(GL_TEXTURE0);
+
+  if (++step_ > kProjectionStep) {
+    // The back buffers are complete: publish them.
+    front_ = 1 - front_;
+    published_ = true;
+    published_camera_ = camera_;
+    published_sun_direction_ = sun_direction_;
+    step_ = -1;
+  }
+}
+
+void SkyEnvironment::StartCycle(const std::array<float, 3>& camera,
+                                const std::array<float, 3>& sun_direction) {
+  // The inputs are latched for the whole cycle, so that all the faces match.
+  camera_ = camera;
+  sun_direction_ = sun_direction;
+  invalidated_ = false;
+  step_ = 0;
+}
+
+void SkyEnvironment::CaptureFace(int face) {
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, capture_texture_, 0);
+  glViewport(0, 0, kCubemapSize, kCubemapSize);
+  glUseProgram(capture_program_);
+  model_.setProgramUniforms(capture_program_, 0, 1, 2, 3);
+  glUniform1i(glGetUniformLocation(capture_program_, "face"), face);
+  glUniform3f(glGetUniformLocation(capture_program_, "camera"),
+              camera_[0], camera_[1], camera_[2]);
+  glUniform3f(glGetUniformLocation(capture_program_, "sun_direction"),
+              sun_direction_[0], sun_direction_[1], sun_direction_[2]);
+  quad_.Draw();
+}
+
+void SkyEnvironment::PrefilterFace(int face) {
+  glActiveTexture(GL_TEXTURE0 + kCaptureTextureUnit);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, capture_texture_);
+  if (face == 0) {
+    // The capture is complete, its mip chain is used to filter the samples.
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+  }
+  const GLuint environment_texture = environment_textures_[1 - front_];
+  glUseProgram(prefilter_program_);
+  glUniform1i(glGetUniformLocation(prefilter_program_, "face"), face);
+  for (int level = 0; level < kLevelCount; ++level) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, environment_texture, level);
+    glViewport(0, 0, kCubemapSize >> level, kCubemapSize >> level);
+    glUniform1f(glGetUniformLocation(prefilter_program_, "roughness"),
+                static_cast<float>(level) / (kLevelCount - 1));
+    quad_.Draw();
+  }
+}
+
+void SkyEnvironment::ProjectIrradiance() {
+  glActiveTexture(GL_TEXTURE0 + kCaptureTextureUnit);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, capture_texture_);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      irradiance_textures_[1 - front_], 0);
+  glViewport(0, 0, 9, 1);
+  glUseProgram(irradiance_program_);
+  quad_.Draw();
+}
+
+void SkyEnvironment::setProgramUniforms(
+    GLuint program,
+    GLuint environment_texture_unit,
+    GLuint irradiance_texture_unit) const {
+  glActiveTexture(GL_TEXTURE0 + environment_texture_unit);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, environment_textures_[front_]);
+  glUniform1i(glGetUniformLocation(program, "sky_environment_texture"),
+      environment_texture_unit);
+
+  glActiveTexture(GL_TEXTURE0 + irradiance_texture_unit);
+  glBindTexture(GL_TEXTURE_2D, irradiance_textures_[front_]);
+  glUniform1i(glGetUniformLocation(program, "sky_irradiance_texture"),
+      irradiance_texture_unit);
+
+  glUniform1f(glGetUniformLocation(program, "sky_environment_max_level"),
+      static_cast<float>(kLevelCount - 1));
+}
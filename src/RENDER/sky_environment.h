@@ -0,0 +1,89 @@
+#ifndef RENDER_SKY_ENVIRONMENT_H_
+#define RENDER_SKY_ENVIRONMENT_H_
+
+#include <glad/glad.h>
+
+#include <array>
+
+#include "RENDER/fullscreen_quad.h"
+#include "RENDER/shader_compile.h"
+
+class Model1;
+
+// A sky environment map for reflections and ambient lighting, rendered from
+// a Model1 atmosphere: a cubemap whose mip levels are prefiltered for
+// increasing GGX roughness, and the 9 spherical harmonics coefficients of the
+// sky irradiance (already convolved with the clamped cosine lobe).
+//
+// The work is spread over several frames: each call to Update does one step
+// (render one cubemap face, prefilter one face, or project onto the
+// spherical harmonics) into back buffers, which are published once complete.
+// A new cycle starts only when the sun or the camera moved by more than a
+// threshold since the published results, or after Invalidate (e.g. when the
+// model textures change), so that nothing is rendered while they are still.
+//
+// The shader returned by shader() provides the following functions (to
+// forward declare in the shaders using them), once linked and bound with
+// setProgramUniforms:
+//
+//   // Radiance of the sky in 'direction', blurred for the given roughness.
+//   vec3 GetEnvironmentRadiance(vec3 direction, float roughness);
+//   // Irradiance from the sky on a surface with the given normal.
+//   vec3 GetEnvironmentIrradiance(vec3 normal);
+//
+// Directions are in the Model1 reference frame, and values are in the unit
+// of GetSkyRadiance (or GetSkyLuminance if 'use_luminance').
+class SkyEnvironment {
+ public:
+  SkyEnvironment(const Model1& model, bool use_luminance);
+  SkyEnvironment(SkyEnvironment const&) = delete;
+  SkyEnvironment(SkyEnvironment&&) = delete;
+  ~SkyEnvironment();
+
+  // 'camera' is the capture position, relative to the planet center and in
+  // the model length unit. 'sun_direction' is a unit vector.
+  void Update(const std::array<float, 3>& camera,
+              const std::array<float, 3>& sun_direction);
+  // Forces a new update cycle (e.g. after the model textures changed).
+  void Invalidate() { invalidated_ = true; }
+  bool IsUpdating() const { return step_ >= 0; }
+
+  GLuint shader() const { return shader_; }
+  void setProgramUniforms(GLuint program, GLuint environment_texture_unit,
+                          GLuint irradiance_texture_unit) const;
+
+ private:
+  void FinishPrograms();
+  void StartCycle(const std::array<float, 3>& camera,
+                  const std::array<float, 3>& sun_direction);
+  void CaptureFace(int face);
+  void PrefilterFace(int face);
+  void ProjectIrradiance();
+
+  const Model1& model_;
+  GLuint capture_texture_;
+  GLuint environment_textures_[2];
+  GLuint irradiance_textures_[2];
+  int front_;
+  GLuint fbo_;
+  FullscreenQuad quad_;
+  PendingProgram pending_capture_program_;
+  PendingProgram pending_prefilter_program_;
+  PendingProgram pending_irradiance_program_;
+  GLuint capture_program_;
+  GLuint prefilter_program_;
+  GLuint irradiance_program_;
+  GLuint shader_;
+
+  // Index of the next step of the current cycle, or -1 if idle.
+  int step_;
+  bool invalidated_;
+  bool published_;
+  bool programs_finished_;
+  std::array<float, 3> camera_;
+  std::array<float, 3> sun_direction_;
+  std::array<float, 3> published_camera_;
+  std::array<float, 3> published_sun_direction_;
+};
+
+#endif  // RENDER_SKY_ENVIRONMENT_H_
@@ -31,6 +31,9 @@
 
 #include <vector>
 
+#include "RENDER/gl_trace_scope.h"
+#include "RENDER/gpu_memory_tracker.h"
+
 namespace {
 
 #include "font.inc"
@@ -69,6 +72,8 @@ void TextRenderer::SetupTexture() {
   glBindTexture(GL_TEXTURE_2D, font_texture_);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, font.atlas_width, font.atlas_height,
                0, GL_RED, GL_UNSIGNED_BYTE, font.data.data());
+  TrackGpuTexture(font_texture_, GPU_MEMORY_UI,
+                  GlTextureBytes(GL_RED, font.atlas_width, font.atlas_height));
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
@@ -87,6 +92,7 @@ void TextRenderer::SetupBuffers() {
     1, 1,
   };
   glBufferData(GL_ARRAY_BUFFER, sizeof vertices, vertices, GL_STATIC_DRAW);
+  TrackGpuBuffer(char_vbo_, GPU_MEMORY_UI, sizeof vertices);
   constexpr GLuint kAttribIndex = 0;
   constexpr int kCoordsPerVertex = 2;
   glVertexAttribPointer(kAttribIndex, kCoordsPerVertex, GL_FLOAT, false, 0, 0);
@@ -165,9 +171,9 @@ TextRenderer::TextRenderer() {
 
 TextRenderer::~TextRenderer() {
   glDeleteProgram(program_);
-  glDeleteBuffers(1, &char_vbo_);
+  DeleteGpuBuffers(1, &char_vbo_);
   glDeleteVertexArrays(1, &char_vao_);
-  glDeleteTextures(1, &font_texture_);
+  DeleteGpuTextures(1, &font_texture_);
 }
 
 void TextRenderer::SetColor(float r, float g, float b) {
@@ -182,6 +188,7 @@ void TextRenderer::SetColor(float r, float g, float b) {
 }
 
 void TextRenderer::DrawText(const std::string& text, int left, int top) {
+  TRACE_GL_SCOPE("TextRenderer::DrawText");
   GLint viewport[4];
   glGetIntegerv(GL_VIEWPORT, viewport);
 
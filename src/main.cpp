@@ -1,8 +1,16 @@
 #include <stdio.h>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "ENGINE/Engine.h"
+#include "CORE/frame_time_stats.h"
+#include "CORE/trace.h"
+#include "RENDER/shader_compile.h"
 
 
 #include <glad/glad.h>
@@ -10,16 +18,261 @@
 #include <memory>
 
 
+// Reads the poses of an image sequence, one per line: the view distance in
+// meters, the view zenith and azimuth, the sun zenith and azimuth (in radians)
+// and the exposure. Empty lines and lines starting with '#' are ignored.
+static bool readPoses(const std::string& path, std::vector<RenderPose>* poses)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+		std::istringstream values(line);
+		RenderPose pose;
+		if (!(values >> pose.viewDistanceMeters >> pose.viewZenithAngleRadians
+			>> pose.viewAzimuthAngleRadians >> pose.sunZenithAngleRadians
+			>> pose.sunAzimuthAngleRadians >> pose.exposure))
+		{
+			std::cerr << path << ": invalid pose '" << line << "'" << std::endl;
+			return false;
+		}
+		poses->push_back(pose);
+	}
+	return true;
+}
 
-int main()
+// The Engine settings of the command line, shared by all the modes.
+struct EngineOptions
 {
+	LutQuality lutQuality = LUT_QUALITY_DEFAULT;
+	bool lightShafts = false;
+	bool parameterAtlas = false;
+	double atlasDensityRange[2] = { 0.0, 0.0 };
+	double atlasMieRange[2] = { 0.0, 0.0 };
+};
+
+static void configureEngine(const EngineOptions& options, Engine* engine)
+{
+	engine->setLutQuality(options.lutQuality);
+	engine->setShadowMapLightShafts(options.lightShafts);
+	if (options.parameterAtlas)
+		engine->setParameterAtlas(options.atlasDensityRange, options.atlasMieRange);
+}
+
+// Parses 'count' numbers, which must be in increasing order pairwise (min, max).
+static bool parseRanges(char** argv, int count, double* values)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		char* end = nullptr;
+		values[i] = std::strtod(argv[i], &end);
+		if (end == argv[i] || *end != '\0')
+			return false;
+	}
+	for (int i = 0; i + 1 < count; i += 2)
+	{
+		if (!(values[i] < values[i + 1]))
+			return false;
+	}
+	return true;
+}
+
+static void printUsage(const char* program)
+{
+	std::cerr << "Usage: " << program << " [--lut-quality low|default|high|ultra]"
+		<< " [--light-shafts]"
+		<< " [--parameter-atlas DENSITY_MIN DENSITY_MAX MIE_MIN MIE_MAX]"
+		<< " [--trace TRACE_FILE] [--log-shader-compiles]"
+		<< " [--record-input EVENTS_FILE]"
+		<< std::endl << "       " << program
+		<< " [--lut-quality ...] [--trace ...] --replay-input EVENTS_FILE"
+		<< " [--frame-times CSV_FILE]"
+		<< std::endl << "       " << program
+		<< " [--lut-quality ...] [--trace ...] --render-sequence POSES_FILE OUTPUT_DIR"
+		<< " [WIDTH HEIGHT] [--hdr]" << std::endl;
+}
+
+static int renderSequence(const std::vector<std::string>& arguments,
+	const EngineOptions& options)
+{
+	std::vector<std::string> args;
+	bool hdr = false;
+	for (const std::string& argument : arguments)
+	{
+		if (argument == "--hdr")
+			hdr = true;
+		else
+			args.push_back(argument);
+	}
+	int width = 1280;
+	int height = 720;
+	if (args.size() == 4)
+	{
+		width = std::atoi(args[2].c_str());
+		height = std::atoi(args[3].c_str());
+	}
+	if ((args.size() != 2 && args.size() != 4) || width <= 0 || height <= 0)
+		return -1;
+	std::vector<RenderPose> poses;
+	if (!readPoses(args[0], &poses))
+	{
+		std::cerr << "Cannot read the poses from " << args[0] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Engine engine(false);
+	configureEngine(options, &engine);
+	if (!engine.renderSequence(poses, width, height, args[1], hdr))
+	{
+		std::cerr << "Cannot write the image sequence to " << args[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Replays recorded input events (see InputRecording.h), and prints the
+// statistics of the frame times. Also writes each frame time, in milliseconds,
+// on its own line of 'frameTimesPath' if not empty.
+static int replayInput(const std::string& eventsPath, const std::string& frameTimesPath,
+	const EngineOptions& options)
+{
+	Engine engine;
+	configureEngine(options, &engine);
+	std::vector<double> frameTimesMs;
+	if (!engine.replayInput(eventsPath, &frameTimesMs))
+	{
+		std::cerr << "Cannot read the input events from " << eventsPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << FormatFrameTimeSummary(SummarizeFrameTimes(frameTimesMs)) << std::endl;
+	if (!frameTimesPath.empty())
+	{
+		std::ofstream file(frameTimesPath);
+		file << "frame_ms" << std::endl;
+		for (double frameTimeMs : frameTimesMs)
+			file << frameTimeMs << std::endl;
+		if (!file)
+		{
+			std::cerr << "Cannot write " << frameTimesPath << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	EngineOptions options;
+	std::string recordInputPath;
+	std::string replayInputPath;
+	std::string frameTimesPath;
+	std::string tracePath;
+	bool sequence = false;
+	std::vector<std::string> sequenceArguments;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--lut-quality") == 0 && i + 1 < argc &&
+			ParseLutQuality(argv[i + 1], &options.lutQuality))
+		{
+			++i;
+		}
+		else if (std::strcmp(argv[i], "--record-input") == 0 && i + 1 < argc && !sequence)
+		{
+			recordInputPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--replay-input") == 0 && i + 1 < argc && !sequence)
+		{
+			replayInputPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--frame-times") == 0 && i + 1 < argc && !sequence)
+		{
+			frameTimesPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc && !sequence)
+		{
+			tracePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--light-shafts") == 0 && !sequence)
+		{
+			options.lightShafts = true;
+		}
+		else if (std::strcmp(argv[i], "--parameter-atlas") == 0 && i + 4 < argc && !sequence)
+		{
+			double ranges[4];
+			if (!parseRanges(argv + i + 1, 4, ranges))
+			{
+				printUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			options.parameterAtlas = true;
+			options.atlasDensityRange[0] = ranges[0];
+			options.atlasDensityRange[1] = ranges[1];
+			options.atlasMieRange[0] = ranges[2];
+			options.atlasMieRange[1] = ranges[3];
+			i += 4;
+		}
+		else if (std::strcmp(argv[i], "--log-shader-compiles") == 0 && !sequence)
+		{
+			SetShaderCompileLog(&std::cerr);
+		}
+		else if (std::strcmp(argv[i], "--render-sequence") == 0 && !sequence)
+		{
+			sequence = true;
+		}
+		else if (sequence)
+		{
+			sequenceArguments.push_back(argv[i]);
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+#if ATMOSPHERE_TRACING
+	SetTraceThreadName("main");
+#else
+	if (!tracePath.empty())
+		std::cerr << "Warning: this build has no trace zones (see ATMOSPHERE_TRACING)" << std::endl;
+#endif
 	try
 	{
-		Engine engine;
-		engine.run();
+		int result = EXIT_SUCCESS;
+		if (sequence)
+		{
+			result = renderSequence(sequenceArguments, options);
+			if (result < 0)
+			{
+				printUsage(argv[0]);
+				result = EXIT_FAILURE;
+			}
+		}
+		else if (!replayInputPath.empty())
+		{
+			result = replayInput(replayInputPath, frameTimesPath, options);
+		}
+		else
+		{
+			Engine engine;
+			configureEngine(options, &engine);
+			if (!recordInputPath.empty())
+				engine.recordInput(recordInputPath);
+			engine.run();
+		}
+		if (!tracePath.empty() && !WriteChromeTrace(tracePath))
+		{
+			std::cerr << "Cannot write the trace to " << tracePath << std::endl;
+			result = EXIT_FAILURE;
+		}
 		
 		glfwTerminate();
-		return EXIT_SUCCESS;		
+		return result;
 	}
 	catch (std::exception &e)
 	{
@@ -28,8 +281,3 @@ int main()
 		return EXIT_FAILURE;
 	}
 }
-
-
-
-
-
@@ -36,6 +36,26 @@ endif()
 
 set(CMAKE_DEBUG_POSTFIX "")
 
+# zlib (the copy bundled with assimp, unless installed)
+find_package(ZLIB)
+
+if(ZLIB_FOUND)
+	set(ZLIB_LIBRARY ${ZLIB_LIBRARIES})
+	set(ZLIB_INCLUDE_DIR ${ZLIB_INCLUDE_DIRS})
+else()
+	set(ZLIB_DIR "${THIRDPARTY_DIR}/assimp/contrib/zlib")
+	if(TARGET zlibstatic)
+		# Already built by assimp.
+		set(ZLIB_BINARY_DIR "${CMAKE_CURRENT_BINARY_DIR}/thirdparty/assimp/contrib/zlib")
+	else()
+		set(ZLIB_BINARY_DIR "${CMAKE_CURRENT_BINARY_DIR}/thirdparty/zlib")
+		add_subdirectory("${ZLIB_DIR}" "${ZLIB_BINARY_DIR}")
+	endif()
+
+	set(ZLIB_LIBRARY "zlibstatic")
+	set(ZLIB_INCLUDE_DIR "${ZLIB_DIR}" "${ZLIB_BINARY_DIR}")
+endif()
+
 # glfw
 find_library(GLFW_LIBRARY "glfw" "/usr/lib" "/usr/local/lib")
 find_path(GLFW_INCLUDE_DIR "glfw/glfw.h" "/usr/include" "/usr/local/include")
@@ -0,0 +1,195 @@
+// Precomputes the LUTs of a list of atmosphere parameter sets (see
+// parameter_sets.h), and writes one LUT file per set, named like in the LUT
+// cache of the application (so that the output directory can be used as its
+// cache directory). The sets are distributed over several worker processes,
+// each with its own offscreen OpenGL context:
+//
+//   atmosphere_bake [--jobs N] [--compress] [--quantize] [--profile]
+//                   [--output DIRECTORY] SETS_FILE
+
+#include <glad/glad.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CORE/job_pool.h"
+#include "MODEL/earth_model.h"
+#include "MODEL/lut_archive.h"
+#include "MODEL/lut_file.h"
+#include "RENDER/gpu_profiler.h"
+#include "common/offscreen_context.h"
+#include "common/parameter_sets.h"
+
+namespace {
+
+struct Options {
+  unsigned int jobs = 0;
+  bool compress = false;
+  bool quantize = false;
+  bool profile = false;
+  std::string output_directory = "luts";
+  std::string sets_file;
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: atmosphere_bake [--jobs N] [--compress] [--quantize] "
+               "[--profile] [--output DIRECTORY] SETS_FILE" << std::endl
+            << "  --jobs N     number of worker processes (default: one per "
+               "hardware thread)" << std::endl
+            << "  --compress   write compressed LUT archives (.lutz)"
+            << std::endl
+            << "  --quantize   store the LUTs in the smallest formats within "
+               "the default error budget" << std::endl
+            << "  --profile    print the GPU time of each precomputation stage"
+            << std::endl
+            << "  --output     output directory (default: luts)"
+            << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--jobs" && i + 1 < argc) {
+      options->jobs = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (argument == "--compress") {
+      options->compress = true;
+    } else if (argument == "--quantize") {
+      options->quantize = true;
+    } else if (argument == "--profile") {
+      options->profile = true;
+    } else if (argument == "--output" && i + 1 < argc) {
+      options->output_directory = argv[++i];
+    } else if (options->sets_file.empty() && argument[0] != '-') {
+      options->sets_file = argument;
+    } else {
+      return false;
+    }
+  }
+  return !options->sets_file.empty();
+}
+
+// Bakes the parameter sets of index worker, worker + worker_count, etc, and
+// returns the process exit status.
+int RunWorker(const Options& options,
+              const std::vector<EarthModelOptions>& parameter_sets,
+              unsigned int worker, unsigned int worker_count) {
+  OffscreenContext context;
+  if (!context.Init()) {
+    return EXIT_FAILURE;
+  }
+  // The compression threads of all the workers share the hardware threads.
+  const unsigned int hardware_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  JobPool job_pool(std::max(hardware_threads / worker_count, 1u));
+
+  int status = EXIT_SUCCESS;
+  for (size_t i = worker; i < parameter_sets.size(); i += worker_count) {
+    const auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<Model1> model(NewEarthModel(parameter_sets[i]));
+    GpuProfiler profiler;
+    profiler.BeginFrame();
+    model->Init(4, nullptr, options.profile ? &profiler : nullptr);
+    profiler.EndFrame();
+    std::vector<LutQuantizationReport> reports;
+    if (options.quantize) {
+      model->QuantizeLuts(LutErrorBudget(), &reports, &job_pool);
+    }
+    const std::string path = LutCachePath(options.output_directory, *model);
+    bool saved = model->SaveLuts(path);
+    if (saved && options.compress) {
+      LutFile luts;
+      saved = luts.Open(path) &&
+          LutArchive::Write(luts, path + "z", &job_pool);
+      luts.Close();
+      std::remove(path.c_str());
+    }
+    const std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+
+    // One write per line, to keep the lines of the workers separate.
+    std::ostringstream message;
+    message << "[" << i + 1 << "/" << parameter_sets.size() << "] "
+            << FormatParameterSet(parameter_sets[i]) << " -> "
+            << (saved ? path + (options.compress ? "z" : "") : "FAILED")
+            << " (" << seconds.count() << "s)" << std::endl;
+    for (const LutQuantizationReport& report : reports) {
+      message << "  " << FormatLutQuantizationReport(report) << std::endl;
+    }
+    // SaveLuts read the textures back, so the queries are complete.
+    profiler.Poll();
+    for (const GpuTiming& timing : profiler.timings()) {
+      message << std::string(2 * timing.depth + 2, ' ') << timing.name << ": "
+              << timing.milliseconds << " ms" << std::endl;
+    }
+    (saved ? std::cout : std::cerr) << message.str() << std::flush;
+    if (!saved) {
+      status = EXIT_FAILURE;
+    }
+  }
+  return status;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  std::vector<EarthModelOptions> parameter_sets;
+  if (!ReadParameterSets(options.sets_file, &parameter_sets)) {
+    return EXIT_FAILURE;
+  }
+  if (parameter_sets.empty()) {
+    return EXIT_SUCCESS;
+  }
+  mkdir(options.output_directory.c_str(), 0755);
+
+  unsigned int worker_count = options.jobs;
+  if (worker_count == 0) {
+    worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  worker_count = std::min(worker_count,
+                          static_cast<unsigned int>(parameter_sets.size()));
+  if (worker_count == 1) {
+    return RunWorker(options, parameter_sets, 0, 1);
+  }
+
+  // Each worker is a separate process, with its own context: the GL drivers
+  // (and llvmpipe) process the commands of a context sequentially.
+  std::vector<pid_t> workers;
+  for (unsigned int worker = 0; worker < worker_count; ++worker) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      _exit(RunWorker(options, parameter_sets, worker, worker_count));
+    } else if (pid < 0) {
+      std::cerr << "Cannot start worker " << worker << std::endl;
+      break;
+    }
+    workers.push_back(pid);
+  }
+  int status = workers.size() == worker_count ? EXIT_SUCCESS : EXIT_FAILURE;
+  for (pid_t pid : workers) {
+    int worker_status;
+    if (waitpid(pid, &worker_status, 0) != pid ||
+        !WIFEXITED(worker_status) ||
+        WEXITSTATUS(worker_status) != EXIT_SUCCESS) {
+      status = EXIT_FAILURE;
+    }
+  }
+  return status;
+}
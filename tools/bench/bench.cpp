@@ -0,0 +1,543 @@
+// Runs a fixed set of benchmark scenarios in an offscreen context, and reports
+// their wall time, GPU time and peak memory as JSON:
+//
+//   atmosphere_bench [--quality QUALITY] [--full-matrix] [--frames N]
+//       [--filter TEXT] [--output FILE] [--baseline FILE] [--threshold T]
+//
+// The "init" scenarios precompute the LUTs of the Earth model (see
+// earth_model.h) with 3 or 15 wavelengths, half or float precision, combined
+// or separate textures, and 2 to 8 scattering orders. By default each of these
+// options is varied alone, from a base configuration (3 wavelengths, half
+// precision, combined textures, 4 orders), and --full-matrix runs all their
+// combinations instead. The "frame" scenarios render the standard sky views
+// (see sky_view_renderer.h) at several resolutions, and report the mean time
+// per frame. With --baseline, the results are compared with those of a
+// previous run (with the same renderer), and the tool fails if a time or a
+// memory size of a scenario increased by more than the threshold (10% by
+// default).
+//
+// The wall times include the GPU work (glFinish). The GPU times are measured
+// with timer queries, and are 0 if these are not supported (software
+// renderers, which may defer the rendering to a later flush, can also report
+// much lower GPU than wall times for the frame scenarios). The peak memory is
+// the peak resident set size of the process during the scenario (Linux only,
+// 0 elsewhere), the peak GPU memory is the peak size of the textures and
+// buffers allocated during the scenario (see gpu_memory_tracker.h, which
+// includes the temporary textures of the precomputations), and the LUT memory
+// is the size of the precomputed textures.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MODEL/earth_model.h"
+#include "RENDER/gpu_memory_tracker.h"
+#include "RENDER/gpu_profiler.h"
+#include "common/offscreen_context.h"
+#include "common/parameter_sets.h"
+#include "common/sky_view_renderer.h"
+
+namespace {
+
+struct Resolution {
+  int width;
+  int height;
+};
+
+const Resolution kFrameResolutions[] = {
+    {640, 360}, {1280, 720}, {1920, 1080}};
+
+const unsigned int kScatteringOrders[] = {2, 3, 4, 5, 6, 7, 8};
+
+constexpr unsigned int kBaseScatteringOrders = 4;
+
+struct Scenario {
+  std::string name;
+  // The model to precompute, or to render with for the frame scenarios.
+  EarthModelOptions parameters;
+  unsigned int scattering_orders;
+  // The view and resolution of the frame scenarios (view is null for the
+  // init scenarios).
+  const SkyView* view = nullptr;
+  Resolution resolution;
+};
+
+struct Result {
+  std::string name;
+  double wall_ms = 0.0;
+  double gpu_ms = 0.0;
+  uint64_t peak_rss_bytes = 0;
+  uint64_t peak_gpu_bytes = 0;
+  uint64_t lut_bytes = 0;
+};
+
+struct Options {
+  LutQuality quality = LUT_QUALITY_DEFAULT;
+  bool full_matrix = false;
+  int frames = 20;
+  std::string filter;
+  std::string output_file;
+  std::string baseline_file;
+  double threshold = 0.1;
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: atmosphere_bench [--quality QUALITY] [--full-matrix] "
+               "[--frames N] [--filter TEXT] [--output FILE] "
+               "[--baseline FILE] [--threshold T]" << std::endl
+            << "  --quality      LUT quality of all the scenarios (default: "
+               "default, low is recommended with software rendering)"
+            << std::endl
+            << "  --full-matrix  run all the combinations of the init options"
+            << std::endl
+            << "  --frames N     frames per frame scenario (default: 20)"
+            << std::endl
+            << "  --filter       only run the scenarios whose name contains "
+               "TEXT" << std::endl
+            << "  --output       write the JSON results in FILE instead of "
+               "the standard output" << std::endl
+            << "  --baseline     compare the results with those in FILE"
+            << std::endl
+            << "  --threshold    maximum relative increase with respect to the "
+               "baseline (default: 0.1)" << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--quality" && i + 1 < argc) {
+      if (!ParseLutQuality(argv[++i], &options->quality)) {
+        return false;
+      }
+    } else if (argument == "--full-matrix") {
+      options->full_matrix = true;
+    } else if (argument == "--frames" && i + 1 < argc) {
+      options->frames = std::atoi(argv[++i]);
+    } else if (argument == "--filter" && i + 1 < argc) {
+      options->filter = argv[++i];
+    } else if (argument == "--output" && i + 1 < argc) {
+      options->output_file = argv[++i];
+    } else if (argument == "--baseline" && i + 1 < argc) {
+      options->baseline_file = argv[++i];
+    } else if (argument == "--threshold" && i + 1 < argc) {
+      options->threshold = std::atof(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options->frames >= 1 && options->threshold >= 0.0;
+}
+
+std::string InitScenarioName(const EarthModelOptions& parameters,
+                             unsigned int scattering_orders) {
+  std::ostringstream name;
+  name << "init wavelengths=" << parameters.num_precomputed_wavelengths
+       << " precision=" << (parameters.half_precision ? "half" : "float")
+       << " combined=" << (parameters.combined_textures ? 1 : 0)
+       << " orders=" << scattering_orders;
+  return name.str();
+}
+
+std::vector<Scenario> NewScenarios(const Options& options) {
+  EarthModelOptions base;
+  base.resolution = LutResolutionForQuality(options.quality);
+
+  std::vector<EarthModelOptions> init_parameters;
+  std::vector<unsigned int> init_orders;
+  const auto add_init = [&](unsigned int wavelengths, bool half_precision,
+                            bool combined_textures, unsigned int orders) {
+    EarthModelOptions parameters = base;
+    parameters.num_precomputed_wavelengths = wavelengths;
+    parameters.half_precision = half_precision;
+    parameters.combined_textures = combined_textures;
+    init_parameters.push_back(parameters);
+    init_orders.push_back(orders);
+  };
+  if (options.full_matrix) {
+    for (unsigned int wavelengths : {3u, 15u}) {
+      for (bool half_precision : {true, false}) {
+        for (bool combined_textures : {true, false}) {
+          for (unsigned int orders : kScatteringOrders) {
+            add_init(wavelengths, half_precision, combined_textures, orders);
+          }
+        }
+      }
+    }
+  } else {
+    add_init(3, true, true, kBaseScatteringOrders);
+    add_init(15, true, true, kBaseScatteringOrders);
+    add_init(3, false, true, kBaseScatteringOrders);
+    add_init(3, true, false, kBaseScatteringOrders);
+    for (unsigned int orders : kScatteringOrders) {
+      if (orders != kBaseScatteringOrders) {
+        add_init(3, true, true, orders);
+      }
+    }
+  }
+
+  std::vector<Scenario> scenarios;
+  for (size_t i = 0; i < init_parameters.size(); ++i) {
+    Scenario scenario;
+    scenario.name = InitScenarioName(init_parameters[i], init_orders[i]);
+    scenario.parameters = init_parameters[i];
+    scenario.scattering_orders = init_orders[i];
+    scenarios.push_back(scenario);
+  }
+  for (const Resolution& resolution : kFrameResolutions) {
+    for (const SkyView& view : StandardSkyViews()) {
+      Scenario scenario;
+      std::ostringstream name;
+      name << "frame " << resolution.width << "x" << resolution.height << " "
+           << view.name;
+      scenario.name = name.str();
+      scenario.parameters = base;
+      scenario.scattering_orders = kBaseScatteringOrders;
+      scenario.view = &view;
+      scenario.resolution = resolution;
+      scenarios.push_back(scenario);
+    }
+  }
+
+  if (!options.filter.empty()) {
+    scenarios.erase(
+        std::remove_if(scenarios.begin(), scenarios.end(),
+                       [&](const Scenario& scenario) {
+                         return scenario.name.find(options.filter) ==
+                             std::string::npos;
+                       }),
+        scenarios.end());
+  }
+  return scenarios;
+}
+
+// Resets the peak resident set size of the process to its current value
+// (Linux 4.0 or later).
+void ResetPeakMemory() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5" << std::endl;
+}
+
+// Returns the peak resident set size of the process, in bytes, or 0 if not
+// available.
+uint64_t PeakMemory() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    }
+  }
+  return 0;
+}
+
+// Returns the total time of the outermost scopes of the last profiled frame,
+// waiting for its results (the caller must have called glFinish).
+double ProfiledMilliseconds(GpuProfiler* profiler) {
+  profiler->Poll();
+  double milliseconds = 0.0;
+  for (const GpuTiming& timing : profiler->timings()) {
+    if (timing.depth == 0) {
+      milliseconds += timing.milliseconds;
+    }
+  }
+  return milliseconds;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  const std::chrono::duration<double, std::milli> milliseconds =
+      std::chrono::steady_clock::now() - start;
+  return milliseconds.count();
+}
+
+class Bench {
+ public:
+  explicit Bench(const Options& options) : options_(options) {}
+
+  Result Run(const Scenario& scenario);
+
+ private:
+  Result RunInit(const Scenario& scenario);
+  Result RunFrame(const Scenario& scenario);
+
+  const Options& options_;
+  // The model and renderer of the frame scenarios, created on first use and
+  // shared by the scenarios with the same parameters and resolution.
+  std::unique_ptr<Model1> frame_model_;
+  std::string frame_model_key_;
+  std::unique_ptr<SkyViewRenderer> renderer_;
+};
+
+Result Bench::Run(const Scenario& scenario) {
+  glFinish();
+  ResetPeakMemory();
+  ResetGpuMemoryPeaks();
+  Result result = scenario.view == nullptr ?
+      RunInit(scenario) : RunFrame(scenario);
+  result.name = scenario.name;
+  result.peak_rss_bytes = PeakMemory();
+  result.peak_gpu_bytes = GetTotalGpuMemoryUsage().peak_bytes;
+  return result;
+}
+
+Result Bench::RunInit(const Scenario& scenario) {
+  Result result;
+  GpuProfiler profiler;
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Model1> model(NewEarthModel(scenario.parameters));
+  profiler.BeginFrame();
+  model->Init(scenario.scattering_orders, nullptr, &profiler);
+  profiler.EndFrame();
+  glFinish();
+  result.wall_ms = MillisecondsSince(start);
+  result.gpu_ms = ProfiledMilliseconds(&profiler);
+  result.lut_bytes = model->LutMemorySize();
+  return result;
+}
+
+Result Bench::RunFrame(const Scenario& scenario) {
+  const std::string model_key = FormatParameterSet(scenario.parameters);
+  if (frame_model_ == nullptr || frame_model_key_ != model_key) {
+    renderer_.reset();
+    frame_model_.reset(NewEarthModel(scenario.parameters));
+    frame_model_->Init(scenario.scattering_orders);
+    frame_model_key_ = model_key;
+  }
+  if (renderer_ == nullptr ||
+      renderer_->width() != scenario.resolution.width ||
+      renderer_->height() != scenario.resolution.height) {
+    renderer_.reset(new SkyViewRenderer(scenario.resolution.width,
+                                        scenario.resolution.height));
+    renderer_->SetModel(*frame_model_);
+  }
+
+  // One warm up frame, to exclude the shader compilation and first use costs.
+  renderer_->Draw(*scenario.view);
+  glFinish();
+
+  Result result;
+  GpuProfiler profiler;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < options_.frames; ++i) {
+    profiler.BeginFrame();
+    profiler.BeginScope("frame");
+    renderer_->Draw(*scenario.view);
+    profiler.EndScope();
+    profiler.EndFrame();
+    // Waiting for each frame gives the GPU time of all of them, and avoids
+    // measuring a queue of frames which is not drained by a swap interval.
+    glFinish();
+    result.gpu_ms += ProfiledMilliseconds(&profiler);
+  }
+  result.wall_ms = MillisecondsSince(start) / options_.frames;
+  result.gpu_ms /= options_.frames;
+  result.lut_bytes = frame_model_->LutMemorySize();
+  return result;
+}
+
+// Escapes the characters which can't appear as is in a JSON string.
+std::string JsonString(const std::string& value) {
+  std::string escaped = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += ' ';
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped + "\"";
+}
+
+// Writes the results with one scenario per line, which ReadResults relies on.
+void WriteResults(const std::string& renderer, const Options& options,
+                  const std::vector<Result>& results, std::ostream& output) {
+  output << "{" << std::endl
+         << "  \"renderer\": " << JsonString(renderer) << "," << std::endl
+         << "  \"quality\": " << JsonString(LutQualityName(options.quality))
+         << "," << std::endl
+         << "  \"frames\": " << options.frames << "," << std::endl
+         << "  \"scenarios\": [" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    output << "    {\"name\": " << JsonString(result.name)
+           << ", \"wall_ms\": " << result.wall_ms
+           << ", \"gpu_ms\": " << result.gpu_ms
+           << ", \"peak_rss_bytes\": " << result.peak_rss_bytes
+           << ", \"peak_gpu_bytes\": " << result.peak_gpu_bytes
+           << ", \"lut_bytes\": " << result.lut_bytes << "}"
+           << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  output << "  ]" << std::endl << "}" << std::endl;
+}
+
+// Returns the string value of 'key' in 'line', or an empty string if absent.
+std::string JsonStringField(const std::string& line, const std::string& key) {
+  const std::string prefix = "\"" + key + "\": \"";
+  const size_t begin = line.find(prefix);
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  std::string value;
+  for (size_t i = begin + prefix.size(); i < line.size(); ++i) {
+    if (line[i] == '\\' && i + 1 < line.size()) {
+      value += line[++i];
+    } else if (line[i] == '"') {
+      break;
+    } else {
+      value += line[i];
+    }
+  }
+  return value;
+}
+
+// Returns the number value of 'key' in 'line', or 0 if absent.
+double JsonNumberField(const std::string& line, const std::string& key) {
+  const std::string prefix = "\"" + key + "\": ";
+  const size_t begin = line.find(prefix);
+  if (begin == std::string::npos) {
+    return 0.0;
+  }
+  return std::strtod(line.c_str() + begin + prefix.size(), nullptr);
+}
+
+// Reads a file written by WriteResults (not arbitrary JSON). Returns false if
+// the file can't be read.
+bool ReadResults(const std::string& path, std::string* renderer,
+                 std::map<std::string, Result>* results) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.find("\"renderer\": ") != std::string::npos) {
+      *renderer = JsonStringField(line, "renderer");
+    }
+    if (line.find("{\"name\": ") == std::string::npos) {
+      continue;
+    }
+    Result result;
+    result.name = JsonStringField(line, "name");
+    result.wall_ms = JsonNumberField(line, "wall_ms");
+    result.gpu_ms = JsonNumberField(line, "gpu_ms");
+    result.peak_rss_bytes =
+        static_cast<uint64_t>(JsonNumberField(line, "peak_rss_bytes"));
+    result.peak_gpu_bytes =
+        static_cast<uint64_t>(JsonNumberField(line, "peak_gpu_bytes"));
+    result.lut_bytes =
+        static_cast<uint64_t>(JsonNumberField(line, "lut_bytes"));
+    (*results)[result.name] = result;
+  }
+  return true;
+}
+
+// Prints the metrics of 'results' which exceed those of 'baseline' by more
+// than 'threshold', relatively, and returns their number. The metrics missing
+// from the baseline (e.g. GPU times without timer queries) are not compared.
+int CompareResults(const std::vector<Result>& results,
+                   const std::map<std::string, Result>& baseline,
+                   double threshold) {
+  int regressions = 0;
+  const auto compare = [&](const std::string& scenario, const char* metric,
+                           double value, double baseline_value) {
+    if (baseline_value > 0.0 && value > baseline_value * (1.0 + threshold)) {
+      std::cerr << std::setprecision(12) << "Regression in '" << scenario
+                << "': " << metric << " " << value << " (baseline "
+                << baseline_value << ", +"
+                << (value / baseline_value - 1.0) * 100.0 << "%)"
+                << std::endl;
+      ++regressions;
+    }
+  };
+  for (const Result& result : results) {
+    auto it = baseline.find(result.name);
+    if (it == baseline.end()) {
+      std::cerr << "No baseline for '" << result.name << "'" << std::endl;
+      continue;
+    }
+    const Result& reference = it->second;
+    compare(result.name, "wall_ms", result.wall_ms, reference.wall_ms);
+    compare(result.name, "gpu_ms", result.gpu_ms, reference.gpu_ms);
+    compare(result.name, "peak_rss_bytes",
+            static_cast<double>(result.peak_rss_bytes),
+            static_cast<double>(reference.peak_rss_bytes));
+    compare(result.name, "peak_gpu_bytes",
+            static_cast<double>(result.peak_gpu_bytes),
+            static_cast<double>(reference.peak_gpu_bytes));
+    compare(result.name, "lut_bytes", static_cast<double>(result.lut_bytes),
+            static_cast<double>(reference.lut_bytes));
+  }
+  return regressions;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  std::string baseline_renderer;
+  std::map<std::string, Result> baseline;
+  if (!options.baseline_file.empty() &&
+      !ReadResults(options.baseline_file, &baseline_renderer, &baseline)) {
+    std::cerr << "Cannot read " << options.baseline_file << std::endl;
+    return EXIT_FAILURE;
+  }
+  OffscreenContext context;
+  if (!context.Init()) {
+    return EXIT_FAILURE;
+  }
+  const std::string renderer = context.renderer();
+  if (!options.baseline_file.empty() && baseline_renderer != renderer) {
+    std::cerr << "Warning: the baseline was measured with '"
+              << baseline_renderer << "'" << std::endl;
+  }
+
+  const std::vector<Scenario> scenarios = NewScenarios(options);
+  Bench bench(options);
+  std::vector<Result> results;
+  for (size_t i = 0; i < scenarios.size(); ++i) {
+    const Result result = bench.Run(scenarios[i]);
+    std::cerr << "[" << i + 1 << "/" << scenarios.size() << "] "
+              << result.name << ": " << result.wall_ms << " ms, GPU "
+              << result.gpu_ms << " ms" << std::endl;
+    results.push_back(result);
+  }
+
+  if (options.output_file.empty()) {
+    WriteResults(renderer, options, results, std::cout);
+  } else {
+    std::ofstream output(options.output_file);
+    WriteResults(renderer, options, results, output);
+    if (!output) {
+      std::cerr << "Cannot write " << options.output_file << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!options.baseline_file.empty()) {
+    const int regressions =
+        CompareResults(results, baseline, options.threshold);
+    if (regressions > 0) {
+      std::cerr << regressions << " regression(s) above "
+                << options.threshold * 100.0 << "%" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+#include "app_scene_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <string>
+
+#include "CORE/trace.h"
+#include "MODEL/earth_model.h"
+#include "RENDER/light_shafts.h"
+#include "RENDER/shader_compile.h"
+
+namespace {
+
+#include "ENGINE/app.glsl.inc"
+
+constexpr double kPi = 3.1415926535897932;
+constexpr double kVerticalFovRadians = 50.0 / 180.0 * kPi;
+// Same as in Engine.cpp.
+constexpr double kSphereCenterZ = 1000.0;
+constexpr double kSphereRadius = 1000.0;
+
+// The vertex shader of the application.
+const char kVertexShader[] = R"(
+    #version 330
+    uniform mat4 model_from_view;
+    uniform mat4 view_from_clip;
+    layout(location = 0) in vec4 vertex;
+    out vec3 view_ray;
+    void main() {
+      view_ray =
+          (model_from_view * vec4((view_from_clip * vertex).xyz, 0.0)).xyz;
+      gl_Position = vertex;
+    })";
+
+GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  return shader;
+}
+
+}  // anonymous namespace
+
+const std::vector<ScenePose>& StandardScenePoses() {
+  static const std::vector<ScenePose> poses = {
+      {"day", 9000.0, 1.47, 0.0, 1.3, 3.0, 10.0},
+      {"sunset", 9000.0, 1.47, 0.0, 1.564, -3.0, 10.0},
+      {"sunset shadow", 7000.0, 1.57, 0.0, 1.54, -2.96, 10.0},
+      {"day shadow", 7000.0, 1.57, 0.0, 1.328, -3.044, 10.0},
+      {"ground", 9000.0, 1.39, 0.0, 1.2, 0.7, 10.0},
+      {"twilight", 9000.0, 1.5, 0.0, 1.628, 1.05, 200.0},
+      {"dusk", 7000.0, 1.43, 0.0, 1.57, 1.34, 40.0},
+      {"space", 2.7e6, 0.81, 0.0, 1.57, 2.0, 10.0},
+      {"orbit", 1.2e7, 0.0, 0.0, 0.93, -2.0, 10.0}};
+  return poses;
+}
+
+AppSceneRenderer::AppSceneRenderer(int width, int height,
+                                   const AppSceneOptions& options)
+    : width_(width), height_(height), model_(nullptr), program_(0) {
+  if (options.shadow_map_light_shafts) {
+    light_shafts_.reset(new LightShafts);
+  }
+  vertex_shader_ = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  // Same as in Engine::modelInit.
+  const std::string fragment_shader =
+      std::string("#version 330\n") +
+      (light_shafts_ ? "#define USE_SHADOW_MAP_LIGHT_SHAFTS\n" : "") +
+      "const float kLengthUnitInMeters = " +
+      std::to_string(kEarthLengthUnitInMeters) + ";\n" + demo_glsl;
+  fragment_shader_ =
+      CompileShader(GL_FRAGMENT_SHADER, fragment_shader.c_str());
+
+  glGenVertexArrays(1, &vertex_array_);
+  glBindVertexArray(vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  const GLfloat vertices[] = {
+      -1.0, -1.0, 0.0, 1.0,
+      +1.0, -1.0, 0.0, 1.0,
+      -1.0, +1.0, 0.0, 1.0,
+      +1.0, +1.0, 0.0, 1.0,
+  };
+  glBufferData(GL_ARRAY_BUFFER, sizeof vertices, vertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 4, GL_FLOAT, false, 0, 0);
+  glEnableVertexAttribArray(0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glGenTextures(1, &color_texture_);
+  glBindTexture(GL_TEXTURE_2D, color_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA,
+               GL_FLOAT, nullptr);
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color_texture_, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  // Same as in Engine::modelInit and Engine::handleReshapeEvent.
+  const float tan_fov_y = static_cast<float>(std::tan(kVerticalFovRadians / 2));
+  const float aspect_ratio = static_cast<float>(width_) / height_;
+  const float view_from_clip[16] = {
+      tan_fov_y * aspect_ratio, 0.0, 0.0, 0.0,
+      0.0, tan_fov_y, 0.0, 0.0,
+      0.0, 0.0, 0.0, -1.0,
+      0.0, 0.0, 1.0, 1.0};
+  std::copy(view_from_clip, view_from_clip + 16, view_from_clip_);
+}
+
+AppSceneRenderer::~AppSceneRenderer() {
+  glDeleteProgram(program_);
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteTextures(1, &color_texture_);
+  glDeleteBuffers(1, &vertex_buffer_);
+  glDeleteVertexArrays(1, &vertex_array_);
+  glDeleteShader(fragment_shader_);
+  glDeleteShader(vertex_shader_);
+}
+
+bool AppSceneRenderer::SetModel(const Model1& model) {
+  glDeleteProgram(program_);
+  const int64_t submit_begin_ns = TraceNanoseconds();
+  std::vector<GLuint> shaders = {vertex_shader_, fragment_shader_,
+                                 model.shader()};
+  if (light_shafts_) {
+    shaders.push_back(light_shafts_->shader());
+  }
+  program_ = glCreateProgram();
+  for (GLuint shader : shaders) {
+    glAttachShader(program_, shader);
+  }
+  glLinkProgram(program_);
+  for (GLuint shader : shaders) {
+    glDetachShader(program_, shader);
+  }
+  if (!FinishProgramLink(program_, shaders, "app scene", submit_begin_ns,
+                         TraceNanoseconds())) {
+    model_ = nullptr;
+    return false;
+  }
+  model_ = &model;
+
+  glUseProgram(program_);
+  glUniformMatrix4fv(glGetUniformLocation(program_, "view_from_clip"), 1,
+                     true, view_from_clip_);
+  glUniform3f(glGetUniformLocation(program_, "white_point"), 1.0f, 1.0f, 1.0f);
+  glUniform3f(glGetUniformLocation(program_, "earth_center"), 0.0f, 0.0f,
+              static_cast<float>(-kEarthBottomRadius /
+                                 kEarthLengthUnitInMeters));
+  glUniform2f(glGetUniformLocation(program_, "sun_size"),
+              static_cast<float>(std::tan(kEarthSunAngularRadius)),
+              static_cast<float>(std::cos(kEarthSunAngularRadius)));
+  glUseProgram(0);
+  return true;
+}
+
+void AppSceneRenderer::Draw(const ScenePose& pose) {
+  // Same as in Engine::renderScene.
+  const double cos_z = std::cos(pose.view_zenith_radians);
+  const double sin_z = std::sin(pose.view_zenith_radians);
+  const double cos_a = std::cos(pose.view_azimuth_radians);
+  const double sin_a = std::sin(pose.view_azimuth_radians);
+  const double ux[3] = {-sin_a, cos_a, 0.0};
+  const double uy[3] = {-cos_z * cos_a, -cos_z * sin_a, sin_z};
+  const double uz[3] = {sin_z * cos_a, sin_z * sin_a, cos_z};
+  const double l = pose.view_distance_meters / kEarthLengthUnitInMeters;
+  const float model_from_view[16] = {
+      static_cast<float>(ux[0]), static_cast<float>(uy[0]),
+      static_cast<float>(uz[0]), static_cast<float>(uz[0] * l),
+      static_cast<float>(ux[1]), static_cast<float>(uy[1]),
+      static_cast<float>(uz[1]), static_cast<float>(uz[1] * l),
+      static_cast<float>(ux[2]), static_cast<float>(uy[2]),
+      static_cast<float>(uz[2]), static_cast<float>(uz[2] * l),
+      0.0f, 0.0f, 0.0f, 1.0f};
+
+  const std::array<float, 3> sun_direction = {{
+      static_cast<float>(std::cos(pose.sun_azimuth_radians) *
+                         std::sin(pose.sun_zenith_radians)),
+      static_cast<float>(std::sin(pose.sun_azimuth_radians) *
+                         std::sin(pose.sun_zenith_radians)),
+      static_cast<float>(std::cos(pose.sun_zenith_radians))}};
+
+  // Same as in Engine::renderScene.
+  if (light_shafts_) {
+    const std::array<float, 3> camera = {{
+        model_from_view[3], model_from_view[7], model_from_view[11]}};
+    const std::array<float, 3> earth_center = {{
+        0.0f, 0.0f,
+        static_cast<float>(-kEarthBottomRadius / kEarthLengthUnitInMeters)}};
+    light_shafts_->BeginShadowPass(camera, sun_direction);
+    light_shafts_->DrawSphereOccluder(
+        {{0.0f, 0.0f,
+          static_cast<float>(kSphereCenterZ / kEarthLengthUnitInMeters)}},
+        static_cast<float>(kSphereRadius / kEarthLengthUnitInMeters));
+    light_shafts_->EndShadowPass();
+    light_shafts_->ComputeSamples(model_from_view, view_from_clip_,
+                                  earth_center, width_, height_);
+  }
+
+  glUseProgram(program_);
+  model_->setProgramUniforms(program_, 0, 1, 2, 3);
+  if (light_shafts_) {
+    light_shafts_->setProgramUniforms(program_, 4);
+  }
+  glUniform3f(glGetUniformLocation(program_, "camera"), model_from_view[3],
+              model_from_view[7], model_from_view[11]);
+  glUniformMatrix4fv(glGetUniformLocation(program_, "model_from_view"), 1,
+                     true, model_from_view);
+  glUniform3f(glGetUniformLocation(program_, "sun_direction"),
+              sun_direction[0], sun_direction[1], sun_direction[2]);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, width_, height_);
+  glDisable(GL_BLEND);
+  glBindVertexArray(vertex_array_);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+void AppSceneRenderer::Read(float* rgb) const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, width_, height_, GL_RGB, GL_FLOAT, rgb);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
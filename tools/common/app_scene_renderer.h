@@ -0,0 +1,77 @@
+#ifndef TOOLS_APP_SCENE_RENDERER_H_
+#define TOOLS_APP_SCENE_RENDERER_H_
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <vector>
+
+class LightShafts;
+class Model1;
+
+// A camera and sun configuration of the application scene, with the same
+// parameters as the Engine poses (see RenderPose): the camera looks at the
+// origin from the given distance and angles.
+struct ScenePose {
+  const char* name;
+  double view_distance_meters;
+  double view_zenith_radians;
+  double view_azimuth_radians;
+  double sun_zenith_radians;
+  double sun_azimuth_radians;
+  double exposure;
+};
+
+// The predefined views of the original demo: the sphere and its shadow in the
+// day, at sunset and at twilight, the ground, and the Earth from space.
+const std::vector<ScenePose>& StandardScenePoses();
+
+// The rendering options of the application scene, with the defaults of the
+// Engine.
+struct AppSceneOptions {
+  // Renders the sphere shadow with the shadow map light shafts (see
+  // LightShafts), instead of its analytic shadow volume.
+  bool shadow_map_light_shafts = false;
+};
+
+// Renders the application scene (the sphere on the ground, with the sky), with
+// the fragment shader of the application (app.glsl.inc) and its radiance API,
+// into a float framebuffer of its own. There is no white balance, nor any
+// post-processing.
+class AppSceneRenderer {
+ public:
+  AppSceneRenderer(int width, int height,
+                   const AppSceneOptions& options = AppSceneOptions());
+  AppSceneRenderer(AppSceneRenderer const&) = delete;
+  ~AppSceneRenderer();
+
+  // Links the rendering program with the shader of 'model'. Must be called
+  // before Draw, and again after the textures of the model change (Draw binds
+  // them to the texture units 0 to 3, and the light shafts to unit 4).
+  // Returns false, after printing the shader logs, if the link fails.
+  bool SetModel(const Model1& model);
+  // Renders 'pose' into the framebuffer. The exposure is not applied.
+  void Draw(const ScenePose& pose);
+  // Reads the RGB radiance values of the last pose drawn, with rows from
+  // bottom to top, into 'rgb' (of width() * height() * 3 floats).
+  void Read(float* rgb) const;
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+ private:
+  int width_;
+  int height_;
+  float view_from_clip_[16];
+  std::unique_ptr<LightShafts> light_shafts_;
+  const Model1* model_;
+  GLuint vertex_shader_;
+  GLuint fragment_shader_;
+  GLuint program_;
+  GLuint vertex_array_;
+  GLuint vertex_buffer_;
+  GLuint color_texture_;
+  GLuint framebuffer_;
+};
+
+#endif  // TOOLS_APP_SCENE_RENDERER_H_
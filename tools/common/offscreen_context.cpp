@@ -0,0 +1,124 @@
+#include "offscreen_context.h"
+
+#include <glad/glad.h>
+
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "RENDER/shader_compile.h"
+
+namespace {
+
+bool HasExtension(const char* extensions, const char* name) {
+  if (extensions == nullptr) {
+    return false;
+  }
+  const size_t length = std::strlen(name);
+  for (const char* p = std::strstr(extensions, name); p != nullptr;
+       p = std::strstr(p + length, name)) {
+    if ((p == extensions || p[-1] == ' ') &&
+        (p[length] == ' ' || p[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+EGLDisplay GetDisplay() {
+  const char* client_extensions =
+      eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display != nullptr &&
+      HasExtension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+    EGLDisplay display = get_platform_display(
+        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY) {
+      return display;
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+}  // anonymous namespace
+
+OffscreenContext::OffscreenContext()
+    : display_(EGL_NO_DISPLAY), context_(EGL_NO_CONTEXT) {
+}
+
+OffscreenContext::~OffscreenContext() {
+  if (context_ != EGL_NO_CONTEXT) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+  }
+  if (display_ != EGL_NO_DISPLAY) {
+    eglTerminate(display_);
+  }
+}
+
+bool OffscreenContext::Init() {
+  EGLDisplay display = GetDisplay();
+  EGLint major;
+  EGLint minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    std::cerr << "No EGL display" << std::endl;
+    return false;
+  }
+  display_ = display;
+  if (!HasExtension(eglQueryString(display, EGL_EXTENSIONS),
+                    "EGL_KHR_surfaceless_context")) {
+    std::cerr << "EGL_KHR_surfaceless_context is not supported" << std::endl;
+    return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    std::cerr << "The EGL display does not support OpenGL" << std::endl;
+    return false;
+  }
+
+  const EGLint config_attributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint config_count;
+  if (!eglChooseConfig(display, config_attributes, &config, 1,
+                       &config_count) || config_count == 0) {
+    std::cerr << "No EGL config for OpenGL" << std::endl;
+    return false;
+  }
+  const EGLint context_attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  EGLContext context =
+      eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  if (context == EGL_NO_CONTEXT) {
+    std::cerr << "Failed to create an OpenGL 3.3 core context" << std::endl;
+    return false;
+  }
+  context_ = context;
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    std::cerr << "Failed to make the OpenGL context current" << std::endl;
+    return false;
+  }
+  if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+    std::cerr << "Failed to initialize GLAD" << std::endl;
+    return false;
+  }
+  EnableParallelShaderCompile(
+      reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+  return true;
+}
+
+std::string OffscreenContext::renderer() const {
+  const GLubyte* renderer = glGetString(GL_RENDERER);
+  return renderer != nullptr ? reinterpret_cast<const char*>(renderer) : "";
+}
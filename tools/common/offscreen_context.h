@@ -0,0 +1,32 @@
+#ifndef TOOLS_OFFSCREEN_CONTEXT_H_
+#define TOOLS_OFFSCREEN_CONTEXT_H_
+
+#include <string>
+
+// An OpenGL 3.3 core context without any window, for the command line tools.
+// It uses EGL on the Mesa surfaceless platform when available (which needs no
+// display server nor GPU, e.g. with llvmpipe in a container), and on the
+// default EGL display otherwise. The context has no default framebuffer: the
+// tools render into their own framebuffer objects.
+class OffscreenContext {
+ public:
+  OffscreenContext();
+  OffscreenContext(OffscreenContext const&) = delete;
+  OffscreenContext(OffscreenContext&&) = delete;
+  ~OffscreenContext();
+
+  // Creates the context, makes it current on the calling thread, and loads
+  // the OpenGL functions. Returns false (after printing the reason) on
+  // failure.
+  bool Init();
+
+  // The GL_RENDERER string of the context.
+  std::string renderer() const;
+
+ private:
+  // EGLDisplay and EGLContext, to keep the EGL headers out of this one.
+  void* display_;
+  void* context_;
+};
+
+#endif  // TOOLS_OFFSCREEN_CONTEXT_H_
@@ -0,0 +1,176 @@
+#include "parameter_sets.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool ParseBool(const std::string& value, bool* result) {
+  if (value == "0" || value == "1") {
+    *result = value == "1";
+    return true;
+  }
+  return false;
+}
+
+bool ParseDouble(const std::string& value, double* result) {
+  std::istringstream stream(value);
+  return (stream >> *result) && stream.eof();
+}
+
+// Parses 'count' positive sizes separated by 'x', e.g. "256x64".
+bool ParseSizes(const std::string& value, int count, int* const* sizes) {
+  std::istringstream stream(value);
+  for (int i = 0; i < count; ++i) {
+    char separator = 'x';
+    if ((i > 0 && (!(stream >> separator) || separator != 'x')) ||
+        !(stream >> *sizes[i]) || *sizes[i] <= 0) {
+      return false;
+    }
+  }
+  return stream.eof();
+}
+
+bool ParsePair(const std::string& key, const std::string& value,
+               EarthModelOptions* options) {
+  if (key == "density") {
+    return ParseDouble(value, &options->density);
+  } else if (key == "top_radius") {
+    return ParseDouble(value, &options->top_radius);
+  } else if (key == "rayleigh") {
+    return ParseDouble(value, &options->rayleigh);
+  } else if (key == "mie") {
+    return ParseDouble(value, &options->mie);
+  } else if (key == "wavelengths") {
+    double wavelengths;
+    if (!ParseDouble(value, &wavelengths) || wavelengths < 1.0) {
+      return false;
+    }
+    options->num_precomputed_wavelengths =
+        static_cast<unsigned int>(wavelengths);
+    return true;
+  } else if (key == "precision") {
+    options->half_precision = value == "half";
+    return value == "half" || value == "float";
+  } else if (key == "combined") {
+    return ParseBool(value, &options->combined_textures);
+  } else if (key == "ozone") {
+    return ParseBool(value, &options->ozone);
+  } else if (key == "constant_solar_spectrum") {
+    return ParseBool(value, &options->constant_solar_spectrum);
+  } else if (key == "quality") {
+    LutQuality quality;
+    if (!ParseLutQuality(value, &quality)) {
+      return false;
+    }
+    options->resolution = LutResolutionForQuality(quality);
+    return true;
+  } else if (key == "transmittance") {
+    LutResolution& resolution = options->resolution;
+    int* const sizes[] = {
+        &resolution.transmittance_width, &resolution.transmittance_height};
+    return ParseSizes(value, 2, sizes);
+  } else if (key == "scattering") {
+    LutResolution& resolution = options->resolution;
+    int* const sizes[] = {
+        &resolution.scattering_r_size, &resolution.scattering_mu_size,
+        &resolution.scattering_mu_s_size, &resolution.scattering_nu_size};
+    return ParseSizes(value, 4, sizes) && resolution.IsValid();
+  } else if (key == "irradiance") {
+    LutResolution& resolution = options->resolution;
+    int* const sizes[] = {
+        &resolution.irradiance_width, &resolution.irradiance_height};
+    return ParseSizes(value, 2, sizes);
+  } else if (key == "samples") {
+    SampleCounts& counts = options->sample_counts;
+    int* const sizes[] = {
+        &counts.transmittance, &counts.single_scattering,
+        &counts.scattering_density, &counts.multiple_scattering,
+        &counts.indirect_irradiance};
+    return ParseSizes(value, 5, sizes) && counts.IsValid();
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+bool ParseParameterSet(const std::string& line, EarthModelOptions* options,
+                       std::string* error) {
+  std::istringstream tokens(line);
+  std::string token;
+  while (tokens >> token) {
+    const size_t equal = token.find('=');
+    if (equal == std::string::npos ||
+        !ParsePair(token.substr(0, equal), token.substr(equal + 1), options)) {
+      *error = token;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReadParameterSets(const std::string& path,
+                       std::vector<EarthModelOptions>* parameter_sets) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Cannot read " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  for (int line_number = 1; std::getline(file, line); ++line_number) {
+    std::istringstream tokens(line);
+    std::string token;
+    if (!(tokens >> token) || token[0] == '#') {
+      continue;
+    }
+    EarthModelOptions options;
+    std::string error;
+    if (!ParseParameterSet(line, &options, &error)) {
+      std::cerr << path << ":" << line_number << ": invalid parameter '"
+                << error << "'" << std::endl;
+      return false;
+    }
+    parameter_sets->push_back(options);
+  }
+  return true;
+}
+
+std::string FormatLutResolution(const LutResolution& resolution) {
+  std::ostringstream result;
+  result << "transmittance=" << resolution.transmittance_width << "x"
+         << resolution.transmittance_height
+         << " scattering=" << resolution.scattering_r_size << "x"
+         << resolution.scattering_mu_size << "x"
+         << resolution.scattering_mu_s_size << "x"
+         << resolution.scattering_nu_size
+         << " irradiance=" << resolution.irradiance_width << "x"
+         << resolution.irradiance_height;
+  return result.str();
+}
+
+std::string FormatSampleCounts(const SampleCounts& counts) {
+  std::ostringstream result;
+  result << "samples=" << counts.transmittance << "x"
+         << counts.single_scattering << "x" << counts.scattering_density
+         << "x" << counts.multiple_scattering << "x"
+         << counts.indirect_irradiance;
+  return result.str();
+}
+
+std::string FormatParameterSet(const EarthModelOptions& options) {
+  std::ostringstream result;
+  result.precision(10);
+  result << "density=" << options.density
+         << " top_radius=" << options.top_radius
+         << " rayleigh=" << options.rayleigh
+         << " mie=" << options.mie
+         << " wavelengths=" << options.num_precomputed_wavelengths
+         << " precision=" << (options.half_precision ? "half" : "float")
+         << " combined=" << options.combined_textures
+         << " ozone=" << options.ozone
+         << " constant_solar_spectrum=" << options.constant_solar_spectrum;
+  result << " " << FormatLutResolution(options.resolution);
+  result << " " << FormatSampleCounts(options.sample_counts);
+  return result.str();
+}
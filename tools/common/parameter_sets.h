@@ -0,0 +1,43 @@
+#ifndef TOOLS_PARAMETER_SETS_H_
+#define TOOLS_PARAMETER_SETS_H_
+
+#include <string>
+#include <vector>
+
+#include "MODEL/earth_model.h"
+
+// Reads a list of atmosphere parameter sets from a text file, with one set
+// per line, made of whitespace separated key=value pairs (the other
+// parameters keep the EarthModelOptions defaults):
+//
+//   # density x Mie presets
+//   density=0.5 mie=1.328e-3
+//   density=2.5 mie=9.328e-3 wavelengths=15 precision=float
+//
+// The keys are density, top_radius, rayleigh, mie, wavelengths, precision
+// (half or float), combined, ozone and constant_solar_spectrum (0 or 1), and
+// for the texture sizes quality (low, default, high or ultra), or
+// transmittance (WIDTHxHEIGHT), scattering (RxMUxMU_SxNU sizes) and irradiance
+// (WIDTHxHEIGHT), and for the integration sample counts samples (TxSxDxMxI,
+// for the transmittance, single scattering, scattering density, multiple
+// scattering and indirect irradiance, see SampleCounts). Later keys override
+// earlier ones. Empty lines and lines starting with '#' are ignored. Returns
+// false (after printing the line and the reason) on failure.
+bool ReadParameterSets(const std::string& path,
+                       std::vector<EarthModelOptions>* parameter_sets);
+
+// Parses one parameter set, in the above format (i.e. one line of a file,
+// without comments). Returns false, with the invalid pair in 'error', on
+// failure.
+bool ParseParameterSet(const std::string& line, EarthModelOptions* options,
+                       std::string* error);
+
+// The parameters of a set, in the above format.
+std::string FormatParameterSet(const EarthModelOptions& options);
+// The texture sizes only, with the transmittance, scattering and irradiance
+// keys.
+std::string FormatLutResolution(const LutResolution& resolution);
+// The integration sample counts only, with the samples key.
+std::string FormatSampleCounts(const SampleCounts& counts);
+
+#endif  // TOOLS_PARAMETER_SETS_H_
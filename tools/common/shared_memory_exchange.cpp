@@ -0,0 +1,133 @@
+#include "shared_memory_exchange.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+
+namespace {
+
+// The texture data starts on a page boundary, after the header.
+constexpr size_t kHeaderSize = 4096;
+
+}  // anonymous namespace
+
+struct SharedMemoryExchange::Header {
+  pthread_barrier_t barrier;
+  // The coordinator process, which created the barrier.
+  pid_t coordinator;
+};
+
+SharedMemoryExchange::SharedMemoryExchange(unsigned int shard_count,
+                                           unsigned int max_textures,
+                                           const LutResolution& resolution)
+    : shard_count_(shard_count), max_textures_(max_textures),
+      width_(resolution.scattering_width()),
+      height_(resolution.scattering_height()),
+      depth_(resolution.scattering_depth()),
+      layer_floats_(static_cast<size_t>(width_) * height_ * 4),
+      texture_floats_(layer_floats_ * depth_), shard_(0),
+      memory_size_(kHeaderSize +
+                   texture_floats_ * sizeof(float) * max_textures),
+      memory_(nullptr), read_framebuffer_(0) {
+  static_assert(sizeof(Header) <= kHeaderSize, "Header too large");
+  void* memory = mmap(nullptr, memory_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return;
+  }
+  memory_ = memory;
+  header()->coordinator = getpid();
+  pthread_barrierattr_t attributes;
+  pthread_barrierattr_init(&attributes);
+  pthread_barrierattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+  if (pthread_barrier_init(&header()->barrier, &attributes, shard_count) != 0) {
+    munmap(memory_, memory_size_);
+    memory_ = nullptr;
+  }
+  pthread_barrierattr_destroy(&attributes);
+}
+
+SharedMemoryExchange::~SharedMemoryExchange() {
+  if (read_framebuffer_ != 0) {
+    glDeleteFramebuffers(1, &read_framebuffer_);
+  }
+  if (memory_ != nullptr) {
+    // Each process has its own mapping, but only the coordinator destroys the
+    // barrier (after all the shards exited).
+    if (header()->coordinator == getpid()) {
+      pthread_barrier_destroy(&header()->barrier);
+    }
+    munmap(memory_, memory_size_);
+  }
+}
+
+SharedMemoryExchange::Header* SharedMemoryExchange::header() const {
+  return static_cast<Header*>(memory_);
+}
+
+float* SharedMemoryExchange::texture_layers(unsigned int texture) const {
+  return reinterpret_cast<float*>(static_cast<char*>(memory_) + kHeaderSize) +
+      texture * texture_floats_;
+}
+
+unsigned int SharedMemoryExchange::shard_layer_begin(unsigned int shard) const {
+  return depth_ * shard / shard_count_;
+}
+
+unsigned int SharedMemoryExchange::layer_begin() const {
+  return shard_layer_begin(shard_);
+}
+
+unsigned int SharedMemoryExchange::layer_end() const {
+  return shard_layer_begin(shard_ + 1);
+}
+
+void SharedMemoryExchange::Exchange(const std::vector<GLuint>& textures) {
+  assert(textures.size() <= max_textures_);
+  GLint previous_read_framebuffer;
+  GLint previous_texture;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_framebuffer);
+  glGetIntegerv(GL_TEXTURE_BINDING_3D, &previous_texture);
+  if (read_framebuffer_ == 0) {
+    glGenFramebuffers(1, &read_framebuffer_);
+  }
+
+  // Publish the layers of this shard.
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer_);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  for (unsigned int i = 0; i < textures.size(); ++i) {
+    for (unsigned int layer = layer_begin(); layer < layer_end(); ++layer) {
+      glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                textures[i], 0, layer);
+      glReadPixels(0, 0, width_, height_, GL_RGBA, GL_FLOAT,
+                   texture_layers(i) + layer * layer_floats_);
+    }
+  }
+  glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+  pthread_barrier_wait(&header()->barrier);
+
+  // Upload the layers of the other shards, before and after those of this
+  // one.
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  for (unsigned int i = 0; i < textures.size(); ++i) {
+    glBindTexture(GL_TEXTURE_3D, textures[i]);
+    if (layer_begin() > 0) {
+      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, width_, height_,
+                      layer_begin(), GL_RGBA, GL_FLOAT, texture_layers(i));
+    }
+    if (layer_end() < static_cast<unsigned int>(depth_)) {
+      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, layer_end(), width_, height_,
+                      depth_ - layer_end(), GL_RGBA, GL_FLOAT,
+                      texture_layers(i) + layer_end() * layer_floats_);
+    }
+  }
+  // glTexSubImage3D copies the data before returning, so the mapping can be
+  // overwritten as soon as all the shards are here.
+  pthread_barrier_wait(&header()->barrier);
+
+  glBindTexture(GL_TEXTURE_3D, previous_texture);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_read_framebuffer);
+}
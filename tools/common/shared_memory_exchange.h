@@ -0,0 +1,54 @@
+#ifndef TOOLS_SHARED_MEMORY_EXCHANGE_H_
+#define TOOLS_SHARED_MEMORY_EXCHANGE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "MODEL/model1.h"
+
+// A LayerExchange between forked processes, through a shared memory mapping
+// created by the coordinator process before forking the shard processes. The
+// mapping holds a process shared barrier and, for each exchanged texture, all
+// its layers in RGBA float format. In Exchange, each shard reads back its own
+// layers into the mapping, waits for the other shards, uploads their layers,
+// and waits again before the mapping can be reused.
+class SharedMemoryExchange : public LayerExchange {
+ public:
+  // Maps the shared memory for 'shard_count' shards, exchanging at most
+  // 'max_textures' scattering textures of the given resolution at once.
+  SharedMemoryExchange(unsigned int shard_count, unsigned int max_textures,
+                       const LutResolution& resolution);
+  SharedMemoryExchange(SharedMemoryExchange const&) = delete;
+  SharedMemoryExchange(SharedMemoryExchange&&) = delete;
+  ~SharedMemoryExchange() override;
+
+  bool is_valid() const { return memory_ != nullptr; }
+  // Selects the shard of the calling process, after the fork.
+  void SetShard(unsigned int shard) { shard_ = shard; }
+
+  unsigned int layer_begin() const override;
+  unsigned int layer_end() const override;
+  void Exchange(const std::vector<GLuint>& textures) override;
+
+ private:
+  struct Header;
+
+  Header* header() const;
+  float* texture_layers(unsigned int texture) const;
+  unsigned int shard_layer_begin(unsigned int shard) const;
+
+  unsigned int shard_count_;
+  unsigned int max_textures_;
+  int width_;
+  int height_;
+  int depth_;
+  size_t layer_floats_;
+  size_t texture_floats_;
+  unsigned int shard_;
+  size_t memory_size_;
+  void* memory_;
+  // The framebuffer used to read back the layers, in the shard's context.
+  GLuint read_framebuffer_;
+};
+
+#endif  // TOOLS_SHARED_MEMORY_EXCHANGE_H_
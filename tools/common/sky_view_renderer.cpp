@@ -0,0 +1,189 @@
+#include "sky_view_renderer.h"
+
+#include <cmath>
+
+#include "MODEL/earth_model.h"
+
+namespace {
+
+constexpr double kPi = 3.1415926535897932;
+
+const char kVertexShader[] = R"(
+    #version 330
+    void main() {
+      vec2 vertex = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+      gl_Position = vec4(vertex, 0.0, 1.0);
+    })";
+
+// The luminance API is available with any number of precomputed wavelengths.
+// The ground is a lambertian sphere, with a constant albedo.
+const char kFragmentShader[] = R"(
+    #version 330
+    uniform vec3 camera;
+    uniform vec3 sun_direction;
+    uniform vec3 camera_forward;
+    uniform vec3 camera_right;
+    uniform vec3 camera_up;
+    uniform vec2 tan_half_fov;
+    uniform vec2 viewport_size;
+    uniform float bottom_radius;
+    layout(location = 0) out vec4 color;
+    const float PI = 3.14159265;
+    const float GROUND_ALBEDO = 0.1;
+    vec3 GetSkyLuminance(vec3 camera, vec3 view_ray, float shadow_length,
+        vec3 sun_direction, out vec3 transmittance);
+    vec3 GetSkyLuminanceToPoint(vec3 camera, vec3 point, float shadow_length,
+        vec3 sun_direction, out vec3 transmittance);
+    vec3 GetSunAndSkyIlluminance(vec3 p, vec3 normal, vec3 sun_direction,
+        out vec3 sky_irradiance);
+    void main() {
+      vec2 p = gl_FragCoord.xy / viewport_size * 2.0 - 1.0;
+      vec3 view_ray = normalize(camera_forward +
+          p.x * tan_half_fov.x * camera_right +
+          p.y * tan_half_fov.y * camera_up);
+      float r = length(camera);
+      float rmu = dot(camera, view_ray);
+      float discriminant =
+          rmu * rmu - r * r + bottom_radius * bottom_radius;
+      float distance_to_ground = -rmu - sqrt(max(discriminant, 0.0));
+      vec3 transmittance;
+      if (discriminant >= 0.0 && distance_to_ground > 0.0) {
+        vec3 point = camera + distance_to_ground * view_ray;
+        vec3 sky_illuminance;
+        vec3 sun_illuminance = GetSunAndSkyIlluminance(
+            point, normalize(point), sun_direction, sky_illuminance);
+        vec3 in_scatter = GetSkyLuminanceToPoint(
+            camera, point, 0.0, sun_direction, transmittance);
+        color = vec4(GROUND_ALBEDO / PI * (sun_illuminance + sky_illuminance) *
+            transmittance + in_scatter, 1.0);
+      } else {
+        color = vec4(GetSkyLuminance(
+            camera, view_ray, 0.0, sun_direction, transmittance), 1.0);
+      }
+    })";
+
+GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  return shader;
+}
+
+}  // anonymous namespace
+
+const std::vector<SkyView>& StandardSkyViews() {
+  static const std::vector<SkyView> views = {
+      {"day horizon", 0.01, 30.0, 5.0, 90.0, 90.0},
+      {"sunset", 0.01, 88.0, 10.0, 0.0, 90.0},
+      {"twilight", 0.01, 96.0, 10.0, 0.0, 90.0},
+      {"zenith", 0.01, 60.0, 89.0, 0.0, 120.0},
+      {"aerial", 10.0, 45.0, -30.0, 150.0, 90.0},
+      {"orbit", 300.0, 80.0, -15.0, 90.0, 60.0}};
+  return views;
+}
+
+SkyViewRenderer::SkyViewRenderer(int width, int height)
+    : width_(width), height_(height), model_(nullptr), program_(0) {
+  vertex_shader_ = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  fragment_shader_ = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+  // The vertices are generated from gl_VertexID, but a core profile context
+  // needs a vertex array object to draw.
+  glGenVertexArrays(1, &vertex_array_);
+
+  glGenTextures(1, &color_texture_);
+  glBindTexture(GL_TEXTURE_2D, color_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA,
+               GL_FLOAT, nullptr);
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color_texture_, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+SkyViewRenderer::~SkyViewRenderer() {
+  glDeleteProgram(program_);
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteTextures(1, &color_texture_);
+  glDeleteVertexArrays(1, &vertex_array_);
+  glDeleteShader(fragment_shader_);
+  glDeleteShader(vertex_shader_);
+}
+
+void SkyViewRenderer::SetModel(const Model1& model) {
+  glDeleteProgram(program_);
+  program_ = glCreateProgram();
+  glAttachShader(program_, vertex_shader_);
+  glAttachShader(program_, fragment_shader_);
+  glAttachShader(program_, model.shader());
+  glLinkProgram(program_);
+  glDetachShader(program_, vertex_shader_);
+  glDetachShader(program_, fragment_shader_);
+  glDetachShader(program_, model.shader());
+  model_ = &model;
+
+  glUseProgram(program_);
+  glUniform1f(
+      glGetUniformLocation(program_, "bottom_radius"),
+      static_cast<float>(kEarthBottomRadius / kEarthLengthUnitInMeters));
+  glUniform2f(glGetUniformLocation(program_, "viewport_size"),
+              static_cast<float>(width_), static_cast<float>(height_));
+  glUseProgram(0);
+}
+
+void SkyViewRenderer::Draw(const SkyView& view) {
+  const double sun_zenith = view.sun_zenith_degrees * kPi / 180.0;
+  const double elevation = view.view_elevation_degrees * kPi / 180.0;
+  const double azimuth = view.view_azimuth_degrees * kPi / 180.0;
+  const double forward[3] = {std::cos(elevation) * std::cos(azimuth),
+                             std::cos(elevation) * std::sin(azimuth),
+                             std::sin(elevation)};
+  // right = normalize(cross(forward, z)), and up = cross(right, forward).
+  const double length = std::cos(elevation);
+  const double right[3] = {forward[1] / length, -forward[0] / length, 0.0};
+  const double up[3] = {right[1] * forward[2],
+                        -right[0] * forward[2],
+                        right[0] * forward[1] - right[1] * forward[0]};
+  const double tan_half_fov =
+      std::tan(view.horizontal_fov_degrees * kPi / 360.0);
+  const double bottom_radius = kEarthBottomRadius / kEarthLengthUnitInMeters;
+
+  glUseProgram(program_);
+  model_->setProgramUniforms(program_, 0, 1, 2, 3);
+  glUniform3f(glGetUniformLocation(program_, "camera"), 0.0f, 0.0f,
+              static_cast<float>(bottom_radius + view.altitude_km));
+  glUniform3f(glGetUniformLocation(program_, "sun_direction"),
+              static_cast<float>(std::sin(sun_zenith)), 0.0f,
+              static_cast<float>(std::cos(sun_zenith)));
+  glUniform3f(glGetUniformLocation(program_, "camera_forward"),
+              static_cast<float>(forward[0]), static_cast<float>(forward[1]),
+              static_cast<float>(forward[2]));
+  glUniform3f(glGetUniformLocation(program_, "camera_right"),
+              static_cast<float>(right[0]), static_cast<float>(right[1]),
+              static_cast<float>(right[2]));
+  glUniform3f(glGetUniformLocation(program_, "camera_up"),
+              static_cast<float>(up[0]), static_cast<float>(up[1]),
+              static_cast<float>(up[2]));
+  glUniform2f(glGetUniformLocation(program_, "tan_half_fov"),
+              static_cast<float>(tan_half_fov),
+              static_cast<float>(tan_half_fov * height_ / width_));
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, width_, height_);
+  glDisable(GL_BLEND);
+  glBindVertexArray(vertex_array_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glUseProgram(0);
+}
+
+void SkyViewRenderer::Read(float* rgb) const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, width_, height_, GL_RGB, GL_FLOAT, rgb);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
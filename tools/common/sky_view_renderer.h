@@ -0,0 +1,64 @@
+#ifndef TOOLS_SKY_VIEW_RENDERER_H_
+#define TOOLS_SKY_VIEW_RENDERER_H_
+
+#include <glad/glad.h>
+
+#include <vector>
+
+class Model1;
+
+// A camera, in a frame whose origin is at the planet center, with the camera
+// on the z axis and the sun in the x-z plane. The view direction is given by
+// its elevation above the local horizon, and its azimuth from the sun.
+struct SkyView {
+  const char* name;
+  double altitude_km;
+  double sun_zenith_degrees;
+  double view_elevation_degrees;
+  double view_azimuth_degrees;
+  double horizontal_fov_degrees;
+};
+
+// Views covering the parts of the LUTs which matter the most: the horizon
+// (where the scattering texture has its largest gradients), the sunset and
+// twilight (sun zenith angles near and below 90 degrees), the ground (seen
+// with aerial perspective, which also uses the irradiance texture), and the
+// limb seen from space.
+const std::vector<SkyView>& StandardSkyViews();
+
+// Renders the sky and the ground of an Earth model (see earth_model.h), with
+// its luminance API, into a float framebuffer of its own. The ground is a
+// lambertian sphere with a constant albedo. There is no sun disk, nor any
+// post-processing.
+class SkyViewRenderer {
+ public:
+  SkyViewRenderer(int width, int height);
+  SkyViewRenderer(SkyViewRenderer const&) = delete;
+  ~SkyViewRenderer();
+
+  // Links the rendering program with the shader of 'model'. Must be called
+  // before Draw, and again after the textures of the model change (Draw binds
+  // them to the texture units 0 to 3).
+  void SetModel(const Model1& model);
+  // Renders 'view' into the framebuffer.
+  void Draw(const SkyView& view);
+  // Reads the RGB luminance values of the last view drawn, with rows from
+  // bottom to top, into 'rgb' (of width() * height() * 3 floats).
+  void Read(float* rgb) const;
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+ private:
+  int width_;
+  int height_;
+  const Model1* model_;
+  GLuint vertex_shader_;
+  GLuint fragment_shader_;
+  GLuint program_;
+  GLuint vertex_array_;
+  GLuint color_texture_;
+  GLuint framebuffer_;
+};
+
+#endif  // TOOLS_SKY_VIEW_RENDERER_H_
@@ -0,0 +1,467 @@
+// Renders a fixed set of views of the application scene (see
+// app_scene_renderer.h) with the default Earth model, compares them with
+// reference images, and measures the precomputation and rendering times at
+// the same time. This checks the changes to the model shaders, to the
+// precomputations, to the LUT quantization or to the application shader for
+// both correctness and speed. As in the Engine, the LUTs are quantized after
+// the precomputation (see Model1::QuantizeLuts), and each view is rendered
+// with the analytic sphere shadow of the default configuration, and again
+// with the optional shadow map light shafts:
+//
+//   atmosphere_regress --references DIR [--update] [--quality QUALITY]
+//       [--size WxH] [--frames N] [--channel-tolerance T]
+//       [--outlier-fraction F] [--max-delta-e E] [--time-threshold T]
+//       [--output DIR]
+//
+// With --update, the rendered images and the timings are written in DIR
+// instead (created if needed), as one PFM file per view and a timings.txt
+// file. The references should be made with the Mesa llvmpipe software
+// renderer (e.g. on the EGL surfaceless platform, or with
+// LIBGL_ALWAYS_SOFTWARE=1), whose results do not depend on the GPU, and
+// compared with the same Mesa version. For this reason they are not stored in
+// the repository: make them from a known good revision, e.g.
+//
+//   git checkout <known good revision> && <build>
+//   atmosphere_regress --references ~/atmosphere_references --update
+//   git checkout <revision to test> && <build>
+//   atmosphere_regress --references ~/atmosphere_references
+//
+// The 'regress' ctest test runs the same comparison against the references
+// of the ATMOSPHERE_REGRESS_REFERENCES CMake cache variable, if set.
+// Otherwise, the 'regress_references' test first makes them in the build
+// directory with the tested build itself, so that 'regress' only checks that
+// the results are reproducible (and that the shaders compile and link). In
+// both cases ctest does not compare the timings, which depend on the machine
+// load.
+//
+// A view passes if:
+// - at most a fraction F (default 0.001) of its radiance values differ from
+//   the reference ones by more than T (default 0.02) relatively, or by more
+//   than T times 1% of the mean reference value for the darkest values,
+// - the 99th percentile of the CIE76 color difference between the view and
+//   the reference, both tonemapped with the exposure of the view (as in the
+//   original demo), is at most E (default 1, a barely perceptible
+//   difference).
+// The timings pass if the precomputation time and the mean frame time of each
+// view are at most T (default 0.25) relatively larger than the reference
+// ones. They are not compared if T is negative. The tool exits with a failure
+// status if any view or timing fails. With --output, the failing views are
+// written in DIR, with an image of their color differences.
+
+#include <glad/glad.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MODEL/earth_model.h"
+#include "MODEL/lut_quantization.h"
+#include "RENDER/image_file.h"
+#include "common/app_scene_renderer.h"
+#include "common/offscreen_context.h"
+#include "common/parameter_sets.h"
+
+namespace {
+
+constexpr unsigned int kScatteringOrders = 4;
+constexpr const char* kTimingsFile = "timings.txt";
+constexpr const char* kPrecomputeTiming = "precompute";
+constexpr const char* kQuantizeTiming = "quantize";
+
+// The rendering configurations of the views, with the suffix of their names.
+struct Scenario {
+  const char* suffix;
+  AppSceneOptions options;
+};
+
+std::vector<Scenario> Scenarios() {
+  Scenario light_shafts = {" light shafts", AppSceneOptions()};
+  light_shafts.options.shadow_map_light_shafts = true;
+  return {{"", AppSceneOptions()}, light_shafts};
+}
+
+// A view of the scene, in one scenario.
+struct View {
+  std::string name;
+  const ScenePose* pose;
+  std::vector<float> image;
+};
+
+struct Options {
+  std::string references_directory;
+  bool update = false;
+  LutQuality quality = LUT_QUALITY_LOW;
+  int width = 320;
+  int height = 180;
+  int frames = 5;
+  double channel_tolerance = 0.02;
+  double outlier_fraction = 0.001;
+  double max_delta_e = 1.0;
+  double time_threshold = 0.25;
+  std::string output_directory;
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: atmosphere_regress --references DIR [--update] "
+               "[--quality QUALITY] [--size WxH] [--frames N] "
+               "[--channel-tolerance T] [--outlier-fraction F] "
+               "[--max-delta-e E] [--time-threshold T] [--output DIR]"
+            << std::endl
+            << "  --references         directory of the reference images and "
+               "timings" << std::endl
+            << "  --update             write the references instead of "
+               "comparing with them" << std::endl
+            << "  --quality            LUT quality (default: low)" << std::endl
+            << "  --size               size of the rendered views (default: "
+               "320x180)" << std::endl
+            << "  --frames N           timed frames per view (default: 5)"
+            << std::endl
+            << "  --channel-tolerance  relative tolerance of the radiance "
+               "values (default: 0.02)" << std::endl
+            << "  --outlier-fraction   fraction of radiance values allowed "
+               "outside this tolerance (default: 0.001)" << std::endl
+            << "  --max-delta-e        maximum 99th percentile of the color "
+               "differences (default: 1)" << std::endl
+            << "  --time-threshold     maximum relative increase of the "
+               "timings, negative to ignore them (default: 0.25)" << std::endl
+            << "  --output             write the failing views in DIR"
+            << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--references" && i + 1 < argc) {
+      options->references_directory = argv[++i];
+    } else if (argument == "--update") {
+      options->update = true;
+    } else if (argument == "--quality" && i + 1 < argc) {
+      if (!ParseLutQuality(argv[++i], &options->quality)) {
+        return false;
+      }
+    } else if (argument == "--size" && i + 1 < argc) {
+      char separator = 0;
+      std::istringstream size(argv[++i]);
+      if (!(size >> options->width >> separator >> options->height) ||
+          separator != 'x' || options->width <= 0 || options->height <= 0) {
+        return false;
+      }
+    } else if (argument == "--frames" && i + 1 < argc) {
+      options->frames = std::atoi(argv[++i]);
+    } else if (argument == "--channel-tolerance" && i + 1 < argc) {
+      options->channel_tolerance = std::atof(argv[++i]);
+    } else if (argument == "--outlier-fraction" && i + 1 < argc) {
+      options->outlier_fraction = std::atof(argv[++i]);
+    } else if (argument == "--max-delta-e" && i + 1 < argc) {
+      options->max_delta_e = std::atof(argv[++i]);
+    } else if (argument == "--time-threshold" && i + 1 < argc) {
+      options->time_threshold = std::atof(argv[++i]);
+    } else if (argument == "--output" && i + 1 < argc) {
+      options->output_directory = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return !options->references_directory.empty() && options->frames >= 1 &&
+         options->channel_tolerance >= 0.0 && options->outlier_fraction >= 0.0;
+}
+
+// The file name of a view, without extension (e.g. "sunset_shadow").
+std::string FileName(const std::string& name) {
+  std::string file_name = name;
+  std::replace(file_name.begin(), file_name.end(), ' ', '_');
+  return file_name;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  const std::chrono::duration<double, std::milli> milliseconds =
+      std::chrono::steady_clock::now() - start;
+  return milliseconds.count();
+}
+
+// Reads a timings file, with one "milliseconds name" pair per line. Lines
+// starting with '#' are ignored.
+bool ReadTimings(const std::string& path,
+                 std::map<std::string, double>* timings) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    double milliseconds;
+    std::string name;
+    if (!(fields >> milliseconds) || !std::getline(fields >> std::ws, name)) {
+      return false;
+    }
+    (*timings)[name] = milliseconds;
+  }
+  return true;
+}
+
+// Tonemaps a radiance value as in the original demo, and converts the result,
+// assumed to be in the sRGB color space with a 2.2 gamma, to CIE L*a*b*.
+void RadianceToLab(const float* rgb, double exposure, double lab[3]) {
+  // The demo encodes 1 - exp(-radiance * exposure) with a 1 / 2.2 gamma, so
+  // that this is the linear value which is displayed.
+  double linear[3];
+  for (int c = 0; c < 3; ++c) {
+    linear[c] = std::max(1.0 - std::exp(-rgb[c] * exposure), 0.0);
+  }
+  // Linear sRGB to XYZ, relative to the D65 white point.
+  const double x = (0.4124 * linear[0] + 0.3576 * linear[1] +
+                    0.1805 * linear[2]) / 0.95047;
+  const double y = 0.2126 * linear[0] + 0.7152 * linear[1] +
+                   0.0722 * linear[2];
+  const double z = (0.0193 * linear[0] + 0.1192 * linear[1] +
+                    0.9505 * linear[2]) / 1.08883;
+  const auto f = [](double t) {
+    return t > 216.0 / 24389.0 ? std::cbrt(t)
+                               : (24389.0 / 27.0 * t + 16.0) / 116.0;
+  };
+  lab[0] = 116.0 * f(y) - 16.0;
+  lab[1] = 500.0 * (f(x) - f(y));
+  lab[2] = 200.0 * (f(y) - f(z));
+}
+
+struct Comparison {
+  // The fraction of radiance values outside the channel tolerance.
+  double outlier_fraction = 0.0;
+  double mean_delta_e = 0.0;
+  double p99_delta_e = 0.0;
+  double max_delta_e = 0.0;
+  // The color difference of each pixel.
+  std::vector<float> delta_e;
+};
+
+Comparison CompareImages(const std::vector<float>& image,
+                         const std::vector<float>& reference, double exposure,
+                         double channel_tolerance) {
+  Comparison comparison;
+  double reference_mean = 0.0;
+  for (float value : reference) {
+    reference_mean += std::abs(value);
+  }
+  reference_mean /= reference.size();
+  const double absolute_tolerance = channel_tolerance * 0.01 * reference_mean;
+  size_t outliers = 0;
+  for (size_t i = 0; i < image.size(); ++i) {
+    const double difference = std::abs(image[i] - reference[i]);
+    if (!(difference <= std::max(channel_tolerance * std::abs(reference[i]),
+                                 absolute_tolerance))) {
+      ++outliers;
+    }
+  }
+  comparison.outlier_fraction = static_cast<double>(outliers) / image.size();
+
+  const size_t pixels = image.size() / 3;
+  comparison.delta_e.resize(pixels);
+  for (size_t i = 0; i < pixels; ++i) {
+    double lab[3];
+    double reference_lab[3];
+    RadianceToLab(&image[3 * i], exposure, lab);
+    RadianceToLab(&reference[3 * i], exposure, reference_lab);
+    const double delta_e = std::sqrt(
+        (lab[0] - reference_lab[0]) * (lab[0] - reference_lab[0]) +
+        (lab[1] - reference_lab[1]) * (lab[1] - reference_lab[1]) +
+        (lab[2] - reference_lab[2]) * (lab[2] - reference_lab[2]));
+    // NaN values count as infinitely different.
+    comparison.delta_e[i] =
+        std::isnan(delta_e) ? INFINITY : static_cast<float>(delta_e);
+    comparison.mean_delta_e += comparison.delta_e[i];
+  }
+  comparison.mean_delta_e /= pixels;
+  std::vector<float> sorted = comparison.delta_e;
+  const size_t p99 = std::min(pixels - 1, pixels * 99 / 100);
+  std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+  comparison.p99_delta_e = sorted[p99];
+  comparison.max_delta_e =
+      *std::max_element(sorted.begin() + p99, sorted.end());
+  return comparison;
+}
+
+// Writes a failing view, and its color differences (in all the channels).
+void WriteFailure(const std::string& directory, const std::string& name,
+                  int width, int height, const std::vector<float>& image,
+                  const Comparison& comparison) {
+  const std::string path = directory + "/" + FileName(name);
+  std::vector<float> delta_e(comparison.delta_e.size() * 3);
+  for (size_t i = 0; i < delta_e.size(); ++i) {
+    delta_e[i] = comparison.delta_e[i / 3];
+  }
+  if (!WritePfm(path + ".pfm", width, height, image.data()) ||
+      !WritePfm(path + "_delta_e.pfm", width, height, delta_e.data())) {
+    std::cerr << "Cannot write " << path << ".pfm" << std::endl;
+  }
+}
+
+// Prints a timing, and returns false if it exceeds the reference timing with
+// the same name, if any, by more than 'threshold' (relatively).
+bool CheckTiming(const std::map<std::string, double>& reference_timings,
+                 const std::string& name, double milliseconds,
+                 double threshold) {
+  std::cout << "  " << name << ": " << milliseconds << " ms";
+  auto it = reference_timings.find(name);
+  if (it == reference_timings.end() || it->second <= 0.0) {
+    std::cout << std::endl;
+    return true;
+  }
+  const double increase = milliseconds / it->second - 1.0;
+  const bool pass = threshold < 0.0 || increase <= threshold;
+  std::cout << " (reference " << it->second << " ms, " << std::showpos
+            << increase * 100.0 << std::noshowpos << "%)"
+            << (pass ? "" : " FAIL") << std::endl;
+  return pass;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  OffscreenContext context;
+  if (!context.Init()) {
+    return EXIT_FAILURE;
+  }
+  const std::string renderer_name = context.renderer();
+  std::cout << std::fixed << std::setprecision(3);
+  if (renderer_name.find("llvmpipe") == std::string::npos) {
+    std::cerr << "Warning: '" << renderer_name << "' is not llvmpipe, the "
+              << "images may differ from the references" << std::endl;
+  }
+
+  EarthModelOptions parameters;
+  parameters.resolution = LutResolutionForQuality(options.quality);
+  const auto precompute_start = std::chrono::steady_clock::now();
+  std::unique_ptr<Model1> model(NewEarthModel(parameters));
+  model->Init(kScatteringOrders);
+  glFinish();
+  std::map<std::string, double> timings;
+  timings[kPrecomputeTiming] = MillisecondsSince(precompute_start);
+
+  // As in Engine::initModelTextures, the LUTs are quantized before they are
+  // used.
+  const auto quantize_start = std::chrono::steady_clock::now();
+  model->QuantizeLuts(LutErrorBudget());
+  glFinish();
+  timings[kQuantizeTiming] = MillisecondsSince(quantize_start);
+
+  std::vector<View> views;
+  for (const Scenario& scenario : Scenarios()) {
+    AppSceneRenderer renderer(options.width, options.height, scenario.options);
+    if (!renderer.SetModel(*model)) {
+      std::cerr << "Cannot link the scene program" << scenario.suffix
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    for (const ScenePose& pose : StandardScenePoses()) {
+      View view;
+      view.name = pose.name + std::string(scenario.suffix);
+      view.pose = &pose;
+      // One warm up frame, to exclude the shader compilation and first use
+      // costs.
+      renderer.Draw(pose);
+      glFinish();
+      const auto start = std::chrono::steady_clock::now();
+      for (int frame = 0; frame < options.frames; ++frame) {
+        renderer.Draw(pose);
+        glFinish();
+      }
+      timings["frame " + view.name] =
+          MillisecondsSince(start) / options.frames;
+      view.image.resize(static_cast<size_t>(options.width) * options.height *
+                        3);
+      renderer.Read(view.image.data());
+      views.push_back(std::move(view));
+    }
+  }
+
+  const std::string& directory = options.references_directory;
+  if (options.update) {
+    mkdir(directory.c_str(), 0755);
+    bool success = true;
+    for (const View& view : views) {
+      success = WritePfm(directory + "/" + FileName(view.name) + ".pfm",
+                         options.width, options.height, view.image.data()) &&
+                success;
+    }
+    std::ofstream file(directory + "/" + kTimingsFile);
+    file << std::fixed << std::setprecision(3) << "# " << renderer_name
+         << ", " << FormatLutResolution(parameters.resolution) << ", "
+         << options.width << "x" << options.height << std::endl;
+    for (const auto& timing : timings) {
+      file << timing.second << " " << timing.first << std::endl;
+    }
+    if (!success || !file) {
+      std::cerr << "Cannot write the references in " << directory
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "References written in " << directory << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  int failures = 0;
+  for (const View& view : views) {
+    int width, height;
+    std::vector<float> reference;
+    if (!ReadPfm(directory + "/" + FileName(view.name) + ".pfm", &width,
+                 &height, &reference) ||
+        width != options.width || height != options.height) {
+      std::cout << "FAIL view '" << view.name << "': no " << options.width
+                << "x" << options.height << " reference image" << std::endl;
+      ++failures;
+      continue;
+    }
+    const Comparison comparison = CompareImages(
+        view.image, reference, view.pose->exposure, options.channel_tolerance);
+    const bool pass = comparison.outlier_fraction <= options.outlier_fraction &&
+                      comparison.p99_delta_e <= options.max_delta_e;
+    std::cout << (pass ? "ok   " : "FAIL ") << "view '" << view.name
+              << "': outliers " << comparison.outlier_fraction * 100.0
+              << "%, delta E mean " << comparison.mean_delta_e << ", p99 "
+              << comparison.p99_delta_e << ", max " << comparison.max_delta_e
+              << std::endl;
+    if (!pass) {
+      ++failures;
+      if (!options.output_directory.empty()) {
+        WriteFailure(options.output_directory, view.name, options.width,
+                     options.height, view.image, comparison);
+      }
+    }
+  }
+
+  std::map<std::string, double> reference_timings;
+  if (!ReadTimings(directory + "/" + kTimingsFile, &reference_timings)) {
+    std::cerr << "Warning: no reference timings in " << directory
+              << std::endl;
+  }
+  std::cout << "Timings:" << std::endl;
+  for (const auto& timing : timings) {
+    if (!CheckTiming(reference_timings, timing.first, timing.second,
+                     options.time_threshold)) {
+      ++failures;
+    }
+  }
+  std::cout << (failures == 0 ? "PASS" : "FAILED") << " (" << failures
+            << " failures)" << std::endl;
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,432 @@
+// Measures the precomputation time and the accuracy of the LUTs of the Earth
+// model for several integration sample counts (see sample_counts.h), to find
+// the cheapest counts which meet an error budget:
+//
+//   atmosphere_sample_sweep [--quality QUALITY] [--parameters SET]
+//       [--orders N] [--reference-factor F] [--stage STAGE]...
+//       [--max-error E] [--rms-error E] [--csv FILE]
+//
+// The reference LUTs are precomputed with F times (default 4) the default
+// sample counts. Then the sample count of each stage (transmittance, single
+// scattering, scattering density, multiple scattering and indirect
+// irradiance, or only the given ones) is varied alone, from the default
+// counts, and the LUTs precomputed with each candidate count are compared
+// with the reference ones (with the relative errors of lut_quantization.h).
+// For each candidate, the tool reports the GPU time of its stage, the GPU and
+// wall times of the whole precomputation, and the maximum and RMS errors of
+// each LUT. The cheapest count of each stage whose LUTs are all within the
+// budget (an RMS relative error of at most 0.01 by default, and optionally a
+// maximum relative error, which is often dominated by a few texels close to
+// the horizon) is then selected, or the default count if none is, and the
+// LUTs precomputed with all the selected counts are checked again, since the
+// errors of the stages add up. The tool exits with a failure status if they
+// are not within the budget. The stage GPU times are 0 if timer queries are
+// not supported.
+//
+// The other parameters are those of the model (see parameter_sets.h), e.g.
+// --parameters "wavelengths=15 precision=float".
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MODEL/earth_model.h"
+#include "MODEL/lut_quantization.h"
+#include "RENDER/gpu_profiler.h"
+#include "common/offscreen_context.h"
+#include "common/parameter_sets.h"
+
+namespace {
+
+struct Stage {
+  const char* name;
+  // The name of the GpuProfiler scopes of this stage (see Model1::Init).
+  const char* scope;
+  int SampleCounts::*count;
+  std::vector<int> candidates;
+};
+
+const std::vector<Stage>& Stages() {
+  static const std::vector<Stage> stages = {
+      {"transmittance", "transmittance", &SampleCounts::transmittance,
+       {50, 100, 200, 300, 500, 1000}},
+      {"single", "single scattering", &SampleCounts::single_scattering,
+       {10, 20, 30, 40, 50, 100}},
+      {"density", "scattering density", &SampleCounts::scattering_density,
+       {4, 6, 8, 12, 16, 24}},
+      {"multiple", "multiple scattering", &SampleCounts::multiple_scattering,
+       {10, 20, 30, 40, 50, 100}},
+      {"irradiance", "indirect irradiance",
+       &SampleCounts::indirect_irradiance, {8, 12, 16, 24, 32, 48}}};
+  return stages;
+}
+
+// In LutId order, for the table and for the CSV file.
+const char* const kLutNames[LUT_COUNT] = {
+    "transmittance", "scattering", "single Mie", "irradiance"};
+const char* const kLutKeys[LUT_COUNT] = {
+    "transmittance", "scattering", "single_mie_scattering", "irradiance"};
+
+struct Options {
+  LutQuality quality = LUT_QUALITY_LOW;
+  EarthModelOptions parameters;
+  unsigned int orders = 4;
+  double reference_factor = 4.0;
+  std::vector<std::string> stages;
+  // A negative maximum error is not checked.
+  LutErrorBudget budget;
+  std::string csv_file;
+
+  Options() {
+    budget.max_relative_error = -1.0;
+    budget.rms_relative_error = 0.01;
+  }
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: atmosphere_sample_sweep [--quality QUALITY] "
+               "[--parameters SET] [--orders N] [--reference-factor F] "
+               "[--stage STAGE]... [--max-error E] [--rms-error E] "
+               "[--csv FILE]" << std::endl
+            << "  --quality           LUT quality (default: low)" << std::endl
+            << "  --parameters        model parameters, in the parameter set "
+               "format of the other tools" << std::endl
+            << "  --orders            number of scattering orders (default: "
+               "4)" << std::endl
+            << "  --reference-factor  sample counts of the reference LUTs, "
+               "relatively to the default ones (default: 4)" << std::endl
+            << "  --stage             only sweep this stage (transmittance, "
+               "single, density, multiple or irradiance)" << std::endl
+            << "  --max-error         maximum relative error of each LUT "
+               "(default: not checked)" << std::endl
+            << "  --rms-error         RMS relative error of each LUT "
+               "(default: 0.01)" << std::endl
+            << "  --csv               also write the results in FILE"
+            << std::endl;
+}
+
+bool IsStageName(const std::string& name) {
+  for (const Stage& stage : Stages()) {
+    if (name == stage.name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  std::string parameters;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--quality" && i + 1 < argc) {
+      if (!ParseLutQuality(argv[++i], &options->quality)) {
+        return false;
+      }
+    } else if (argument == "--parameters" && i + 1 < argc) {
+      parameters = argv[++i];
+    } else if (argument == "--orders" && i + 1 < argc) {
+      options->orders = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (argument == "--reference-factor" && i + 1 < argc) {
+      options->reference_factor = std::atof(argv[++i]);
+    } else if (argument == "--stage" && i + 1 < argc) {
+      options->stages.push_back(argv[++i]);
+      if (!IsStageName(options->stages.back())) {
+        return false;
+      }
+    } else if (argument == "--max-error" && i + 1 < argc) {
+      options->budget.max_relative_error = std::atof(argv[++i]);
+    } else if (argument == "--rms-error" && i + 1 < argc) {
+      options->budget.rms_relative_error = std::atof(argv[++i]);
+    } else if (argument == "--csv" && i + 1 < argc) {
+      options->csv_file = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  // The quality is applied first, so that the parameters can override it.
+  options->parameters.resolution = LutResolutionForQuality(options->quality);
+  std::string error;
+  if (!ParseParameterSet(parameters, &options->parameters, &error)) {
+    std::cerr << "Invalid parameter '" << error << "'" << std::endl;
+    return false;
+  }
+  return options->orders >= 1 && options->reference_factor > 0.0;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  const std::chrono::duration<double, std::milli> milliseconds =
+      std::chrono::steady_clock::now() - start;
+  return milliseconds.count();
+}
+
+// The LUTs of a precomputation, read back in float, with its timings.
+struct Bake {
+  std::vector<float> luts[LUT_COUNT];
+  int components[LUT_COUNT] = {0, 0, 0, 0};
+  double wall_ms = 0.0;
+  double gpu_ms = 0.0;
+  // The total GPU time of the innermost scopes, by name.
+  std::vector<GpuTiming> scope_timings;
+
+  double ScopeMilliseconds(const std::string& name) const {
+    double milliseconds = 0.0;
+    for (const GpuTiming& timing : scope_timings) {
+      if (timing.name == name) {
+        milliseconds += timing.milliseconds;
+      }
+    }
+    return milliseconds;
+  }
+};
+
+// Returns the total time of the innermost scopes of the last profiled frame,
+// by name, waiting for its results (the caller must have called glFinish).
+// The outer scopes (wavelengths, orders, and the multiple scattering stage
+// containing the per order stages) only contain other scopes.
+std::vector<GpuTiming> InnermostTimings(GpuProfiler* profiler) {
+  profiler->Poll();
+  const std::vector<GpuTiming>& timings = profiler->timings();
+  std::vector<GpuTiming> result;
+  for (size_t i = 0; i < timings.size(); ++i) {
+    if (i + 1 < timings.size() && timings[i + 1].depth > timings[i].depth) {
+      continue;
+    }
+    bool found = false;
+    for (GpuTiming& total : result) {
+      if (total.name == timings[i].name) {
+        total.milliseconds += timings[i].milliseconds;
+        found = true;
+      }
+    }
+    if (!found) {
+      result.push_back(timings[i]);
+      result.back().depth = 0;
+    }
+  }
+  return result;
+}
+
+Bake RunBake(const EarthModelOptions& parameters, unsigned int orders) {
+  Bake bake;
+  GpuProfiler profiler;
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Model1> model(NewEarthModel(parameters));
+  profiler.BeginFrame();
+  model->Init(orders, nullptr, &profiler);
+  profiler.EndFrame();
+  glFinish();
+  bake.wall_ms = MillisecondsSince(start);
+  bake.scope_timings = InnermostTimings(&profiler);
+  for (const GpuTiming& timing : bake.scope_timings) {
+    bake.gpu_ms += timing.milliseconds;
+  }
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    LutEntry entry;
+    if (model->ReadLut(static_cast<LutId>(i), &bake.luts[i], &entry)) {
+      bake.components[i] = entry.components;
+    }
+  }
+  return bake;
+}
+
+struct BakeErrors {
+  LutError errors[LUT_COUNT];
+  bool within_budget = true;
+};
+
+BakeErrors CompareBakes(const Bake& reference, const Bake& bake,
+                        const LutErrorBudget& budget) {
+  BakeErrors result;
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    const std::vector<float>& values = bake.luts[i];
+    LutError& error = result.errors[i];
+    error.max_relative_error = 0.0;
+    error.rms_relative_error = 0.0;
+    if (values.empty()) {
+      continue;
+    }
+    const int components = bake.components[i];
+    error = ComputeLutError(reference.luts[i].data(), values.data(),
+                            values.size() / components, components,
+                            budget.relative_error_floor);
+    result.within_budget = result.within_budget &&
+        (budget.max_relative_error < 0.0 ||
+         error.max_relative_error <= budget.max_relative_error) &&
+        error.rms_relative_error <= budget.rms_relative_error;
+  }
+  return result;
+}
+
+struct Row {
+  std::string stage;
+  SampleCounts counts;
+  double stage_ms;
+  Bake bake;
+  BakeErrors errors;
+};
+
+Row MeasureBake(const Options& options, const Bake& reference,
+                const std::string& stage, const char* scope,
+                const SampleCounts& counts) {
+  EarthModelOptions parameters = options.parameters;
+  parameters.sample_counts = counts;
+  Row row;
+  row.stage = stage;
+  row.counts = counts;
+  row.bake = RunBake(parameters, options.orders);
+  row.stage_ms = scope == nullptr ?
+      row.bake.gpu_ms : row.bake.ScopeMilliseconds(scope);
+  row.errors = CompareBakes(reference, row.bake, options.budget);
+  // The LUTs are no longer needed, only their errors.
+  for (std::vector<float>& lut : row.bake.luts) {
+    std::vector<float>().swap(lut);
+  }
+  return row;
+}
+
+void PrintHeader(std::ostream& output) {
+  output << std::left << std::setw(14) << "stage" << std::setw(20)
+         << "samples" << std::right << std::setw(10) << "stage ms"
+         << std::setw(10) << "gpu ms" << std::setw(10) << "wall ms";
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    output << "  " << std::setw(23) << std::string(kLutNames[i]) + " max/rms";
+  }
+  output << std::endl;
+}
+
+void PrintRow(const Row& row, std::ostream& output) {
+  const std::string samples = FormatSampleCounts(row.counts);
+  output << std::left << std::setw(14) << row.stage << std::setw(20)
+         << samples.substr(samples.find('=') + 1) << std::right
+         << std::setw(10) << row.stage_ms << std::setw(10) << row.bake.gpu_ms
+         << std::setw(10) << row.bake.wall_ms;
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    if (row.bake.components[i] == 0) {
+      output << "  " << std::setw(23) << "-";
+      continue;
+    }
+    std::ostringstream errors;
+    errors << std::fixed << std::setprecision(3)
+           << row.errors.errors[i].max_relative_error * 100.0 << "%/"
+           << row.errors.errors[i].rms_relative_error * 100.0 << "%";
+    output << "  " << std::setw(23) << errors.str();
+  }
+  output << (row.errors.within_budget ? "" : "  over budget") << std::endl;
+}
+
+void WriteCsv(const std::vector<Row>& rows, std::ostream& output) {
+  output << "stage,transmittance_samples,single_scattering_samples,"
+            "scattering_density_samples,multiple_scattering_samples,"
+            "indirect_irradiance_samples,stage_ms,gpu_ms,wall_ms";
+  for (int i = 0; i < LUT_COUNT; ++i) {
+    output << "," << kLutKeys[i] << "_max_error," << kLutKeys[i]
+           << "_rms_error";
+  }
+  output << ",within_budget" << std::endl;
+  for (const Row& row : rows) {
+    output << row.stage << "," << row.counts.transmittance << ","
+           << row.counts.single_scattering << ","
+           << row.counts.scattering_density << ","
+           << row.counts.multiple_scattering << ","
+           << row.counts.indirect_irradiance << "," << row.stage_ms << ","
+           << row.bake.gpu_ms << "," << row.bake.wall_ms;
+    for (int i = 0; i < LUT_COUNT; ++i) {
+      output << "," << row.errors.errors[i].max_relative_error << ","
+             << row.errors.errors[i].rms_relative_error;
+    }
+    output << "," << (row.errors.within_budget ? 1 : 0) << std::endl;
+  }
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  OffscreenContext context;
+  if (!context.Init()) {
+    return EXIT_FAILURE;
+  }
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << context.renderer() << ", "
+            << FormatLutResolution(options.parameters.resolution)
+            << std::endl;
+
+  const SampleCounts defaults = options.parameters.sample_counts;
+  const SampleCounts reference_counts =
+      ScaleSampleCounts(defaults, options.reference_factor);
+  EarthModelOptions reference_parameters = options.parameters;
+  reference_parameters.sample_counts = reference_counts;
+  std::cout << "Precomputing the reference LUTs ("
+            << FormatSampleCounts(reference_counts) << ")..." << std::endl;
+  const Bake reference = RunBake(reference_parameters, options.orders);
+  std::cout << "Reference: " << reference.gpu_ms << " ms GPU, "
+            << reference.wall_ms << " ms wall" << std::endl << std::endl;
+
+  std::vector<Row> rows;
+  PrintHeader(std::cout);
+  rows.push_back(MeasureBake(options, reference, "default", nullptr,
+                             defaults));
+  PrintRow(rows.back(), std::cout);
+  SampleCounts selected = defaults;
+  for (const Stage& stage : Stages()) {
+    if (!options.stages.empty() &&
+        std::find(options.stages.begin(), options.stages.end(),
+                  stage.name) == options.stages.end()) {
+      continue;
+    }
+    bool found = false;
+    for (int candidate : stage.candidates) {
+      SampleCounts counts = defaults;
+      counts.*stage.count = candidate;
+      if (!counts.IsValid()) {
+        continue;
+      }
+      rows.push_back(
+          MeasureBake(options, reference, stage.name, stage.scope, counts));
+      PrintRow(rows.back(), std::cout);
+      // The candidates are sorted by increasing cost.
+      if (!found && rows.back().errors.within_budget) {
+        selected.*stage.count = candidate;
+        found = true;
+      }
+    }
+    if (!found) {
+      std::cout << "No " << stage.name << " sample count within the budget, "
+                << "keeping the default one" << std::endl;
+    }
+  }
+
+  rows.push_back(MeasureBake(options, reference, "selected", nullptr,
+                             selected));
+  PrintRow(rows.back(), std::cout);
+  const Row& selected_row = rows.back();
+  std::cout << std::endl << "Selected " << FormatSampleCounts(selected)
+            << ": " << selected_row.bake.gpu_ms << " ms GPU ("
+            << rows.front().bake.gpu_ms << " ms with the default counts), "
+            << (selected_row.errors.within_budget ?
+                    "within the budget" : "over the budget")
+            << std::endl;
+
+  if (!options.csv_file.empty()) {
+    std::ofstream file(options.csv_file);
+    WriteCsv(rows, file);
+    if (!file) {
+      std::cerr << "Cannot write " << options.csv_file << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return selected_row.errors.within_budget ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+// Precomputes the LUTs of a single atmosphere with several worker processes,
+// each one computing a range of r layers of the 3D textures (see
+// LayerExchange in model1.h), and writes them in a LUT file named like in the
+// LUT cache of the application:
+//
+//   atmosphere_shard_bake [--workers N] [--orders N] [--output DIRECTORY]
+//       [key=value ...]
+//
+// where the key=value pairs are the atmosphere parameters (see
+// parameter_sets.h).
+
+#include <glad/glad.h>
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MODEL/earth_model.h"
+#include "common/offscreen_context.h"
+#include "common/parameter_sets.h"
+#include "common/shared_memory_exchange.h"
+
+namespace {
+
+// The most textures exchanged at once (the single Rayleigh and Mie
+// scattering, or the final scattering and single Mie scattering).
+constexpr unsigned int kMaxExchangedTextures = 2;
+
+struct Options {
+  unsigned int workers = 0;
+  unsigned int scattering_orders = 4;
+  std::string output_directory = "luts";
+  EarthModelOptions parameters;
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: atmosphere_shard_bake [--workers N] [--orders N] "
+               "[--output DIRECTORY] [key=value ...]" << std::endl
+            << "  --workers N  number of worker processes (default: one per "
+               "hardware thread)" << std::endl
+            << "  --orders N   number of scattering orders (default: 4)"
+            << std::endl
+            << "  --output     output directory (default: luts)"
+            << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  std::string parameters;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--workers" && i + 1 < argc) {
+      options->workers = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (argument == "--orders" && i + 1 < argc) {
+      options->scattering_orders =
+          static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (argument == "--output" && i + 1 < argc) {
+      options->output_directory = argv[++i];
+    } else if (argument[0] != '-') {
+      parameters += argument + " ";
+    } else {
+      return false;
+    }
+  }
+  std::string error;
+  if (!ParseParameterSet(parameters, &options->parameters, &error)) {
+    std::cerr << "Invalid parameter '" << error << "'" << std::endl;
+    return false;
+  }
+  return options->scattering_orders >= 1;
+}
+
+// Computes the layers of the given shard, and saves the LUTs in the first
+// one. Returns the process exit status.
+int RunWorker(const Options& options, SharedMemoryExchange* exchange,
+              unsigned int shard) {
+  exchange->SetShard(shard);
+  OffscreenContext context;
+  if (!context.Init()) {
+    // The other shards would wait for this one forever.
+    return EXIT_FAILURE;
+  }
+  std::unique_ptr<Model1> model(NewEarthModel(options.parameters));
+  model->Init(options.scattering_orders, exchange);
+  if (shard != 0) {
+    return EXIT_SUCCESS;
+  }
+  const std::string path = LutCachePath(options.output_directory, *model);
+  if (!model->SaveLuts(path)) {
+    std::cerr << "Cannot write " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << path << std::endl;
+  return EXIT_SUCCESS;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  mkdir(options.output_directory.c_str(), 0755);
+
+  unsigned int worker_count = options.workers;
+  if (worker_count == 0) {
+    worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  // At least one layer per worker.
+  const LutResolution& resolution = options.parameters.resolution;
+  worker_count = std::min(worker_count, static_cast<unsigned int>(
+                                            resolution.scattering_depth()));
+  SharedMemoryExchange exchange(worker_count, kMaxExchangedTextures,
+                                resolution);
+  if (!exchange.is_valid()) {
+    std::cerr << "Cannot map the shared memory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<pid_t> workers;
+  for (unsigned int worker = 0; worker < worker_count; ++worker) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      _exit(RunWorker(options, &exchange, worker));
+    } else if (pid < 0) {
+      std::cerr << "Cannot start worker " << worker << std::endl;
+      break;
+    }
+    workers.push_back(pid);
+  }
+
+  // The workers wait for each other after each pass, so if one of them fails
+  // the others must be stopped.
+  bool success = workers.size() == worker_count;
+  if (!success) {
+    for (pid_t pid : workers) {
+      kill(pid, SIGTERM);
+    }
+  }
+  for (size_t remaining = workers.size(); remaining > 0; --remaining) {
+    int status;
+    const pid_t pid = wait(&status);
+    if (pid < 0) {
+      break;
+    }
+    if (success && (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)) {
+      success = false;
+      for (pid_t other : workers) {
+        if (other != pid) {
+          kill(other, SIGTERM);
+        }
+      }
+    }
+  }
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  std::cout << (success ? "Baked" : "FAILED") << " with " << worker_count
+            << " workers in " << seconds.count() << "s" << std::endl;
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,455 @@
+// Searches the LUT sizes (see lut_resolution.h) giving the smallest rendering
+// error for a given memory budget. A high resolution reference is baked
+// first, and rendered from a fixed set of views. Then, starting from the
+// smallest sizes, the tool repeatedly bakes each candidate obtained by
+// increasing one of the 8 dimensions to its next level, and keeps the one
+// which reduces the error of the rendered views the most per added byte,
+// until the largest memory budget is reached. All the evaluated sizes are
+// then reported, with their Pareto fronts of memory and bake time against
+// error, and the best sizes within each budget:
+//
+//   atmosphere_tune [--reference QUALITY] [--budgets MB,MB,...] [--size WxH]
+//       [--orders N] [--quantize] [--csv FILE] [key=value ...]
+//
+// where the key=value pairs are the atmosphere parameters (see
+// parameter_sets.h, the texture size keys are ignored). The error of a view is
+// the relative root mean square error of its luminance values, with respect
+// to the reference, and the error of a LUT size is the mean error of the
+// views.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MODEL/earth_model.h"
+#include "MODEL/lut_quantization.h"
+#include "MODEL/lut_resolution.h"
+#include "common/offscreen_context.h"
+#include "common/parameter_sets.h"
+#include "common/sky_view_renderer.h"
+
+namespace {
+
+constexpr double kMegabyte = 1024.0 * 1024.0;
+
+// A dimension of the LUT sizes, with its candidate values in increasing
+// order (the values larger than those of the reference are skipped).
+struct Dimension {
+  const char* name;
+  int LutResolution::*size;
+  std::vector<int> levels;
+};
+
+std::vector<Dimension> NewDimensions() {
+  return {
+      {"transmittance width", &LutResolution::transmittance_width,
+       {64, 128, 256, 512, 1024}},
+      {"transmittance height", &LutResolution::transmittance_height,
+       {16, 32, 64, 128, 256}},
+      {"scattering r", &LutResolution::scattering_r_size,
+       {8, 12, 16, 24, 32, 48, 64}},
+      {"scattering mu", &LutResolution::scattering_mu_size,
+       {32, 48, 64, 96, 128, 192, 256}},
+      {"scattering mu_s", &LutResolution::scattering_mu_s_size,
+       {8, 12, 16, 24, 32, 48, 64}},
+      {"scattering nu", &LutResolution::scattering_nu_size,
+       {4, 6, 8, 12, 16}},
+      {"irradiance width", &LutResolution::irradiance_width,
+       {16, 32, 64, 128, 256}},
+      {"irradiance height", &LutResolution::irradiance_height,
+       {4, 8, 16, 32, 64}}};
+}
+
+// Returns the RGB luminance values of each standard view, one image after the
+// other.
+std::vector<float> RenderViews(SkyViewRenderer* renderer, const Model1& model) {
+  const std::vector<SkyView>& views = StandardSkyViews();
+  const size_t image_size =
+      static_cast<size_t>(renderer->width()) * renderer->height() * 3;
+  std::vector<float> images(image_size * views.size());
+  renderer->SetModel(model);
+  for (size_t i = 0; i < views.size(); ++i) {
+    renderer->Draw(views[i]);
+    renderer->Read(images.data() + i * image_size);
+  }
+  return images;
+}
+
+struct Options {
+  LutQuality reference_quality = LUT_QUALITY_ULTRA;
+  std::vector<double> budgets_mb = {1.0, 2.0, 4.0, 8.0, 16.0};
+  int width = 160;
+  int height = 90;
+  unsigned int scattering_orders = 4;
+  bool quantize = false;
+  std::string csv_file;
+  EarthModelOptions parameters;
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: atmosphere_tune [--reference QUALITY] "
+               "[--budgets MB,MB,...] [--size WxH] [--orders N] [--quantize] "
+               "[--csv FILE] [key=value ...]" << std::endl
+            << "  --reference  quality of the reference LUTs (default: ultra)"
+            << std::endl
+            << "  --budgets    memory budgets, in MB (default: 1,2,4,8,16)"
+            << std::endl
+            << "  --size       size of the rendered views (default: 160x90)"
+            << std::endl
+            << "  --orders N   number of scattering orders (default: 4)"
+            << std::endl
+            << "  --quantize   measure the memory and error of the LUTs "
+               "quantized within the default error budget" << std::endl
+            << "  --csv        also write all the evaluated sizes in a CSV "
+               "file" << std::endl;
+}
+
+bool ParseBudgets(const std::string& value, std::vector<double>* budgets_mb) {
+  budgets_mb->clear();
+  std::istringstream stream(value);
+  std::string budget;
+  while (std::getline(stream, budget, ',')) {
+    char* end;
+    const double megabytes = std::strtod(budget.c_str(), &end);
+    if (end == budget.c_str() || *end != '\0' || !(megabytes > 0.0)) {
+      return false;
+    }
+    budgets_mb->push_back(megabytes);
+  }
+  std::sort(budgets_mb->begin(), budgets_mb->end());
+  return !budgets_mb->empty();
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  std::string parameters;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--reference" && i + 1 < argc) {
+      if (!ParseLutQuality(argv[++i], &options->reference_quality)) {
+        return false;
+      }
+    } else if (argument == "--budgets" && i + 1 < argc) {
+      if (!ParseBudgets(argv[++i], &options->budgets_mb)) {
+        return false;
+      }
+    } else if (argument == "--size" && i + 1 < argc) {
+      char separator = 0;
+      std::istringstream size(argv[++i]);
+      if (!(size >> options->width >> separator >> options->height) ||
+          separator != 'x' || options->width <= 0 || options->height <= 0) {
+        return false;
+      }
+    } else if (argument == "--orders" && i + 1 < argc) {
+      options->scattering_orders =
+          static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (argument == "--quantize") {
+      options->quantize = true;
+    } else if (argument == "--csv" && i + 1 < argc) {
+      options->csv_file = argv[++i];
+    } else if (argument[0] != '-') {
+      parameters += argument + " ";
+    } else {
+      return false;
+    }
+  }
+  std::string error;
+  if (!ParseParameterSet(parameters, &options->parameters, &error)) {
+    std::cerr << "Invalid parameter '" << error << "'" << std::endl;
+    return false;
+  }
+  return options->scattering_orders >= 1;
+}
+
+struct Evaluation {
+  LutResolution resolution;
+  uint64_t memory;
+  double bake_seconds;
+  // The mean and maximum errors of the views.
+  double error;
+  double max_error;
+};
+
+// The relative root mean square error of 'image' with respect to
+// 'reference'.
+double RelativeRmsError(const float* image, const float* reference,
+                        size_t size) {
+  double squared_error = 0.0;
+  double squared_reference = 0.0;
+  for (size_t i = 0; i < size; ++i) {
+    const double difference = static_cast<double>(image[i]) - reference[i];
+    squared_error += difference * difference;
+    squared_reference += static_cast<double>(reference[i]) * reference[i];
+  }
+  return squared_reference > 0.0 ?
+      std::sqrt(squared_error / squared_reference) : 0.0;
+}
+
+class Tuner {
+ public:
+  Tuner(const Options& options, SkyViewRenderer* renderer)
+      : options_(options), renderer_(renderer) {}
+
+  // Bakes the reference LUTs, and renders the reference views.
+  void BakeReference();
+  // Searches the best LUT sizes for each budget, as described above.
+  void Search();
+  void PrintReport() const;
+  bool WriteCsv(const std::string& path) const;
+
+ private:
+  // Bakes and renders the given sizes, if not already done, and returns their
+  // evaluation.
+  const Evaluation& Evaluate(const LutResolution& resolution);
+  // Bakes a model with the given sizes, and returns its bake time. Renders it
+  // into 'images', and returns its memory size in 'memory'.
+  double Bake(const LutResolution& resolution, std::vector<float>* images,
+              uint64_t* memory) const;
+
+  const Options& options_;
+  SkyViewRenderer* renderer_;
+  LutResolution reference_resolution_;
+  std::vector<float> reference_images_;
+  // The evaluated sizes, indexed by their FormatLutResolution.
+  std::map<std::string, Evaluation> evaluations_;
+};
+
+double Tuner::Bake(const LutResolution& resolution, std::vector<float>* images,
+                   uint64_t* memory) const {
+  EarthModelOptions parameters = options_.parameters;
+  parameters.resolution = resolution;
+  glFinish();
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Model1> model(NewEarthModel(parameters));
+  model->Init(options_.scattering_orders);
+  if (options_.quantize) {
+    model->QuantizeLuts(LutErrorBudget());
+  }
+  glFinish();
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  *memory = model->LutMemorySize();
+  *images = RenderViews(renderer_, *model);
+  return seconds.count();
+}
+
+void Tuner::BakeReference() {
+  reference_resolution_ = LutResolutionForQuality(options_.reference_quality);
+  uint64_t memory;
+  const double seconds =
+      Bake(reference_resolution_, &reference_images_, &memory);
+  std::cout << "reference (" << LutQualityName(options_.reference_quality)
+            << "): " << FormatLutResolution(reference_resolution_) << ", "
+            << memory / kMegabyte << " MB, " << seconds << "s" << std::endl;
+}
+
+const Evaluation& Tuner::Evaluate(const LutResolution& resolution) {
+  const std::string key = FormatLutResolution(resolution);
+  auto it = evaluations_.find(key);
+  if (it != evaluations_.end()) {
+    return it->second;
+  }
+  Evaluation evaluation;
+  evaluation.resolution = resolution;
+  std::vector<float> images;
+  evaluation.bake_seconds = Bake(resolution, &images, &evaluation.memory);
+  const size_t view_count = StandardSkyViews().size();
+  const size_t image_size = images.size() / view_count;
+  evaluation.error = 0.0;
+  evaluation.max_error = 0.0;
+  for (size_t i = 0; i < view_count; ++i) {
+    const double error = RelativeRmsError(images.data() + i * image_size,
+        reference_images_.data() + i * image_size, image_size);
+    evaluation.error += error / view_count;
+    evaluation.max_error = std::max(evaluation.max_error, error);
+  }
+  std::cout << "[" << evaluations_.size() + 1 << "] " << key << ": "
+            << evaluation.memory / kMegabyte << " MB, "
+            << evaluation.bake_seconds << "s, error "
+            << evaluation.error * 100.0 << "% (max "
+            << evaluation.max_error * 100.0 << "%)" << std::endl;
+  return evaluations_.emplace(key, evaluation).first->second;
+}
+
+void Tuner::Search() {
+  // The levels of each dimension, up to the reference size.
+  std::vector<Dimension> dimensions = NewDimensions();
+  for (Dimension& dimension : dimensions) {
+    const int reference_size = reference_resolution_.*dimension.size;
+    dimension.levels.erase(
+        std::remove_if(dimension.levels.begin(), dimension.levels.end(),
+                       [=](int size) { return size > reference_size; }),
+        dimension.levels.end());
+    if (dimension.levels.empty()) {
+      dimension.levels.push_back(reference_size);
+    }
+  }
+
+  const uint64_t max_memory =
+      static_cast<uint64_t>(options_.budgets_mb.back() * kMegabyte);
+  std::vector<size_t> levels(dimensions.size(), 0);
+  LutResolution resolution;
+  for (size_t i = 0; i < dimensions.size(); ++i) {
+    resolution.*dimensions[i].size = dimensions[i].levels[0];
+  }
+  Evaluation current = Evaluate(resolution);
+  while (true) {
+    // The next level of the dimension with the largest error decrease per
+    // added byte or, if none decreases the error, the cheapest one (the error
+    // may only decrease after several steps in the same dimension).
+    int best_dimension = -1;
+    double best_gain = 0.0;
+    uint64_t best_added_memory = 0;
+    Evaluation best;
+    for (size_t i = 0; i < dimensions.size(); ++i) {
+      if (levels[i] + 1 >= dimensions[i].levels.size()) {
+        continue;
+      }
+      LutResolution candidate_resolution = resolution;
+      candidate_resolution.*dimensions[i].size =
+          dimensions[i].levels[levels[i] + 1];
+      const Evaluation& candidate = Evaluate(candidate_resolution);
+      if (candidate.memory > max_memory) {
+        continue;
+      }
+      const uint64_t added_memory =
+          candidate.memory > current.memory ?
+              candidate.memory - current.memory : 1;
+      const double gain = (current.error - candidate.error) / added_memory;
+      if (best_dimension == -1 ||
+          (gain > 0.0 ? gain > best_gain :
+              best_gain <= 0.0 && added_memory < best_added_memory)) {
+        best_dimension = static_cast<int>(i);
+        best_gain = gain;
+        best_added_memory = added_memory;
+        best = candidate;
+      }
+    }
+    if (best_dimension == -1) {
+      break;
+    }
+    ++levels[best_dimension];
+    resolution = best.resolution;
+    current = best;
+  }
+}
+
+// Returns the evaluations which have a smaller error than all the cheaper
+// ones, in increasing cost order.
+template <typename Cost>
+std::vector<const Evaluation*> ParetoFront(
+    const std::map<std::string, Evaluation>& evaluations, Cost cost) {
+  std::vector<const Evaluation*> sorted;
+  for (const auto& entry : evaluations) {
+    sorted.push_back(&entry.second);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [&](const Evaluation* a, const Evaluation* b) {
+              return cost(*a) != cost(*b) ? cost(*a) < cost(*b) :
+                  a->error < b->error;
+            });
+  std::vector<const Evaluation*> front;
+  for (const Evaluation* evaluation : sorted) {
+    if (front.empty() || evaluation->error < front.back()->error) {
+      front.push_back(evaluation);
+    }
+  }
+  return front;
+}
+
+void PrintEvaluation(const Evaluation& evaluation) {
+  std::cout << "  " << evaluation.memory / kMegabyte << " MB, "
+            << evaluation.bake_seconds << "s, error "
+            << evaluation.error * 100.0 << "% (max "
+            << evaluation.max_error * 100.0 << "%): "
+            << FormatLutResolution(evaluation.resolution) << std::endl;
+}
+
+void Tuner::PrintReport() const {
+  std::cout << std::endl << "Pareto front, memory vs error:" << std::endl;
+  for (const Evaluation* evaluation : ParetoFront(evaluations_,
+           [](const Evaluation& e) { return static_cast<double>(e.memory); })) {
+    PrintEvaluation(*evaluation);
+  }
+  std::cout << std::endl << "Pareto front, bake time vs error:" << std::endl;
+  for (const Evaluation* evaluation : ParetoFront(evaluations_,
+           [](const Evaluation& e) { return e.bake_seconds; })) {
+    PrintEvaluation(*evaluation);
+  }
+  std::cout << std::endl << "Best sizes per memory budget:" << std::endl;
+  for (double budget_mb : options_.budgets_mb) {
+    const Evaluation* best = nullptr;
+    for (const auto& entry : evaluations_) {
+      const Evaluation& evaluation = entry.second;
+      if (evaluation.memory <= budget_mb * kMegabyte &&
+          (best == nullptr || evaluation.error < best->error)) {
+        best = &evaluation;
+      }
+    }
+    std::cout << budget_mb << " MB:" << std::endl;
+    if (best == nullptr) {
+      std::cout << "  none" << std::endl;
+    } else {
+      PrintEvaluation(*best);
+    }
+  }
+}
+
+bool Tuner::WriteCsv(const std::string& path) const {
+  std::ofstream file(path);
+  file << "transmittance_width,transmittance_height,scattering_r_size,"
+          "scattering_mu_size,scattering_mu_s_size,scattering_nu_size,"
+          "irradiance_width,irradiance_height,memory_bytes,bake_seconds,"
+          "error,max_error" << std::endl;
+  for (const auto& entry : evaluations_) {
+    const Evaluation& evaluation = entry.second;
+    const LutResolution& resolution = evaluation.resolution;
+    file << resolution.transmittance_width << ","
+         << resolution.transmittance_height << ","
+         << resolution.scattering_r_size << ","
+         << resolution.scattering_mu_size << ","
+         << resolution.scattering_mu_s_size << ","
+         << resolution.scattering_nu_size << ","
+         << resolution.irradiance_width << ","
+         << resolution.irradiance_height << "," << evaluation.memory << ","
+         << evaluation.bake_seconds << "," << evaluation.error << ","
+         << evaluation.max_error << std::endl;
+  }
+  return static_cast<bool>(file);
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  OffscreenContext context;
+  if (!context.Init()) {
+    return EXIT_FAILURE;
+  }
+  std::cout << context.renderer() << std::endl;
+
+  SkyViewRenderer renderer(options.width, options.height);
+  Tuner tuner(options, &renderer);
+  tuner.BakeReference();
+  tuner.Search();
+  tuner.PrintReport();
+  if (!options.csv_file.empty() && !tuner.WriteCsv(options.csv_file)) {
+    std::cerr << "Cannot write " << options.csv_file << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}